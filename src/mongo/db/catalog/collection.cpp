@@ -34,6 +34,7 @@
 
 #include "mongo/db/catalog/collection.h"
 
+#include <boost/scoped_array.hpp>
 #include <boost/scoped_ptr.hpp>
 
 #include "mongo/base/counter.h"
@@ -49,6 +50,7 @@
 #include "mongo/db/repl/replication_coordinator_global.h"
 #include "mongo/db/storage/mmap_v1/mmap_v1_options.h"
 #include "mongo/db/storage/record_fetcher.h"
+#include "mongo/db/storage/sorted_data_interface.h"
 
 #include "mongo/db/auth/user_document_parser.h" // XXX-ANDY
 #include "mongo/util/log.h"
@@ -169,6 +171,27 @@ namespace mongo {
         return true;
     }
 
+    void Collection::findDocs(OperationContext* txn,
+                              const std::vector<RecordId>& locs,
+                              std::vector<Snapshotted<BSONObj> >* out,
+                              std::vector<bool>* found) const {
+        dassert(txn->lockState()->isCollectionLockedForMode(ns().toString(), MODE_IS));
+
+        std::vector<RecordData> rds;
+        _recordStore->findRecords( txn, locs, &rds );
+
+        const SnapshotId snapshotId = txn->recoveryUnit()->getSnapshotId();
+        out->clear();
+        out->resize(locs.size());
+        found->assign(locs.size(), false);
+        for (size_t i = 0; i < rds.size(); ++i) {
+            if (rds[i].data() == NULL)
+                continue;
+            (*out)[i] = Snapshotted<BSONObj>(snapshotId, rds[i].releaseToBson());
+            (*found)[i] = true;
+        }
+    }
+
     StatusWith<RecordId> Collection::insertDocument( OperationContext* txn,
                                                     const DocWriter* doc,
                                                     bool enforceQuota ) {
@@ -283,9 +306,23 @@ namespace mongo {
         }
 
         Snapshotted<BSONObj> doc = docFor(txn, loc);
+        deleteDocument(txn, loc, doc.value(), cappedOK, noWarn, deletedId);
+    }
+
+    void Collection::deleteDocument( OperationContext* txn,
+                                     const RecordId& loc,
+                                     const BSONObj& doc,
+                                     bool cappedOK,
+                                     bool noWarn,
+                                     BSONObj* deletedId ) {
+        if ( isCapped() && !cappedOK ) {
+            log() << "failing remove on a capped ns " << _ns << endl;
+            uasserted( 10089,  "cannot remove from a capped collection" );
+            return;
+        }
 
         if (deletedId) {
-            BSONElement e = doc.value()["_id"];
+            BSONElement e = doc["_id"];
             if (e.type()) {
                 *deletedId = e.wrap();
             }
@@ -294,9 +331,10 @@ namespace mongo {
         /* check if any cursors point to us.  if so, advance them. */
         _cursorManager.invalidateDocument(txn, loc, INVALIDATION_DELETION);
 
-        _indexCatalog.unindexRecord(txn, doc.value(), loc, noWarn);
+        _indexCatalog.unindexRecord(txn, doc, loc, noWarn);
 
-        _recordStore->deleteRecord(txn, loc);
+        // We already have the document, so the record store doesn't need to read it again.
+        _recordStore->deleteRecord(txn, loc, doc.objsize());
 
         _infoCache.notifyOfWriteOp();
     }
@@ -355,6 +393,8 @@ namespace mongo {
         // object is removed from all indexes.
         StatusWith<RecordId> newLocation = _recordStore->updateRecord( txn,
                                                                       oldLocation,
+                                                                      RecordData(objOld.value().objdata(),
+                                                                                 objOld.value().objsize()),
                                                                       objNew.objdata(),
                                                                       objNew.objsize(),
                                                                       _enforceQuota( enforceQuota ),
@@ -539,6 +579,68 @@ namespace mongo {
         return Status::OK();
     }
 
+    Status Collection::addPartition(OperationContext* txn) {
+        dassert(txn->lockState()->isCollectionLockedForMode(ns().toString(), MODE_X));
+        massert( 28701, "index build in progress", _indexCatalog.numIndexesInProgress( txn ) == 0 );
+
+        long long id;
+        Status status = _recordStore->addPartition(txn, &id);
+        if ( !status.isOK() )
+            return status;
+
+        RecordId min;
+        RecordId max;
+        status = _recordStore->getPartitionBounds(txn, id, &min, &max);
+        if ( !status.isOK() )
+            return status;
+
+        // Partitioned indexes follow the record store.  Unpartitioned ones are only noticed by
+        // dropPartition.
+        IndexCatalog::IndexIterator ii = _indexCatalog.getIndexIterator( txn, true );
+        while ( ii.more() ) {
+            IndexAccessMethod* iam = _indexCatalog.getIndex( ii.next() );
+            if ( !iam->isPartitioned() )
+                continue;
+            status = iam->addPartition( txn, id, RecordId( min.repr() - 1 ) );
+            if ( !status.isOK() )
+                return status;
+        }
+        return Status::OK();
+    }
+
+    Status Collection::dropPartition(OperationContext* txn, long long id) {
+        dassert(txn->lockState()->isCollectionLockedForMode(ns().toString(), MODE_X));
+        massert( 28627, "index build in progress", _indexCatalog.numIndexesInProgress( txn ) == 0 );
+
+        // Removing the partition's entries from an index that isn't split the same way would
+        // mean visiting every document in the partition, which is what dropping it is meant to
+        // avoid.
+        IndexCatalog::IndexIterator ii = _indexCatalog.getIndexIterator( txn, true );
+        while ( ii.more() ) {
+            IndexDescriptor* desc = ii.next();
+            if ( !_indexCatalog.getIndex( desc )->isPartitioned() ) {
+                return Status( ErrorCodes::IllegalOperation,
+                               str::stream() << "can't drop a partition of " << _ns.ns()
+                                             << ", index " << desc->indexName()
+                                             << " is not partitioned" );
+            }
+        }
+
+        Status status = _recordStore->dropPartition(txn, id);
+        if ( !status.isOK() )
+            return status;
+
+        IndexCatalog::IndexIterator jj = _indexCatalog.getIndexIterator( txn, true );
+        while ( jj.more() ) {
+            status = _indexCatalog.getIndex( jj.next() )->dropPartition( txn, id );
+            if ( !status.isOK() )
+                return status;
+        }
+
+        _cursorManager.invalidateAll( false );
+        return Status::OK();
+    }
+
     void Collection::temp_cappedTruncateAfter(OperationContext* txn,
                                               RecordId end,
                                               bool inclusive) {
@@ -552,16 +654,71 @@ namespace mongo {
     namespace {
         class MyValidateAdaptor : public ValidateAdaptor {
         public:
+            MyValidateAdaptor() { }
             virtual ~MyValidateAdaptor(){}
 
+            /**
+             * Also sums SortedDataInterface::hashEntry() of the keys each record should have in
+             * these indexes, if the record store tells us record ids.
+             */
+            void hashKeysFor( const std::vector<IndexAccessMethod*>& indexes ) {
+                _indexes = indexes;
+                _keyHashes.reset( new AtomicUInt64[indexes.size()] );
+            }
+
             virtual Status validate( const RecordData& record, size_t* dataSize ) {
+                // Without the record's id we can't hash its index entries.
+                _cantHashKeys.store( 1 );
+                _validate( record.toBson(), dataSize );
+                return Status::OK();
+            }
+
+            virtual Status validateRecord( const RecordId& id, const RecordData& record,
+                                           size_t* dataSize ) {
                 BSONObj obj = record.toBson();
+                if ( !_validate( obj, dataSize ) ) {
+                    // Already invalid, don't also blame the indexes.
+                    _cantHashKeys.store( 1 );
+                    return Status::OK();
+                }
+
+                try {
+                    for ( size_t i = 0; i < _indexes.size(); i++ ) {
+                        BSONObjSet keys;
+                        _indexes[i]->getKeys( obj, &keys );
+                        uint64_t hash = 0;
+                        for ( BSONObjSet::const_iterator it = keys.begin(); it != keys.end(); ++it ) {
+                            hash += SortedDataInterface::hashEntry( *it, id );
+                        }
+                        _keyHashes[i].fetchAndAdd( hash );
+                    }
+                }
+                catch ( const DBException& e ) {
+                    log() << "couldn't generate index keys for " << id << " during validate: "
+                          << e.toString();
+                    _cantHashKeys.store( 1 );
+                }
+                return Status::OK();
+            }
+
+            /**
+             * Returns false if some record's keys weren't hashed, so keyHash() is meaningless.
+             */
+            bool hashedAllKeys() const { return _cantHashKeys.load() == 0; }
+
+            uint64_t keyHash( size_t i ) const { return _keyHashes[i].load(); }
+
+        private:
+            bool _validate( const BSONObj& obj, size_t* dataSize ) {
                 const Status status = validateBSON(obj.objdata(), obj.objsize());
                 if ( status.isOK() )
                     *dataSize = obj.objsize();
-                return Status::OK();
+                return status.isOK();
             }
 
+            std::vector<IndexAccessMethod*> _indexes;
+            boost::scoped_array<AtomicUInt64> _keyHashes;
+            AtomicUInt32 _cantHashKeys;
         };
     }
 
@@ -570,10 +727,30 @@ namespace mongo {
                                  ValidateResults* results, BSONObjBuilder* output ){
         dassert(txn->lockState()->isCollectionLockedForMode(ns().toString(), MODE_IS));
 
+        std::vector<const IndexDescriptor*> descriptors;
+        std::vector<IndexAccessMethod*> iams;
+        IndexCatalog::IndexIterator i = _indexCatalog.getIndexIterator(txn, false);
+        while( i.more() ) {
+            const IndexDescriptor* descriptor = i.next();
+            IndexAccessMethod* iam = _indexCatalog.getIndex( descriptor );
+            invariant( iam );
+            descriptors.push_back( descriptor );
+            iams.push_back( iam );
+        }
+
+        // A full validate checks that each index has exactly the entries the documents should
+        // produce, by comparing sums of entry hashes rather than looking entries up.  The record
+        // and index scans must all read the same snapshot for these to agree.
         MyValidateAdaptor adaptor;
+        const bool checkIndexes = full && scanData;
+        if ( checkIndexes ) {
+            adaptor.hashKeysFor( iams );
+        }
+
         Status status = _recordStore->validate( txn, full, scanData, &adaptor, results, output );
         if ( !status.isOK() )
             return status;
+        const SnapshotId snapshot = txn->recoveryUnit()->getSnapshotId();
 
         { // indexes
             output->append("nIndexes", _indexCatalog.numIndexesReady( txn ) );
@@ -583,12 +760,10 @@ namespace mongo {
                 boost::scoped_ptr<BSONObjBuilder> indexDetails(full ? new BSONObjBuilder() : NULL);
                 BSONObjBuilder indexes; // not using subObjStart to be exception safe
 
-                IndexCatalog::IndexIterator i = _indexCatalog.getIndexIterator(txn, false);
-                while( i.more() ) {
-                    const IndexDescriptor* descriptor = i.next();
+                for ( size_t j = 0; j < descriptors.size(); j++ ) {
+                    const IndexDescriptor* descriptor = descriptors[j];
                     log(LogComponent::kIndex) << "validating index " << descriptor->indexNamespace() << endl;
-                    IndexAccessMethod* iam = _indexCatalog.getIndex( descriptor );
-                    invariant( iam );
+                    IndexAccessMethod* iam = iams[j];
 
                     boost::scoped_ptr<BSONObjBuilder> bob(
                         indexDetails.get() ? new BSONObjBuilder(
@@ -596,9 +771,33 @@ namespace mongo {
                         NULL);
 
                     int64_t keys;
-                    iam->validate(txn, full, &keys, bob.get());
+                    uint64_t hash;
+                    bool hashed = false;
+                    if ( checkIndexes && adaptor.hashedAllKeys() ) {
+                        hashed = iam->validateAndHash( txn, &keys, &hash, bob.get() ).isOK();
+                    }
+                    else {
+                        iam->validate(txn, full, &keys, bob.get());
+                    }
                     indexes.appendNumber(descriptor->indexNamespace(),
                                          static_cast<long long>(keys));
+
+                    if ( hashed && txn->recoveryUnit()->getSnapshotId() != snapshot ) {
+                        // The index was scanned on a newer snapshot than the documents.
+                        hashed = false;
+                    }
+                    if ( hashed ) {
+                        const bool consistent = hash == adaptor.keyHash( j );
+                        if ( bob ) {
+                            bob->appendBool( "consistentWithCollection", consistent );
+                        }
+                        if ( !consistent ) {
+                            results->errors.push_back( str::stream() << "index "
+                                                       << descriptor->indexNamespace()
+                                                       << " doesn't match the collection's documents" );
+                            results->valid = false;
+                        }
+                    }
                     idxn++;
                 }
 
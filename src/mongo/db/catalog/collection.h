@@ -138,6 +138,17 @@ namespace mongo {
          */
         bool findDoc(OperationContext* txn, const RecordId& loc, Snapshotted<BSONObj>* out) const;
 
+        /**
+         * Like findDoc, but looks up all of 'locs' together, which the record store may be able to
+         * do more cheaply.
+         * @param out - resized to locs.size(), out[i] is set to the document at locs[i] if it exists
+         * @param found - resized to locs.size(), found[i] is true iff locs[i] exists
+         */
+        void findDocs(OperationContext* txn,
+                      const std::vector<RecordId>& locs,
+                      std::vector<Snapshotted<BSONObj> >* out,
+                      std::vector<bool>* found) const;
+
         // ---- things that should move to a CollectionAccessMethod like thing
         /**
          * Default arguments will return all items in the collection.
@@ -159,6 +170,17 @@ namespace mongo {
                              bool noWarn = false,
                              BSONObj* deletedId = 0 );
 
+        /**
+         * Like deleteDocument above, for callers that have already read the document at 'loc' in
+         * the current snapshot, which saves reading it again.
+         */
+        void deleteDocument( OperationContext* txn,
+                             const RecordId& loc,
+                             const BSONObj& doc,
+                             bool cappedOK = false,
+                             bool noWarn = false,
+                             BSONObj* deletedId = 0 );
+
         /**
          * this does NOT modify the doc before inserting
          * i.e. will not add an _id field for documents that are missing it
@@ -225,7 +247,20 @@ namespace mongo {
         Status truncate(OperationContext* txn);
 
         /**
-         * @param full - does more checks
+         * Adds a partition to a partitioned collection, and to each of its partitioned indexes.
+         */
+        Status addPartition(OperationContext* txn);
+
+        /**
+         * Removes every document in one partition of a partitioned collection, and their index
+         * entries, by dropping the partition from the record store and each index.  Fails if any
+         * index isn't partitioned.
+         */
+        Status dropPartition(OperationContext* txn, long long id);
+
+        /**
+         * @param full - does more checks, including that the indexes have the entries the
+         *               documents should produce, if everything is scanned on one snapshot
          * @param scanData - scans each document
          * @return OK if the validate run successfully
          *         OK will be returned even if corruption is found
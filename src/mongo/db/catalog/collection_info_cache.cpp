@@ -37,6 +37,7 @@
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/concurrency/d_concurrency.h"
 #include "mongo/db/fts/fts_spec.h"
+#include "mongo/db/index/index_access_method.h"
 #include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/index_legacy.h"
 #include "mongo/db/query/plan_cache.h"
@@ -77,6 +78,11 @@ namespace mongo {
         while (i.more()) {
             IndexDescriptor* descriptor = i.next();
 
+            if (i.accessMethod(descriptor)->isClustering()) {
+                // A clustering index has a copy of the whole document, so any update changes it.
+                _indexedPaths.allPathsIndexed();
+            }
+
             if (descriptor->getAccessMethodName() != IndexNames::TEXT) {
                 BSONObj key = descriptor->keyPattern();
                 BSONObjIterator j(key);
@@ -62,6 +62,7 @@ namespace mongo {
         flags = Flag_UsePowerOf2Sizes;
         flagsSet = false;
         temp = false;
+        partitioned = false;
         storageEngine = BSONObj();
     }
 
@@ -124,6 +125,9 @@ namespace mongo {
             else if ( fieldName == "temp" ) {
                 temp = e.trueValue();
             }
+            else if ( fieldName == "partitioned" ) {
+                partitioned = e.trueValue();
+            }
             else if (fieldName == "storageEngine") {
                 // Storage engine-specific collection options.
                 // "storageEngine" field must be of type "document".
@@ -165,6 +169,11 @@ namespace mongo {
             }
         }
 
+        if ( capped && partitioned ) {
+            return Status( ErrorCodes::BadValue,
+                           "a collection can't be both capped and partitioned" );
+        }
+
         return Status::OK();
     }
 
@@ -192,6 +201,9 @@ namespace mongo {
         if ( temp )
             b.appendBool( "temp", true );
 
+        if ( partitioned )
+            b.appendBool( "partitioned", true );
+
         if (!storageEngine.isEmpty()) {
             b.append("storageEngine", storageEngine);
         }
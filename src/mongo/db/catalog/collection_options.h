@@ -85,6 +85,10 @@ namespace mongo {
 
         bool temp;
 
+        // Records are kept in partitions that can be added and dropped, if the storage engine
+        // supports it.  Can't be combined with capped.
+        bool partitioned;
+
         // Storage engine collection options. Always owned or empty.
         BSONObj storageEngine;
     };
@@ -65,6 +65,15 @@ namespace mongo {
                                                                  << ( 1LL << 31 ) ) ) );
     }
 
+    TEST( CollectionOptions, Partitioned ) {
+        CollectionOptions options;
+        ASSERT_OK( options.parse( fromjson( "{partitioned: true}" ) ) );
+        ASSERT( options.partitioned );
+        checkRoundTrip( options );
+
+        ASSERT_NOT_OK( CollectionOptions().parse( fromjson( "{capped: true, size: 1024, partitioned: true}" ) ) );
+    }
+
     TEST( CollectionOptions, IgnoreSizeWrongType ) {
         CollectionOptions options;
         ASSERT_OK( options.parse( fromjson( "{size: undefined, capped: undefined}" ) ) );
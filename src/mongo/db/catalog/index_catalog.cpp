@@ -539,6 +539,12 @@ namespace {
             }
         }
 
+        if ( spec["clustering"].trueValue() &&
+             IndexNames::findPluginName( key ) != IndexNames::BTREE ) {
+            return Status( ErrorCodes::CannotCreateIndex,
+                           "only btree indexes can be clustering" );
+        }
+
         BSONElement storageEngineElement = spec.getField("storageEngine");
         if (storageEngineElement.eoo()) {
             return Status::OK();
@@ -0,0 +1,198 @@
+// partition_commands.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#include "mongo/platform/basic.h"
+
+#include <string>
+#include <vector>
+
+#include "mongo/db/auth/action_set.h"
+#include "mongo/db/auth/action_type.h"
+#include "mongo/db/auth/privilege.h"
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/catalog/database.h"
+#include "mongo/db/client.h"
+#include "mongo/db/commands.h"
+#include "mongo/db/concurrency/d_concurrency.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/operation_context.h"
+#include "mongo/db/repl/oplog.h"
+#include "mongo/db/repl/replication_coordinator_global.h"
+#include "mongo/db/storage/record_store.h"
+
+namespace mongo {
+
+    using std::string;
+    using std::stringstream;
+
+    namespace {
+
+        /**
+         * Common parts of the commands that change a partitioned collection's partitions.  They
+         * are replicated as commands, so each member splits its own RecordIds at the same point
+         * in the oplog.
+         */
+        class PartitionWriteCommand : public Command {
+        public:
+            explicit PartitionWriteCommand(StringData name) : Command(name) { }
+
+            virtual bool slaveOk() const { return false; }
+            virtual bool isWriteCommandForConfigServer() const { return false; }
+            virtual void addRequiredPrivileges(const std::string& dbname,
+                                               const BSONObj& cmdObj,
+                                               std::vector<Privilege>* out) {
+                ActionSet actions;
+                actions.addAction(ActionType::collMod);
+                out->push_back(Privilege(parseResourcePattern(dbname, cmdObj), actions));
+            }
+
+            virtual bool run(OperationContext* txn,
+                             const string& dbname,
+                             BSONObj& cmdObj,
+                             int,
+                             string& errmsg,
+                             BSONObjBuilder& result,
+                             bool fromRepl) {
+                const std::string ns = parseNsCollectionRequired(dbname, cmdObj);
+
+                ScopedTransaction transaction(txn, MODE_IX);
+                AutoGetDb autoDb(txn, dbname, MODE_X);
+                Database* const db = autoDb.getDb();
+                Collection* coll = db ? db->getCollection(ns) : NULL;
+                if ( !coll ) {
+                    errmsg = "ns does not exist";
+                    return false;
+                }
+
+                Client::Context ctx(txn, ns);
+                if (!fromRepl &&
+                    !repl::getGlobalReplicationCoordinator()->canAcceptWritesForDatabase(dbname)) {
+                    return appendCommandStatus(result, Status(ErrorCodes::NotMaster, str::stream()
+                        << "Not primary while changing the partitions of " << ns));
+                }
+
+                WriteUnitOfWork wunit(txn);
+                Status status = apply(txn, coll, cmdObj);
+                if ( !status.isOK() ) {
+                    return appendCommandStatus(result, status);
+                }
+
+                if (!fromRepl) {
+                    repl::logOp(txn, "c", (dbname + ".$cmd").c_str(), cmdObj);
+                }
+
+                wunit.commit();
+                return true;
+            }
+
+        protected:
+            virtual Status apply(OperationContext* txn, Collection* coll, const BSONObj& cmdObj) = 0;
+        };
+
+        class AddPartitionCmd : public PartitionWriteCommand {
+        public:
+            AddPartitionCmd() : PartitionWriteCommand("addPartition") { }
+
+            virtual void help( stringstream& help ) const {
+                help << "add a partition to a partitioned collection\n"
+                    "{ addPartition : <collection_name> }\n"
+                    "documents inserted from now on go into the new partition\n";
+            }
+
+        protected:
+            virtual Status apply(OperationContext* txn, Collection* coll, const BSONObj& cmdObj) {
+                return coll->addPartition(txn);
+            }
+        } addPartitionCmd;
+
+        class DropPartitionCmd : public PartitionWriteCommand {
+        public:
+            DropPartitionCmd() : PartitionWriteCommand("dropPartition") { }
+
+            virtual void help( stringstream& help ) const {
+                help << "drop a partition of a partitioned collection, and all its documents\n"
+                    "{ dropPartition : <collection_name>, id : <partition_id> }\n"
+                    "the last partition can't be dropped, see getPartitionInfo for ids\n";
+            }
+
+        protected:
+            virtual Status apply(OperationContext* txn, Collection* coll, const BSONObj& cmdObj) {
+                const BSONElement id = cmdObj["id"];
+                if ( !id.isNumber() ) {
+                    return Status(ErrorCodes::BadValue, "dropPartition requires a numeric id");
+                }
+                return coll->dropPartition(txn, id.numberLong());
+            }
+        } dropPartitionCmd;
+
+        class GetPartitionInfoCmd : public Command {
+        public:
+            GetPartitionInfoCmd() : Command("getPartitionInfo") { }
+
+            virtual bool slaveOk() const { return true; }
+            virtual bool isWriteCommandForConfigServer() const { return false; }
+            virtual void help( stringstream& help ) const {
+                help << "list the partitions of a partitioned collection\n"
+                    "{ getPartitionInfo : <collection_name> }\n"
+                    "sizes are estimates\n";
+            }
+            virtual void addRequiredPrivileges(const std::string& dbname,
+                                               const BSONObj& cmdObj,
+                                               std::vector<Privilege>* out) {
+                ActionSet actions;
+                actions.addAction(ActionType::collStats);
+                out->push_back(Privilege(parseResourcePattern(dbname, cmdObj), actions));
+            }
+
+            virtual bool run(OperationContext* txn,
+                             const string& dbname,
+                             BSONObj& cmdObj,
+                             int,
+                             string& errmsg,
+                             BSONObjBuilder& result,
+                             bool fromRepl) {
+                const std::string ns = parseNsCollectionRequired(dbname, cmdObj);
+
+                AutoGetCollectionForRead ctx(txn, ns);
+                Collection* coll = ctx.getCollection();
+                if ( !coll ) {
+                    errmsg = "ns does not exist";
+                    return false;
+                }
+
+                return appendCommandStatus(result,
+                                           coll->getRecordStore()->appendPartitionInfo(txn, &result));
+            }
+        } getPartitionInfoCmd;
+
+    }
+
+}
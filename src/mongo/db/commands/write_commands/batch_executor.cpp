@@ -48,6 +48,7 @@
 #include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/exec/delete.h"
 #include "mongo/db/exec/update.h"
+#include "mongo/db/global_environment_experiment.h"
 #include "mongo/db/ops/delete_request.h"
 #include "mongo/db/ops/parsed_delete.h"
 #include "mongo/db/ops/parsed_update.h"
@@ -105,6 +106,11 @@ namespace mongo {
     // TODO: Determine queueing behavior we want here
     MONGO_EXPORT_SERVER_PARAMETER( queueForMigrationCommit, bool, true );
 
+    // On storage engines with document-level locking, insert batches are committed this many
+    // documents (or this many bytes) at a time, rather than one document at a time.
+    MONGO_EXPORT_SERVER_PARAMETER( internalInsertGroupMaxDocs, int, 64 );
+    MONGO_EXPORT_SERVER_PARAMETER( internalInsertGroupMaxBytes, int, 256 * 1024 );
+
     using mongoutils::str::stream;
 
     WriteBatchExecutor::WriteBatchExecutor( OperationContext* txn,
@@ -830,6 +836,38 @@ namespace mongo {
         }
     }
 
+    /**
+     * Returns the document to insert for the insert at index "i".  Requires that its
+     * normalization succeeded.
+     */
+    static const BSONObj& insertDocAt(WriteBatchExecutor::ExecInsertsState* state, size_t i) {
+        const StatusWith<BSONObj>& normalizedInsert(state->normalizedInserts[i]);
+        return normalizedInsert.getValue().isEmpty() ?
+            state->request->getInsertRequest()->getDocumentsAt( i ) :
+            normalizedInsert.getValue();
+    }
+
+    /**
+     * Returns the end of the run of inserts starting at the current one that execInsertGroup
+     * should try together: valid documents only, within the group size limits.
+     */
+    static size_t insertGroupEnd(WriteBatchExecutor::ExecInsertsState* state) {
+        size_t end = state->currIndex;
+        int bytes = 0;
+        while (end < state->normalizedInserts.size() &&
+               end - state->currIndex < static_cast<size_t>(internalInsertGroupMaxDocs)) {
+            if (!state->normalizedInserts[end].isOK()) {
+                break;
+            }
+            bytes += insertDocAt(state, end).objsize();
+            if (end > state->currIndex && bytes > internalInsertGroupMaxBytes) {
+                break;
+            }
+            ++end;
+        }
+        return end;
+    }
+
     void WriteBatchExecutor::execInserts( const BatchedCommandRequest& request,
                                           std::vector<WriteErrorDetail*>* errors ) {
 
@@ -852,9 +890,19 @@ namespace mongo {
         // particularly on operation interruption.  These kinds of errors necessarily prevent
         // further insertOne calls, and stop the batch.  As a result, the only expected source of
         // such exceptions are interruptions.
+        //
+        // On storage engines with document-level locking, runs of valid documents are first tried
+        // as one unit of work by execInsertGroup().  If that fails, the documents in that run go
+        // through insertOne() one at a time.
         ExecInsertsState state(_txn, &request);
         normalizeInserts(request, &state.normalizedInserts);
 
+        const bool groupInserts = supportsDocLocking() &&
+                                  !request.isInsertIndexRequest() &&
+                                  internalInsertGroupMaxDocs > 1;
+        // Inserts before this index are done one at a time, because their group failed.
+        size_t ungroupedEnd = 0;
+
         // Yield frequency is based on the same constants used by PlanYieldPolicy.
         ElapsedTracker elapsedTracker(internalQueryExecYieldIterations,
                                       internalQueryExecYieldPeriodMS);
@@ -880,6 +928,17 @@ namespace mongo {
                 elapsedTracker.resetLastTime();
             }
 
+            if (groupInserts && state.currIndex >= ungroupedEnd) {
+                const size_t groupEnd = insertGroupEnd(&state);
+                if (groupEnd - state.currIndex > 1) {
+                    if (execInsertGroup(&state, groupEnd)) {
+                        state.currIndex = groupEnd - 1;
+                        continue;
+                    }
+                    ungroupedEnd = groupEnd;
+                }
+            }
+
             WriteErrorDetail* error = NULL;
             execOneInsert(&state, &error);
             if (error) {
@@ -1058,9 +1117,7 @@ namespace mongo {
             return;
         }
 
-        const BSONObj& insertDoc = normalizedInsert.getValue().isEmpty() ?
-            state->request->getInsertRequest()->getDocumentsAt( state->currIndex ) :
-            normalizedInsert.getValue();
+        const BSONObj& insertDoc = insertDocAt(state, state->currIndex);
 
         int attempt = 0;
         while (true) {
@@ -1121,6 +1178,63 @@ namespace mongo {
         }
     }
 
+    bool WriteBatchExecutor::execInsertGroup(ExecInsertsState* state, size_t end) {
+        invariant(!_txn->lockState()->inAWriteUnitOfWork());
+
+        {
+            // If we can't lock, insertOne() will find out again and report it.
+            WriteOpResult lockResult;
+            if (!state->lockAndCheck(&lockResult)) {
+                return false;
+            }
+        }
+
+        try {
+            Collection* collection = state->getCollection();
+            const string& insertNS = collection->ns().ns();
+
+            WriteUnitOfWork wunit(_txn);
+            for (size_t i = state->currIndex; i < end; ++i) {
+                const BSONObj& insertDoc = insertDocAt(state, i);
+                StatusWith<RecordId> status = collection->insertDocument(_txn, insertDoc, true);
+                if (!status.isOK()) {
+                    return false;
+                }
+                repl::logOp(_txn, "i", insertNS.c_str(), insertDoc);
+            }
+            wunit.commit();
+        }
+        catch ( const WriteConflictException& wce ) {
+            _txn->getCurOp()->debug().writeConflicts++;
+            state->unlock();
+            _txn->recoveryUnit()->commitAndRestart();
+            return false;
+        }
+        catch (const DBException& ex) {
+            if (ErrorCodes::isInterruption(ErrorCodes::fromInt(ex.getCode())))
+                throw;
+            return false;
+        }
+
+        // Account for each insert as if it had been done by itself.
+        for (size_t i = state->currIndex; i < end; ++i) {
+            BatchItemRef currInsertItem(state->request, i);
+            CurOp currentOp( _txn->getClient(), _txn->getClient()->curop() );
+            beginCurrentOp( &currentOp, _txn->getClient(), currInsertItem );
+            incOpStats(currInsertItem);
+
+            WriteOpResult result;
+            result.getStats().n = 1;
+
+            incWriteStats(currInsertItem,
+                          result.getStats(),
+                          result.getError(),
+                          &currentOp);
+            finishCurrentOp(_txn, &currentOp, result.getError());
+        }
+        return true;
+    }
+
     /**
      * Perform a single insert into a collection.  Requires the insert be preprocessed and the
      * collection already has been created.
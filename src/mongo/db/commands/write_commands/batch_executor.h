@@ -104,6 +104,15 @@ namespace mongo {
          */
         void execOneInsert( ExecInsertsState* state, WriteErrorDetail** error );
 
+        /**
+         * Executes the inserts from the current one up to (not including) "end" in a single unit
+         * of work.  Returns false, having inserted nothing, if any of them fails or conflicts, so
+         * that the caller can insert them one at a time and report errors for the right ones.
+         *
+         * Only used on storage engines with document-level locking.
+         */
+        bool execInsertGroup( ExecInsertsState* state, size_t end );
+
         /**
          * Executes an update item (which may update many documents or upsert), and returns the
          * upserted _id on upsert or error on failure.
@@ -67,6 +67,8 @@ namespace {
 
 
     RWLockRecursive Lock::ParallelBatchWriterMode::_batchLock("special");
+    RWLock Lock::SnapshotGate::_snapshotLock("snapshotGate");
+    AtomicUInt32 Lock::SnapshotGate::_active;
 
 
     Lock::TempRelease::TempRelease(Locker* lockState)
@@ -32,6 +32,7 @@
 #include <climits> // For UINT_MAX
 
 #include "mongo/db/concurrency/locker.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/util/concurrency/rwlock.h"
 #include "mongo/util/timer.h"
 
@@ -81,6 +82,39 @@ namespace mongo {
         };
 
 
+        /**
+         * Guards the start of storage engine snapshots, on engines that support it (see
+         * StorageEngine::supportsBatchSnapshotReads).  Readers hold it shared just while they
+         * start a snapshot, and the oplog applier holds it exclusively while it commits a batch,
+         * so that no snapshot sees part of a batch.  It must never be held while waiting for
+         * other locks.
+         *
+         * Readers only need it while it is active, which the applier sets before committing a
+         * batch this way, so nodes that never do don't pay for it.
+         */
+        class SnapshotGate {
+            MONGO_DISALLOW_COPYING(SnapshotGate);
+        public:
+            explicit SnapshotGate(bool exclusive) : _lk(_snapshotLock, exclusive) { }
+
+            static bool isActive() { return _active.loadRelaxed() != 0; }
+
+            /**
+             * Only the oplog applier calls this.  Once it activates the gate, it must wait for
+             * readers that didn't take it to have started their snapshots before committing a
+             * batch under it.
+             */
+            static void setActive(bool active) { _active.store(active ? 1 : 0); }
+
+            static RWLock _snapshotLock;
+
+        private:
+            static AtomicUInt32 _active;
+
+            rwlock _lk;
+        };
+
+
         /**
          * Global lock.
          *
@@ -155,8 +155,17 @@ namespace mongo {
                     const bool deleteNoWarn = false;
                     BSONObj deletedDoc;
 
-                    _collection->deleteDocument(_txn, rloc, deleteCappedOK, deleteNoWarn,
-                                                _params.shouldCallLogOp ? &deletedDoc : NULL);
+                    if (member->hasObj()) {
+                        // The snapshot check above guarantees this is the current version of the
+                        // document, so pass it down rather than having it read again.
+                        _collection->deleteDocument(_txn, rloc, member->obj.value(),
+                                                    deleteCappedOK, deleteNoWarn,
+                                                    _params.shouldCallLogOp ? &deletedDoc : NULL);
+                    }
+                    else {
+                        _collection->deleteDocument(_txn, rloc, deleteCappedOK, deleteNoWarn,
+                                                    _params.shouldCallLogOp ? &deletedDoc : NULL);
+                    }
 
                     if (_params.shouldCallLogOp) {
                         if (deletedDoc.isEmpty()) {
@@ -30,11 +30,15 @@
 
 #include "mongo/db/exec/fetch.h"
 
+#include <algorithm>
+
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/exec/filter.h"
 #include "mongo/db/exec/scoped_timer.h"
 #include "mongo/db/exec/working_set_common.h"
+#include "mongo/db/global_environment_experiment.h"
+#include "mongo/db/query/query_knobs.h"
 #include "mongo/db/storage/record_fetcher.h"
 #include "mongo/util/fail_point_service.h"
 #include "mongo/util/mongoutils/str.h"
@@ -58,6 +62,8 @@ namespace mongo {
           _child(child),
           _filter(filter),
           _idRetrying(WorkingSet::INVALID_ID),
+          _batching(supportsDocLocking() && internalQueryExecFetchBatchSize > 1),
+          _batchSize(1),
           _commonStats(kStageType) { }
 
     FetchStage::~FetchStage() { }
@@ -69,6 +75,10 @@ namespace mongo {
             return false;
         }
 
+        if (!_pending.empty() || !_fetched.empty()) {
+            return false;
+        }
+
         return _child->isEOF();
     }
 
@@ -80,6 +90,10 @@ namespace mongo {
 
         if (isEOF()) { return PlanStage::IS_EOF; }
 
+        if (_batching) {
+            return workBatched(out);
+        }
+
         // Either retry the last WSM we worked on or get a new one from our child.
         WorkingSetID id;
         StageState status;
@@ -137,7 +151,95 @@ namespace mongo {
 
             return returnIfMatches(member, id, out);
         }
-        else if (PlanStage::FAILURE == status) {
+
+        return passThrough(status, id, out);
+    }
+
+    PlanStage::StageState FetchStage::workBatched(WorkingSetID* out) {
+        // Hand back anything we've already fetched, in the order our child produced it.
+        if (!_fetched.empty()) {
+            WorkingSetID id = _fetched.front();
+            _fetched.pop_front();
+            return returnIfMatches(_ws->get(id), id, out);
+        }
+
+        if (_pending.size() < _batchSize && !_child->isEOF()) {
+            WorkingSetID id = WorkingSet::INVALID_ID;
+            StageState status = _child->work(&id);
+            if (PlanStage::ADVANCED == status) {
+                _pending.push_back(id);
+                if (_pending.size() < _batchSize && !_child->isEOF()) {
+                    ++_commonStats.needTime;
+                    return NEED_TIME;
+                }
+            }
+            else if (PlanStage::IS_EOF != status) {
+                return passThrough(status, id, out);
+            }
+        }
+
+        if (_pending.empty()) {
+            ++_commonStats.needTime;
+            return NEED_TIME;
+        }
+
+        std::vector<WorkingSetID> toFetch;
+        for (size_t i = 0; i < _pending.size(); ++i) {
+            WorkingSetMember* member = _ws->get(_pending[i]);
+            if (!member->hasObj()) {
+                // We need a valid loc to fetch from and this is the only state that has one.
+                verify(WorkingSetMember::LOC_AND_IDX == member->state);
+                verify(member->hasLoc());
+                toFetch.push_back(_pending[i]);
+            }
+        }
+
+        std::vector<bool> fetched;
+        if (!toFetch.empty()) {
+            try {
+                WorkingSetCommon::fetchMany(_txn, _ws, toFetch, _collection, &fetched);
+            }
+            catch (const WriteConflictException& wce) {
+                // The members are untouched, we'll try the whole batch again after yielding.
+                *out = WorkingSet::INVALID_ID;
+                _commonStats.needYield++;
+                return NEED_YIELD;
+            }
+        }
+
+        // toFetch is a subsequence of _pending.
+        size_t j = 0;
+        for (size_t i = 0; i < _pending.size(); ++i) {
+            const WorkingSetID id = _pending[i];
+            if (j < toFetch.size() && toFetch[j] == id) {
+                if (!fetched[j++]) {
+                    _ws->free(id);
+                    continue;
+                }
+            }
+            else {
+                ++_specificStats.alreadyHasObj;
+            }
+            _fetched.push_back(id);
+        }
+        _pending.clear();
+
+        _batchSize = std::min(_batchSize * 2, static_cast<size_t>(internalQueryExecFetchBatchSize));
+
+        if (_fetched.empty()) {
+            ++_commonStats.needTime;
+            return NEED_TIME;
+        }
+
+        WorkingSetID id = _fetched.front();
+        _fetched.pop_front();
+        return returnIfMatches(_ws->get(id), id, out);
+    }
+
+    PlanStage::StageState FetchStage::passThrough(StageState status,
+                                                  WorkingSetID id,
+                                                  WorkingSetID* out) {
+        if (PlanStage::FAILURE == status) {
             *out = id;
             // If a stage fails, it may create a status WSM to indicate why it
             // failed, in which case 'id' is valid.  If ID is invalid, we
@@ -188,6 +290,21 @@ namespace mongo {
                 WorkingSetCommon::fetchAndInvalidateLoc(txn, member, _collection);
             }
         }
+
+        // Same for anything in our batch.
+        for (size_t i = 0; i < _pending.size(); ++i) {
+            WorkingSetMember* member = _ws->get(_pending[i]);
+            if (member->hasLoc() && (member->loc == dl)) {
+                WorkingSetCommon::fetchAndInvalidateLoc(txn, member, _collection);
+            }
+        }
+        for (std::deque<WorkingSetID>::const_iterator it = _fetched.begin();
+             it != _fetched.end(); ++it) {
+            WorkingSetMember* member = _ws->get(*it);
+            if (member->hasLoc() && (member->loc == dl)) {
+                WorkingSetCommon::fetchAndInvalidateLoc(txn, member, _collection);
+            }
+        }
     }
 
     PlanStage::StageState FetchStage::returnIfMatches(WorkingSetMember* member,
@@ -29,6 +29,8 @@
 #pragma once
 
 #include <boost/scoped_ptr.hpp>
+#include <deque>
+#include <vector>
 
 #include "mongo/db/exec/plan_stage.h"
 #include "mongo/db/jsobj.h"
@@ -43,6 +45,12 @@ namespace mongo {
      * In WorkingSetMember terms, it transitions from LOC_AND_IDX to LOC_AND_UNOWNED_OBJ by reading
      * the record at the provided loc.  Returns verbatim any data that already has an object.
      *
+     * On storage engines with document-level locking, the records for several consecutive results
+     * from the child are read from the collection together, which lets the storage engine read
+     * nearby records with one cursor.  The batch starts at one document and doubles up to
+     * internalQueryExecFetchBatchSize, so queries that only want a few results don't read more
+     * than they need.
+     *
      * Preconditions: Valid RecordId.
      */
     class FetchStage : public PlanStage {
@@ -76,6 +84,16 @@ namespace mongo {
 
     private:
 
+        /**
+         * work() for the batched mode, see the class comment.
+         */
+        StageState workBatched(WorkingSetID* out);
+
+        /**
+         * Handles any state other than ADVANCED returned by our child.
+         */
+        StageState passThrough(StageState status, WorkingSetID id, WorkingSetID* out);
+
         /**
          * If the member (with id memberID) passes our filter, set *out to memberID and return that
          * ADVANCED.  Otherwise, free memberID and return NEED_TIME.
@@ -99,6 +117,18 @@ namespace mongo {
         // If not Null, we use this rather than asking our child what to do next.
         WorkingSetID _idRetrying;
 
+        // Whether we fetch documents in batches.
+        const bool _batching;
+
+        // The number of documents we'll gather from our child before fetching them.
+        size_t _batchSize;
+
+        // Members we got from our child that have yet to be fetched, in the order we got them.
+        std::vector<WorkingSetID> _pending;
+
+        // Members that have been fetched (or already had an obj), waiting to be returned.
+        std::deque<WorkingSetID> _fetched;
+
         // Stats
         CommonStats _commonStats;
         FetchStats _specificStats;
@@ -69,6 +69,7 @@ namespace mongo {
           _workingSet(workingSet),
           _scanState(INITIALIZING),
           _filter(filter),
+          _fetchFromIndex(false),
           _shouldDedup(true),
           _params(params),
           _commonStats(kStageType),
@@ -77,6 +78,7 @@ namespace mongo {
           _movePastKeyElts(false),
           _endKeyInclusive(false) {
         _iam = _params.descriptor->getIndexCatalog()->getIndex(_params.descriptor);
+        _fetchFromIndex = _params.fetchFromIndex && _iam->isClustering();
         _keyPattern = _params.descriptor->keyPattern().getOwned();
 
         // We can't always access the descriptor in the call to getStats() so we pull
@@ -117,6 +119,7 @@ namespace mongo {
 
         if (_params.bounds.isSimpleRange) {
             // Start at one key, end at another.
+            _indexCursor->setEndPosition(_params.bounds.endKey, _params.bounds.endKeyInclusive);
             Status status = _indexCursor->seek(_params.bounds.startKey);
             if (!status.isOK()) {
                 warning() << "IndexCursor seek failed: " << status.toString();
@@ -141,6 +144,7 @@ namespace mongo {
                                                      &_endKeyInclusive)) {
                 // We want to point at the start key if it's inclusive, and we want to point past
                 // the start key if it's exclusive.
+                _btreeCursor->setEndPosition(_endKey, _endKeyInclusive);
                 _btreeCursor->seek(startKey, !startKeyInclusive);
 
                 IndexCursor* endCursor;
@@ -234,6 +238,12 @@ namespace mongo {
                 keyObj = keyObj.getOwned();
             }
 
+            Snapshotted<BSONObj> doc;
+            if (filterPasses && _fetchFromIndex) {
+                doc = Snapshotted<BSONObj>(_txn->recoveryUnit()->getSnapshotId(),
+                                           _indexCursor->getDocument());
+            }
+
             _scanState = CHECKING_END;
 
             // Move to the next result.
@@ -274,6 +284,11 @@ namespace mongo {
                 member->keyData.push_back(IndexKeyDatum(_keyPattern, keyObj, _iam));
                 member->state = WorkingSetMember::LOC_AND_IDX;
 
+                if (!doc.value().isEmpty()) {
+                    member->obj = doc;
+                    member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+                }
+
                 if (_params.addKeyMetadata) {
                     BSONObjBuilder bob;
                     bob.appendKeys(_keyPattern, keyObj);
@@ -51,7 +51,8 @@ namespace mongo {
                             direction(1),
                             doNotDedup(false),
                             maxScan(0),
-                            addKeyMetadata(false) { }
+                            addKeyMetadata(false),
+                            fetchFromIndex(false) { }
 
         const IndexDescriptor* descriptor;
 
@@ -66,6 +67,10 @@ namespace mongo {
 
         // Do we want to add the key as metadata?
         bool addKeyMetadata;
+
+        // Is there a FETCH above us?  If so, and the index is clustering, we hand it the
+        // documents straight from the index.  Covered plans don't want them copied.
+        bool fetchFromIndex;
     };
 
     /**
@@ -154,6 +159,10 @@ namespace mongo {
         // The filter is not owned by us.
         const MatchExpression* _filter;
 
+        // Do we return documents straight from a clustering index, to save the FETCH stage a
+        // lookup?
+        bool _fetchFromIndex;
+
         // Could our index have duplicates?  If so, we use _returned to dedup.
         bool _shouldDedup;
         unordered_set<RecordId, RecordId::Hasher> _returned;
@@ -73,6 +73,38 @@ namespace mongo {
         }
     }
 
+    namespace {
+
+        /**
+         * Finishes a fetch once 'member->obj' holds the document.  Returns false if the document
+         * no longer matches the index keys it was found with.
+         */
+        bool finishFetch(WorkingSetMember* member) {
+            if (member->isSuspicious) {
+                // Make sure that all of the keyData is still valid for this copy of the document.
+                // This ensures both that index-provided filters and sort orders still hold.
+                // TODO provide a way for the query planner to opt out of this checking if it is
+                // unneeded due to the structure of the plan.
+                invariant(!member->keyData.empty());
+                for (size_t i = 0; i < member->keyData.size(); i++) {
+                    BSONObjSet keys;
+                    member->keyData[i].index->getKeys(member->obj.value(), &keys);
+                    if (!keys.count(member->keyData[i].keyData)) {
+                        // document would no longer be at this position in the index.
+                        return false;
+                    }
+                }
+
+                member->isSuspicious = false;
+            }
+
+            member->keyData.clear();
+            member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
+            return true;
+        }
+
+    }  // namespace
+
     // static
     bool WorkingSetCommon::fetch(OperationContext* txn,
                                  WorkingSetMember* member,
@@ -89,27 +121,37 @@ namespace mongo {
             return false;
         }
 
-        if (member->isSuspicious) {
-            // Make sure that all of the keyData is still valid for this copy of the document.
-            // This ensures both that index-provided filters and sort orders still hold.
-            // TODO provide a way for the query planner to opt out of this checking if it is
-            // unneeded due to the structure of the plan.
-            invariant(!member->keyData.empty());
-            for (size_t i = 0; i < member->keyData.size(); i++) {
-                BSONObjSet keys;
-                member->keyData[i].index->getKeys(member->obj.value(), &keys);
-                if (!keys.count(member->keyData[i].keyData)) {
-                    // document would no longer be at this position in the index.
-                    return false;
-                }
-            }
+        return finishFetch(member);
+    }
 
-            member->isSuspicious = false;
+    // static
+    void WorkingSetCommon::fetchMany(OperationContext* txn,
+                                     WorkingSet* workingSet,
+                                     const std::vector<WorkingSetID>& ids,
+                                     const Collection* collection,
+                                     std::vector<bool>* fetched) {
+        std::vector<RecordId> locs;
+        locs.reserve(ids.size());
+        for (size_t i = 0; i < ids.size(); ++i) {
+            WorkingSetMember* member = workingSet->get(ids[i]);
+            invariant(!member->hasFetcher());
+            invariant(member->hasLoc());
+            locs.push_back(member->loc);
         }
 
-        member->keyData.clear();
-        member->state = WorkingSetMember::LOC_AND_UNOWNED_OBJ;
-        return true;
+        // This is the only thing that can throw, so the members stay untouched if it does.
+        std::vector<Snapshotted<BSONObj> > docs;
+        collection->findDocs(txn, locs, &docs, fetched);
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            WorkingSetMember* member = workingSet->get(ids[i]);
+            member->obj.reset();
+            if (!(*fetched)[i]) {
+                continue;
+            }
+            member->obj = docs[i];
+            (*fetched)[i] = finishFetch(member);
+        }
     }
 
     // static
@@ -68,6 +68,20 @@ namespace mongo {
                           WorkingSetMember* member,
                           const Collection* collection);
 
+        /**
+         * Like fetch, but retrieves the documents for all of 'ids' from 'collection' at once.  None
+         * of the members may already have an obj.  Sets (*fetched)[i] to what fetch() would have
+         * returned for ids[i]; it is the caller's responsibility to free the members that weren't
+         * fetched.
+         *
+         * WriteConflict exceptions may be thrown. When they are, the members will be unmodified.
+         */
+        static void fetchMany(OperationContext* txn,
+                              WorkingSet* workingSet,
+                              const std::vector<WorkingSetID>& ids,
+                              const Collection* collection,
+                              std::vector<bool>* fetched);
+
         static bool fetchIfUnfetched(OperationContext* txn,
                                      WorkingSetMember* member,
                                      const Collection* collection) {
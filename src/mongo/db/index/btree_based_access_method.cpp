@@ -78,9 +78,13 @@ namespace mongo {
         // Delegate to the subclass.
         getKeys(obj, &keys);
 
+        const bool clustering = _newInterface->isClustering();
+
         Status ret = Status::OK();
         for (BSONObjSet::const_iterator i = keys.begin(); i != keys.end(); ++i) {
-            Status status = _newInterface->insert(txn, *i, loc, options.dupsAllowed);
+            Status status = clustering
+                ? _newInterface->insertWithDocument(txn, *i, loc, obj, options.dupsAllowed)
+                : _newInterface->insert(txn, *i, loc, options.dupsAllowed);
 
             // Everything's OK, carry on.
             if (status.isOK()) {
@@ -228,6 +232,31 @@ namespace mongo {
         return Status::OK();
     }
 
+    Status BtreeBasedAccessMethod::validateAndHash(OperationContext* txn, int64_t* numKeys,
+                                                   uint64_t* hashOut, BSONObjBuilder* output) {
+        long long keys;
+        Status s = _newInterface->fullValidateAndHash(txn, &keys, hashOut, output);
+        *numKeys = keys;
+        return s;
+    }
+
+    bool BtreeBasedAccessMethod::isClustering() const {
+        return _newInterface->isClustering();
+    }
+
+    bool BtreeBasedAccessMethod::isPartitioned() const {
+        return _newInterface->isPartitioned();
+    }
+
+    Status BtreeBasedAccessMethod::addPartition(OperationContext* txn, long long id,
+                                                const RecordId& lastMax) {
+        return _newInterface->addPartition(txn, id, lastMax);
+    }
+
+    Status BtreeBasedAccessMethod::dropPartition(OperationContext* txn, long long id) {
+        return _newInterface->dropPartition(txn, id);
+    }
+
     bool BtreeBasedAccessMethod::appendCustomStats(OperationContext* txn,
                                                    BSONObjBuilder* output,
                                                    double scale) const {
@@ -252,6 +281,9 @@ namespace mongo {
         getKeys(to, &data->newKeys);
         data->loc = record;
         data->dupsAllowed = options.dupsAllowed;
+        if (_newInterface->isClustering()) {
+            data->newDoc = to;
+        }
 
         setDifference(data->oldKeys, data->newKeys, &data->removed);
         setDifference(data->newKeys, data->oldKeys, &data->added);
@@ -282,13 +314,42 @@ namespace mongo {
                                    data->dupsAllowed);
         }
 
-        for (size_t i = 0; i < data->added.size(); ++i) {
-            Status status = _newInterface->insert(txn,
-                                                  *data->added[i],
-                                                  data->loc,
-                                                  data->dupsAllowed);
-            if ( !status.isOK() ) {
-                return status;
+        if (_newInterface->isClustering()) {
+            for (size_t i = 0; i < data->added.size(); ++i) {
+                Status status = _newInterface->insertWithDocument(txn,
+                                                                  *data->added[i],
+                                                                  data->loc,
+                                                                  data->newDoc,
+                                                                  data->dupsAllowed);
+                if ( !status.isOK() ) {
+                    return status;
+                }
+            }
+            // Every entry has a copy of the document, so the ones for keys that didn't change
+            // need the new version too.
+            for (BSONObjSet::const_iterator i = data->newKeys.begin();
+                 i != data->newKeys.end(); ++i) {
+                if (data->oldKeys.count(*i) == 0) {
+                    continue;
+                }
+                Status status = _newInterface->replaceDocument(txn,
+                                                               *i,
+                                                               data->loc,
+                                                               data->newDoc);
+                if ( !status.isOK() ) {
+                    return status;
+                }
+            }
+        }
+        else {
+            for (size_t i = 0; i < data->added.size(); ++i) {
+                Status status = _newInterface->insert(txn,
+                                                      *data->added[i],
+                                                      data->loc,
+                                                      data->dupsAllowed);
+                if ( !status.isOK() ) {
+                    return status;
+                }
             }
         }
 
@@ -298,6 +359,10 @@ namespace mongo {
     }
 
     IndexAccessMethod* BtreeBasedAccessMethod::initiateBulk(OperationContext* txn) {
+        if (_newInterface->isClustering()) {
+            // The bulk builder only gets keys, not documents.
+            return NULL;
+        }
         return new BtreeBasedBulkAccessMethod(txn,
                                               this,
                                               _newInterface.get(),
@@ -105,10 +105,21 @@ namespace mongo {
         virtual Status validate(OperationContext* txn, bool full, int64_t* numKeys,
                                 BSONObjBuilder* output);
 
+        virtual Status validateAndHash(OperationContext* txn, int64_t* numKeys, uint64_t* hashOut,
+                                       BSONObjBuilder* output);
+
         virtual bool appendCustomStats(OperationContext* txn, BSONObjBuilder* output, double scale)
             const;
         virtual long long getSpaceUsedBytes( OperationContext* txn ) const;
 
+        virtual bool isClustering() const;
+
+        virtual bool isPartitioned() const;
+
+        virtual Status addPartition(OperationContext* txn, long long id, const RecordId& lastMax);
+
+        virtual Status dropPartition(OperationContext* txn, long long id);
+
         // XXX: consider migrating callers to use IndexCursor instead
         virtual RecordId findSingle( OperationContext* txn, const BSONObj& key ) const;
 
@@ -148,6 +159,9 @@ namespace mongo {
 
         RecordId loc;
         bool dupsAllowed;
+
+        // The new version of the document, for clustering indexes.
+        BSONObj newDoc;
     };
 
 }  // namespace mongo
@@ -57,6 +57,14 @@ namespace mongo {
         _cursor->locate(position, (afterKey == forward) ? RecordId::max() : RecordId::min());
     }
 
+    void BtreeIndexCursor::setEndPosition(const BSONObj& key, bool inclusive) {
+        _cursor->setEndPosition(key, inclusive);
+    }
+
+    BSONObj BtreeIndexCursor::getDocument() const {
+        return _cursor->getDocument();
+    }
+
     bool BtreeIndexCursor::pointsAt(const BtreeIndexCursor& other) {
         return _cursor->pointsToSamePlaceAs(*other._cursor);
     }
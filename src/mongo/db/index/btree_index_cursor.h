@@ -68,6 +68,10 @@ namespace mongo {
         virtual RecordId getValue() const;
         virtual void next();
 
+        virtual void setEndPosition(const BSONObj& key, bool inclusive);
+
+        virtual BSONObj getDocument() const;
+
         /**
          * BtreeIndexCursor-only.
          * Returns true if 'this' points at the same exact key as 'other'.
@@ -157,6 +157,23 @@ namespace mongo {
         virtual Status validate(OperationContext* txn, bool full, int64_t* numKeys,
                                 BSONObjBuilder* output) = 0;
 
+        /**
+         * Like a full validate(), but also sums SortedDataInterface::hashEntry() over every
+         * entry in the index into 'hashOut', in the same pass where possible, for checking the
+         * index against its collection.
+         *
+         * Returns ErrorCodes::CommandNotSupported, having still validated, if the index can't
+         * hash its entries.
+         */
+        virtual Status validateAndHash(OperationContext* txn, int64_t* numKeys, uint64_t* hashOut,
+                                       BSONObjBuilder* output) {
+            Status s = validate(txn, true, numKeys, output);
+            if (!s.isOK()) {
+                return s;
+            }
+            return Status(ErrorCodes::CommandNotSupported, "index can't hash its entries");
+        }
+
         /**
          * Add custom statistics about this index to BSON object builder, for display.
          *
@@ -173,6 +190,26 @@ namespace mongo {
          */
         virtual long long getSpaceUsedBytes( OperationContext* txn ) const = 0;
 
+        /**
+         * Does this index actually keep a copy of each document with its keys?  This is what to
+         * go by, rather than IndexDescriptor::isClustering(), which is only what was asked for.
+         */
+        virtual bool isClustering() const { return false; }
+
+        //
+        // Partitioned collections, see SortedDataInterface::isPartitioned()
+        //
+
+        virtual bool isPartitioned() const { return false; }
+
+        virtual Status addPartition(OperationContext* txn, long long id, const RecordId& lastMax) {
+            return Status(ErrorCodes::CommandNotSupported, "index is not partitioned");
+        }
+
+        virtual Status dropPartition(OperationContext* txn, long long id) {
+            return Status(ErrorCodes::CommandNotSupported, "index is not partitioned");
+        }
+
         //
         // Bulk operations support
         //
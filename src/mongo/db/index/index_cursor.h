@@ -87,6 +87,16 @@ namespace mongo {
         // Current value we point at.  Assumes !isEOF().
         virtual RecordId getValue() const = 0;
 
+        /**
+         * Hint that the caller will stop at 'key' (after it if 'inclusive').  Must be called
+         * before seek().  The caller still has to check for the end itself.
+         */
+        virtual void setEndPosition(const BSONObj& key, bool inclusive) { }
+
+        // The document stored with the current entry, if this is a clustering index, otherwise
+        // an empty object.  Assumes !isEOF().
+        virtual BSONObj getDocument() const { return BSONObj(); }
+
         //
         // Yielding support
         //
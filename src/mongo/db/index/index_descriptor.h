@@ -68,6 +68,7 @@ namespace mongo {
               _isIdIndex(isIdIndexPattern( _keyPattern )),
               _sparse(infoObj["sparse"].trueValue()),
               _unique( _isIdIndex || infoObj["unique"].trueValue() ),
+              _clustering(infoObj["clustering"].trueValue()),
               _cachedEntry( NULL )
         {
             _indexNamespace = makeIndexNamespace( _parentNS, _indexName );
@@ -126,6 +127,10 @@ namespace mongo {
         // Is this index sparse?
         bool isSparse() const { return _sparse; }
 
+        // Does this index keep a copy of each document with its keys?  Only storage engines that
+        // support it actually store the documents, see IndexAccessMethod::isClustering().
+        bool isClustering() const { return _clustering; }
+
         // Is this index multikey?
         bool isMultikey( OperationContext* txn ) const {
             _checkOk();
@@ -200,6 +205,7 @@ namespace mongo {
         bool _isIdIndex;
         bool _sparse;
         bool _unique;
+        bool _clustering;
         int _version;
 
         // only used by IndexCatalogEntryContainer to do caching for perf
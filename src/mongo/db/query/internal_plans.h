@@ -130,6 +130,7 @@ namespace mongo {
             params.bounds.startKey = startKey;
             params.bounds.endKey = endKey;
             params.bounds.endKeyInclusive = endKeyInclusive;
+            params.fetchFromIndex = (IXSCAN_FETCH & options) != 0;
 
             WorkingSet* ws = new WorkingSet();
             IndexScan* ix = new IndexScan(txn, params, ws, NULL);
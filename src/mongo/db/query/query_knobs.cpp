@@ -68,4 +68,6 @@ namespace mongo {
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryExecYieldIterations, int, 128);
     MONGO_EXPORT_SERVER_PARAMETER(internalQueryExecYieldPeriodMS, int, 10);
 
+    MONGO_EXPORT_SERVER_PARAMETER(internalQueryExecFetchBatchSize, int, 64);
+
 }  // namespace mongo
@@ -104,4 +104,8 @@ namespace mongo {
     // Yield if it's been at least this many milliseconds since we last yielded.
     extern int internalQueryExecYieldPeriodMS;
 
+    // On storage engines with document-level locking, fetch up to this many documents from the
+    // record store at once.
+    extern int internalQueryExecFetchBatchSize;
+
 }  // namespace mongo
@@ -57,6 +57,34 @@ namespace mongo {
 
     using std::auto_ptr;
 
+    static PlanStage* buildIndexScan(OperationContext* txn,
+                                     Collection* collection,
+                                     const IndexScanNode* ixn,
+                                     WorkingSet* ws,
+                                     bool fetchFromIndex) {
+        if (NULL == collection) {
+            warning() << "Can't ixscan null namespace";
+            return NULL;
+        }
+
+        IndexScanParams params;
+
+        params.descriptor =
+            collection->getIndexCatalog()->findIndexByKeyPattern( txn, ixn->indexKeyPattern );
+        if ( params.descriptor == NULL ) {
+            warning() << "Can't find index " << ixn->indexKeyPattern.toString()
+                      << "in namespace " << collection->ns() << endl;
+            return NULL;
+        }
+
+        params.bounds = ixn->bounds;
+        params.direction = ixn->direction;
+        params.maxScan = ixn->maxScan;
+        params.addKeyMetadata = ixn->addKeyMetadata;
+        params.fetchFromIndex = fetchFromIndex;
+        return new IndexScan(txn, params, ws, ixn->filter.get());
+    }
+
     PlanStage* buildStages(OperationContext* txn,
                            Collection* collection,
                            const QuerySolution& qsol,
@@ -73,32 +101,18 @@ namespace mongo {
             return new CollectionScan(txn, params, ws, csn->filter.get());
         }
         else if (STAGE_IXSCAN == root->getType()) {
-            const IndexScanNode* ixn = static_cast<const IndexScanNode*>(root);
-
-            if (NULL == collection) {
-                warning() << "Can't ixscan null namespace";
-                return NULL;
-            }
-
-            IndexScanParams params;
-
-            params.descriptor =
-                collection->getIndexCatalog()->findIndexByKeyPattern( txn, ixn->indexKeyPattern );
-            if ( params.descriptor == NULL ) {
-                warning() << "Can't find index " << ixn->indexKeyPattern.toString()
-                          << "in namespace " << collection->ns() << endl;
-                return NULL;
-            }
-
-            params.bounds = ixn->bounds;
-            params.direction = ixn->direction;
-            params.maxScan = ixn->maxScan;
-            params.addKeyMetadata = ixn->addKeyMetadata;
-            return new IndexScan(txn, params, ws, ixn->filter.get());
+            return buildIndexScan(txn, collection, static_cast<const IndexScanNode*>(root), ws,
+                                  false);
         }
         else if (STAGE_FETCH == root->getType()) {
             const FetchNode* fn = static_cast<const FetchNode*>(root);
-            PlanStage* childStage = buildStages(txn, collection, qsol, fn->children[0], ws);
+            // A clustering index can hand the fetch its documents.  Other scans (covered ones
+            // in particular) don't get them.
+            PlanStage* childStage = (STAGE_IXSCAN == fn->children[0]->getType()
+                                     ? buildIndexScan(txn, collection,
+                                                      static_cast<const IndexScanNode*>(fn->children[0]),
+                                                      ws, true)
+                                     : buildStages(txn, collection, qsol, fn->children[0], ws));
             if (NULL == childStage) { return NULL; }
             return new FetchStage(txn, ws, childStage, fn->filter.get(), collection);
         }
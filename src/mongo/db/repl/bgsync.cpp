@@ -476,6 +476,11 @@ namespace {
         }
     }
 
+    OpTime BackgroundSync::getLastOpTimeFetched() const {
+        boost::lock_guard<boost::mutex> lck(_mutex);
+        return _lastOpTimeFetched;
+    }
+
     long long BackgroundSync::getLastAppliedHash() const {
         boost::lock_guard<boost::mutex> lck(_mutex);
         return _lastAppliedHash;
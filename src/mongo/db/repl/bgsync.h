@@ -104,6 +104,8 @@ namespace repl {
         // For monitoring
         BSONObj getCounters();
 
+        OpTime getLastOpTimeFetched() const;
+
         long long getLastAppliedHash() const;
         void setLastAppliedHash(long long oldH);
         void loadLastAppliedHash(OperationContext* txn);
@@ -379,58 +379,56 @@ namespace {
         }
     }
 
-    OpTime writeOpsToOplog(OperationContext* txn, const std::deque<BSONObj>& ops) {
-        ReplicationCoordinator* replCoord = getGlobalReplicationCoordinator();
-        OpTime lastOptime = replCoord->getMyLastOptime();
+    // Inserts the ops into the replica-set oplog, whose database the caller has locked, and
+    // returns the optime of the last one.
+    static OpTime insertOpsInlock(OperationContext* txn, const std::deque<BSONObj>& ops) {
+        OpTime lastOptime = getGlobalReplicationCoordinator()->getMyLastOptime();
         invariant(!ops.empty());
 
-        while (1) {
-            try {
-                ScopedTransaction transaction(txn, MODE_IX);
-                Lock::DBLock lk(txn->lockState(), "local", MODE_X);
-
-                if ( localOplogRSCollection == 0 ) {
-                    Client::Context ctx(txn, rsoplog);
+        if ( localOplogRSCollection == 0 ) {
+            Client::Context ctx(txn, rsoplog);
 
-                    localDB = ctx.db();
-                    verify( localDB );
-                    localOplogRSCollection = localDB->getCollection(rsoplog);
-                    massert(13389,
-                            "local.oplog.rs missing. did you drop it? if so restart server",
-                            localOplogRSCollection);
-                }
+            localDB = ctx.db();
+            verify( localDB );
+            localOplogRSCollection = localDB->getCollection(rsoplog);
+            massert(13389,
+                    "local.oplog.rs missing. did you drop it? if so restart server",
+                    localOplogRSCollection);
+        }
 
-                Client::Context ctx(txn, rsoplog, localDB);
-                WriteUnitOfWork wunit(txn);
+        Client::Context ctx(txn, rsoplog, localDB);
 
-                for (std::deque<BSONObj>::const_iterator it = ops.begin();
-                     it != ops.end();
-                     ++it) {
-                    const BSONObj& op = *it;
-                    const OpTime ts = op["ts"]._opTime();
+        for (std::deque<BSONObj>::const_iterator it = ops.begin();
+             it != ops.end();
+             ++it) {
+            const BSONObj& op = *it;
+            const OpTime ts = op["ts"]._opTime();
 
-                    checkOplogInsert(localOplogRSCollection->insertDocument(txn, op, false));
+            checkOplogInsert(localOplogRSCollection->insertDocument(txn, op, false));
 
-                    if (!(lastOptime < ts)) {
-                        severe() << "replication oplog stream went back in time. "
-                            "previous timestamp: " << lastOptime << " newest timestamp: " << ts
-                                 << ". Op being applied: " << op;
-                        fassertFailedNoTrace(18905);
-                    }
-                    lastOptime = ts;
-                }
-                wunit.commit();
+            if (!(lastOptime < ts)) {
+                severe() << "replication oplog stream went back in time. "
+                    "previous timestamp: " << lastOptime << " newest timestamp: " << ts
+                         << ". Op being applied: " << op;
+                fassertFailedNoTrace(18905);
+            }
+            lastOptime = ts;
+        }
 
-                BackgroundSync* bgsync = BackgroundSync::get();
-                // Keep this up-to-date, in case we step up to primary.
-                long long hash = ops.back()["h"].numberLong();
-                bgsync->setLastAppliedHash(hash);
+        return lastOptime;
+    }
 
-                txn->getClient()->setLastOp(lastOptime);
+    OpTime writeOpsToOplog(OperationContext* txn, const std::deque<BSONObj>& ops) {
+        while (1) {
+            try {
+                ScopedTransaction transaction(txn, MODE_IX);
+                Lock::DBLock lk(txn->lockState(), "local", MODE_X);
 
-                replCoord->setMyLastOptime(lastOptime);
-                setNewOptime(lastOptime);
+                WriteUnitOfWork wunit(txn);
+                const OpTime lastOptime = insertOpsInlock(txn, ops);
+                wunit.commit();
 
+                finishWritingOpsToOplog(txn, ops, lastOptime);
                 return lastOptime;
             }
             catch (const WriteConflictException& wce) {
@@ -439,6 +437,31 @@ namespace {
         }
     }
 
+    OpTime insertOpsIntoOplog(OperationContext* txn, const std::deque<BSONObj>& ops) {
+        invariant(txn->lockState()->inAWriteUnitOfWork());
+
+        ScopedTransaction transaction(txn, MODE_IX);
+        Lock::DBLock lk(txn->lockState(), "local", MODE_IX);
+        Lock::OplogIntentWriteLock oplogLk(txn->lockState());
+        oplogLk.serializeIfNeeded();
+
+        return insertOpsInlock(txn, ops);
+    }
+
+    void finishWritingOpsToOplog(OperationContext* txn,
+                                 const std::deque<BSONObj>& ops,
+                                 const OpTime& lastOptime) {
+        BackgroundSync* bgsync = BackgroundSync::get();
+        // Keep this up-to-date, in case we step up to primary.
+        long long hash = ops.back()["h"].numberLong();
+        bgsync->setLastAppliedHash(hash);
+
+        txn->getClient()->setLastOp(lastOptime);
+
+        getGlobalReplicationCoordinator()->setMyLastOptime(lastOptime);
+        setNewOptime(lastOptime);
+    }
+
     void createOplog(OperationContext* txn) {
         ScopedTransaction transaction(txn, MODE_X);
         Lock::GlobalWrite lk(txn->lockState());
@@ -54,6 +54,17 @@ namespace repl {
     // Returns the optime for the last op inserted.
     OpTime writeOpsToOplog(OperationContext* txn, const std::deque<BSONObj>& ops);
 
+    // Like writeOpsToOplog, but inserts the ops in the caller's WriteUnitOfWork, which may be
+    // committed together with the ops' own writes, and only takes intent locks.  Once the unit
+    // of work has committed, the caller must call finishWritingOpsToOplog.
+    OpTime insertOpsIntoOplog(OperationContext* txn, const std::deque<BSONObj>& ops);
+
+    // Updates the global optime (and the other state writeOpsToOplog updates) after ops
+    // inserted with insertOpsIntoOplog have been committed.
+    void finishWritingOpsToOplog(OperationContext* txn,
+                                 const std::deque<BSONObj>& ops,
+                                 const OpTime& lastOptime);
+
     const char rsoplog[] = "local.oplog.rs";
     static const int OPLOG_VERSION = 2;
 
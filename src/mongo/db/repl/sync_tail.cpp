@@ -34,7 +34,6 @@
 #include "mongo/db/repl/sync_tail.h"
 
 #include <boost/functional/hash.hpp>
-#include <boost/ref.hpp>
 #include "third_party/murmurhash3/MurmurHash3.h"
 
 #include "mongo/base/counter.h"
@@ -51,11 +50,13 @@
 #include "mongo/db/repl/minvalid.h"
 #include "mongo/db/repl/oplog.h"
 #include "mongo/db/repl/replication_coordinator_global.h"
+#include "mongo/db/server_parameters.h"
 #include "mongo/db/stats/timer_stats.h"
 #include "mongo/db/operation_context_impl.h"
 #include "mongo/util/exit.h"
 #include "mongo/util/fail_point_service.h"
 #include "mongo/util/log.h"
+#include "mongo/util/processinfo.h"
 
 namespace mongo {
 
@@ -63,15 +64,34 @@ namespace mongo {
 
 namespace repl {
 #if defined(MONGO_PLATFORM_64)
-    const int replWriterThreadCount = 16;
     const int replPrefetcherThreadCount = 16;
 #elif defined(MONGO_PLATFORM_32)
-    const int replWriterThreadCount = 2;
     const int replPrefetcherThreadCount = 2;
 #else
 #error need to include something that defines MONGO_PLATFORM_XX
 #endif
 
+    // The number of writer threads applying each batch.  0 sizes the pool to the machine.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(replWriterThreadCount, int, 0);
+
+    const int kMaxWriterThreads = 256;
+    // Each batch is split into this many buckets per writer, so that writers which finish
+    // early have buckets left to take.
+    const int kBucketsPerWriter = 8;
+
+    static int getWriterThreadCount() {
+        if (replWriterThreadCount > 0) {
+            return std::min(static_cast<int>(replWriterThreadCount), kMaxWriterThreads);
+        }
+#if defined(MONGO_PLATFORM_64)
+        // Writers mostly wait on the storage engine, so use more of them than cores.
+        const int numCores = ProcessInfo().getNumCores();
+        return std::max(4, std::min(2 * numCores, 64));
+#else
+        return 2;
+#endif
+    }
+
     static Counter64 opsAppliedStats;
 
     //The oplog entries applied
@@ -85,6 +105,107 @@ namespace repl {
     static ServerStatusMetricField<TimerStats> displayOpBatchesApplied(
                                                     "repl.apply.batches",
                                                     &applyBatchStats );
+
+    // Time spent splitting batches among the writers, including while the previous batch was
+    // being applied
+    static TimerStats prepareBatchStats;
+    static ServerStatusMetricField<TimerStats> displayPrepareBatch(
+                                                    "repl.apply.stages.prepare",
+                                                    &prepareBatchStats );
+    // Time spent writing batches to the oplog, including while their writers were running
+    static TimerStats oplogWriteStats;
+    static ServerStatusMetricField<TimerStats> displayOplogWrite(
+                                                    "repl.apply.stages.oplogWrite",
+                                                    &oplogWriteStats );
+    // Ops taken for the next batch while the previous one was being applied
+    static Counter64 pipelinedOpsStats;
+    static ServerStatusMetricField<Counter64> displayPipelinedOps(
+                                                    "repl.apply.stages.pipelinedOps",
+                                                    &pipelinedOpsStats );
+
+    // How far, in seconds, the last applied op was behind the last one fetched
+    static AtomicInt64 applyLagSecs;
+    class ApplyLagSecsMetric : public ServerStatusMetric {
+    public:
+        ApplyLagSecsMetric() : ServerStatusMetric("repl.apply.lagSecs") {}
+
+        virtual void appendAtLeaf(BSONObjBuilder& b) const {
+            b.appendNumber(_leafName, static_cast<long long>(applyLagSecs.load()));
+        }
+    } applyLagSecsMetric;
+
+    // The most ops, and roughly the most bytes of ops, a writer applies in one unit of work
+    // when readers are blocked for the batch anyway.  A limit of 1 op turns grouping off.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(replApplyGroupMaxOps, int, 128);
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(replApplyGroupMaxBytes, int, 1024 * 1024);
+
+    // Units of work that applied a group of ops
+    static Counter64 applyGroupStats;
+    static ServerStatusMetricField<Counter64> displayApplyGroups(
+                                                    "repl.apply.groups.count",
+                                                    &applyGroupStats );
+    // Groups rolled back to be applied one op at a time
+    static Counter64 applyGroupFallbackStats;
+    static ServerStatusMetricField<Counter64> displayApplyGroupFallbacks(
+                                                    "repl.apply.groups.fallbacks",
+                                                    &applyGroupFallbackStats );
+
+    // What each writer thread applied, to see how evenly batches are spread among them.  The
+    // busy time is comparable to the total time in repl.apply.batches.
+    struct WriterStats {
+        Counter64 ops;
+        Counter64 buckets;
+        Counter64 busyMicros;
+    };
+    static WriterStats writerStats[kMaxWriterThreads];
+    static AtomicUInt32 numWriterStats;
+
+    class WriterStatsMetric : public ServerStatusMetric {
+    public:
+        WriterStatsMetric() : ServerStatusMetric("repl.apply.writers") {}
+
+        virtual void appendAtLeaf(BSONObjBuilder& b) const {
+            BSONArrayBuilder writers(b.subarrayStart(_leafName));
+            for (unsigned i = 0; i < numWriterStats.load(); i++) {
+                BSONObjBuilder writer(writers.subobjStart());
+                writer.appendNumber("ops", writerStats[i].ops.get());
+                writer.appendNumber("buckets", writerStats[i].buckets.get());
+                writer.appendNumber("busyMicros", writerStats[i].busyMicros.get());
+            }
+        }
+    } writerStatsMetric;
+
+    // Adds the time since it was created to the busy time of a writer.
+    class WriterBusyTimer {
+        MONGO_DISALLOW_COPYING(WriterBusyTimer);
+    public:
+        explicit WriterBusyTimer(size_t writerId) : _writerId(writerId) {}
+        ~WriterBusyTimer() {
+            writerStats[_writerId].busyMicros.increment(_timer.micros());
+        }
+    private:
+        const size_t _writerId;
+        Timer _timer;
+    };
+
+    // On engines that support it, apply CRUD batches without blocking readers for the whole
+    // batch, only while the writers commit.  See SyncTail::applyOpsDeferred.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(replAllowReadsDuringBatch, bool, false);
+
+    // How long the applier waits for the writers of a deferred batch before rolling them back,
+    // see SyncTail::applyOpsDeferred.
+    MONGO_EXPORT_STARTUP_SERVER_PARAMETER(replDeferredCommitTimeoutMillis, int, 1000);
+
+    // Batches applied without blocking readers, and the time readers were blocked for them
+    static TimerStats deferredCommitStats;
+    static ServerStatusMetricField<TimerStats> displayDeferredCommits(
+                                                    "repl.apply.deferredCommits",
+                                                    &deferredCommitStats );
+    // Batches that had to be applied again with readers blocked
+    static Counter64 deferredCommitFallbackStats;
+    static ServerStatusMetricField<Counter64> displayDeferredCommitFallbacks(
+                                                    "repl.apply.deferredCommitFallbacks",
+                                                    &deferredCommitFallbackStats );
     void initializePrefetchThread() {
         if (!ClientBasic::getCurrent()) {
             Client::initThreadIfNotAlready();
@@ -101,15 +222,32 @@ namespace repl {
             }
             return false;
         }
+
+        /**
+         * Whether the op can be applied in a unit of work shared with other ops, which keeps its
+         * locks until it commits.  Only CRUD ops on existing collections only need intent locks
+         * (see SyncTail::syncApply).  Commands, index builds, and writes to system collections or
+         * the admin database (whose writes lock it exclusively) are applied on their own.
+         */
+        bool canApplyInGroup( const BSONObj& op ) {
+            const char* ns = op.getStringField("ns");
+            return isCrudOpType(op.getField("op").valuestrsafe()) &&
+                *ns != '\0' &&
+                nsToDatabaseSubstring(ns) != "admin" &&
+                !nsToCollectionSubstring(ns).startsWith("system.");
+        }
     }
 
     SyncTail::SyncTail(BackgroundSyncInterface *q, MultiSyncApplyFunc func) :
         Sync(""), 
         _networkQueue(q), 
         _applyFunc(func),
-        _writerPool(replWriterThreadCount, "repl writer worker "),
-        _prefetcherPool(replPrefetcherThreadCount, "repl prefetch worker ")
-    {}
+        _numWriters(getWriterThreadCount()),
+        _writerPool(_numWriters, "repl writer worker "),
+        _prefetcherPool(replPrefetcherThreadCount, "repl prefetch worker "),
+        _deferredCommit(NULL) {
+        numWriterStats.store(_numWriters);
+    }
 
     SyncTail::~SyncTail() {}
 
@@ -168,6 +306,12 @@ namespace repl {
                                                   nsToDatabaseSubstring(ns), MODE_X));
                 }
                 else if (isCrudOpType(opType)) {
+                    if (createCollection && txn->lockState()->inAWriteUnitOfWork()) {
+                        // The exclusive locks would be held until the enclosing unit of work
+                        // commits, so let the caller apply this op without one.
+                        throw WriteConflictException();
+                    }
+
                     LockMode mode = createCollection ? MODE_X : MODE_IX;
                     dbLock.reset(new Lock::DBLock(txn->lockState(),
                                                   nsToDatabaseSubstring(ns), mode));
@@ -198,10 +342,17 @@ namespace repl {
                 // For non-initial-sync, we convert updates to upserts
                 // to suppress errors when replaying oplog entries.
                 bool ok = !applyOperation_inlock(txn, ctx.db(), op, true, convertUpdateToUpsert);
-                opsAppliedStats.increment();
+                // Ops applied in a caller's unit of work are counted once it commits.
+                if (!txn->lockState()->inAWriteUnitOfWork()) {
+                    opsAppliedStats.increment();
+                }
                 return ok;
             }
             catch (const WriteConflictException&) {
+                if (txn->lockState()->inAWriteUnitOfWork()) {
+                    // Only the enclosing unit of work can be retried.
+                    throw;
+                }
                 log() << "WriteConflictException while doing oplog application on: " << ns
                       << ", retrying.";
                 createCollection--;
@@ -249,38 +400,306 @@ namespace repl {
         _prefetcherPool.join();
     }
     
-    // Doles out all the work to the writer pool threads and waits for them to complete
-    void SyncTail::applyOps(const std::vector< std::vector<BSONObj> >& writerVectors) {
+    // The applier holds intent locks on the oplog until the writers are done, so none of them
+    // may need the global lock exclusively, as commands do.  Readers are blocked by the batch
+    // writer lock, so nothing else queues for the locks meanwhile, except on MMAPv1, where
+    // journal commits need the flush lock the applier would be holding.
+    bool SyncTail::canWriteOplogDuringApply(const std::deque<BSONObj>& ops) const {
+        if (!getGlobalEnvironment()->getGlobalStorageEngine()->supportsDocLocking()) {
+            return false;
+        }
+        for (std::deque<BSONObj>::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+            if (it->getField("op").valuestrsafe()[0] == 'c') {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Doles out all the work to the writer pool threads and waits for them to complete.  The
+    // oplog unit of work is committed after the writers are done, so that recovery never finds
+    // ops in the oplog without their writes.
+    bool SyncTail::applyOps(OperationContext* txn,
+                            OpQueue* ops,
+                            OpQueue* next,
+                            OpTime* lastOpTime) {
         TimerHolder timer(&applyBatchStats);
-        for (std::vector< std::vector<BSONObj> >::const_iterator it = writerVectors.begin();
-             it != writerVectors.end();
+        WriterQueue queue(ops->getWriterVectors());
+        scheduleWriters(&queue);
+
+        try {
+            boost::scoped_ptr<WriteUnitOfWork> oplogUnit;
+            if (canWriteOplogDuringApply(ops->getDeque())) {
+                oplogUnit.reset(new WriteUnitOfWork(txn));
+                try {
+                    TimerHolder oplogTimer(&oplogWriteStats);
+                    *lastOpTime = insertOpsIntoOplog(txn, ops->getDeque());
+                }
+                catch (const WriteConflictException&) {
+                    // Written once the writers are done instead.
+                    oplogUnit.reset();
+                }
+            }
+
+            if (next != NULL) {
+                prepareNextBatch(next);
+            }
+
+            _writerPool.join();
+            if (oplogUnit && !inShutdown()) {
+                oplogUnit->commit();
+                return true;
+            }
+            return false;
+        }
+        catch (...) {
+            _writerPool.join();
+            throw;
+        }
+    }
+
+    size_t SyncTail::scheduleWriters(WriterQueue* queue) {
+        const size_t numWriters = std::min(queue->size(), static_cast<size_t>(_numWriters));
+        for (size_t i = 0; i < numWriters; i++) {
+            _writerPool.schedule(_applyFunc, queue, i, this);
+        }
+        return numWriters;
+    }
+
+    namespace {
+        bool largerBucket(const std::vector<BSONObj>* a, const std::vector<BSONObj>* b) {
+            return a->size() > b->size();
+        }
+    }
+
+    SyncTail::WriterQueue::WriterQueue(const std::vector< std::vector<BSONObj> >& buckets) {
+        for (std::vector< std::vector<BSONObj> >::const_iterator it = buckets.begin();
+             it != buckets.end();
              ++it) {
             if (!it->empty()) {
-                _writerPool.schedule(_applyFunc, boost::cref(*it), this);
+                _buckets.push_back(&*it);
+            }
+        }
+        // Handing out the largest buckets first keeps the last ones to finish small.
+        std::stable_sort(_buckets.begin(), _buckets.end(), largerBucket);
+    }
+
+    const std::vector<BSONObj>* SyncTail::WriterQueue::next(size_t writerId) {
+        const size_t i = _next.fetchAndAdd(1);
+        if (i >= _buckets.size()) {
+            return NULL;
+        }
+        writerStats[writerId].ops.increment(_buckets[i]->size());
+        writerStats[writerId].buckets.increment();
+        return _buckets[i];
+    }
+
+    SyncTail::DeferredCommit::DeferredCommit(size_t numWriters)
+        : _pending(numWriters), _allOk(true), _released(false), _commit(false) {
+    }
+
+    bool SyncTail::DeferredCommit::writerDone(bool ok) {
+        boost::unique_lock<boost::mutex> lk(_mutex);
+        invariant(_pending > 0);
+        _allOk = _allOk && ok;
+        if (--_pending == 0) {
+            _cond.notify_all();
+        }
+        while (!_released) {
+            _cond.wait(lk);
+        }
+        return _commit;
+    }
+
+    bool SyncTail::DeferredCommit::waitForWriters(int timeoutMillis) {
+        const boost::system_time deadline =
+            boost::get_system_time() + boost::posix_time::milliseconds(timeoutMillis);
+        boost::unique_lock<boost::mutex> lk(_mutex);
+        while (_pending > 0) {
+            if (!_cond.timed_wait(lk, deadline) && _pending > 0) {
+                return false;
             }
         }
-        _writerPool.join();
+        return _allOk;
+    }
+
+    void SyncTail::DeferredCommit::release(bool commit) {
+        boost::unique_lock<boost::mutex> lk(_mutex);
+        _released = true;
+        _commit = commit;
+        _cond.notify_all();
+    }
+
+    bool SyncTail::DeferredCommit::aborted() {
+        boost::unique_lock<boost::mutex> lk(_mutex);
+        return _released && !_commit;
+    }
+
+    bool SyncTail::canDeferCommit(const std::deque<BSONObj>& ops) const {
+        if (!replAllowReadsDuringBatch ||
+            _applyFunc != multiSyncApply ||
+            !getGlobalEnvironment()->getGlobalStorageEngine()->supportsDocLocking() ||
+            !getGlobalEnvironment()->getGlobalStorageEngine()->supportsBatchSnapshotReads()) {
+            return false;
+        }
+
+        // The writers keep their locks until the batch commits, so they must all be
+        // intent locks.
+        for (std::deque<BSONObj>::const_iterator it = ops.begin(); it != ops.end(); ++it) {
+            if (!canApplyInGroup(*it)) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Each writer applies its ops in a single unit of work and waits until all of them are
+    // done.  Readers only start new snapshots while holding the snapshot gate shared, so
+    // holding it exclusively just while the writers commit keeps them from seeing part of the
+    // batch, without blocking them while it is applied.  Unlike the batch writer lock, nobody
+    // waits for other locks while holding the gate.
+    //
+    // The writers that are done still hold their intent locks while they wait, though, and
+    // lock requests are granted in order, so a shared or exclusive request queued behind them
+    // (listCollections, dbhash, fsyncLock, an index build relocking...) blocks the writers that
+    // haven't taken theirs yet.  So the wait is bounded: past replDeferredCommitTimeoutMillis,
+    // every writer rolls back, releasing its locks, and the batch is applied again with
+    // readers blocked.
+    //
+    // Meanwhile, this thread inserts the batch into the oplog, in a unit of work committed
+    // after the writers' (so that recovery never finds ops in the oplog without their writes),
+    // and then gets the next batch ready.
+    bool SyncTail::applyOpsDeferred(OperationContext* txn,
+                                    OpQueue* ops,
+                                    OpQueue* next,
+                                    OpTime* lastOpTime) {
+        Timer timer;
+
+        if (!Lock::SnapshotGate::isActive()) {
+            Lock::SnapshotGate::setActive(true);
+            // Readers that started their snapshots without the gate did so holding the global
+            // lock, so once nobody holds it, every new snapshot goes through the gate.
+            Lock::ParallelBatchWriterMode pbwm;
+        }
+
+        WriterQueue queue(ops->getWriterVectors());
+        DeferredCommit deferredCommit(std::min(queue.size(), static_cast<size_t>(_numWriters)));
+        _deferredCommit = &deferredCommit;
+        scheduleWriters(&queue);
+
+        bool ok = true;
+        try {
+            WriteUnitOfWork oplogUnit(txn);
+            try {
+                TimerHolder oplogTimer(&oplogWriteStats);
+                *lastOpTime = insertOpsIntoOplog(txn, ops->getDeque());
+            }
+            catch (const WriteConflictException&) {
+                ok = false;
+            }
+
+            if (next != NULL) {
+                prepareNextBatch(next);
+            }
+
+            ok = deferredCommit.waitForWriters(replDeferredCommitTimeoutMillis) && ok &&
+                !inShutdown();
+            if (ok) {
+                TimerHolder commitTimer(&deferredCommitStats);
+                Lock::SnapshotGate gate(true);
+                deferredCommit.release(true);
+                _writerPool.join();
+                oplogUnit.commit();
+            }
+        }
+        catch (...) {
+            deferredCommit.release(false);
+            _writerPool.join();
+            _deferredCommit = NULL;
+            throw;
+        }
+
+        if (ok) {
+            finishWritingOpsToOplog(txn, ops->getDeque(), *lastOpTime);
+            applyBatchStats.recordMillis(timer.millis());
+        }
+        else {
+            deferredCommit.release(false);
+            _writerPool.join();
+            if (!inShutdown()) {
+                deferredCommitFallbackStats.increment();
+            }
+        }
+        _deferredCommit = NULL;
+
+        return ok;
+    }
+
+    // Returns whether the op has to be applied in a batch of its own.
+    static bool mustApplyAlone(const BSONObj& op) {
+        const char* ns = op["ns"].valuestrsafe();
+        return (op["op"].valuestrsafe()[0] == 'c') ||
+            // Index builds are acheived through the use of an insert op, not a command op.
+            // The following line is the same as what the insert code uses to detect an index build.
+            ( *ns != '\0' && nsToCollectionSubstring(ns) == "system.indexes" );
+    }
+
+    static void checkOplogVersion(const BSONObj& op) {
+        BSONElement elemVersion = op["v"];
+        int curVersion = 0;
+        if (elemVersion.eoo())
+            // missing version means version 1
+            curVersion = 1;
+        else
+            curVersion = elemVersion.Int();
+        
+        if (curVersion != OPLOG_VERSION) {
+            severe() << "expected oplog version " << OPLOG_VERSION << " but found version " 
+                     << curVersion << " in oplog entry: " << op;
+            fassertFailedNoTrace(18820);
+        }
+    }
+
+    // Takes the ops already waiting in the bgsync queue, up to the batch limits and stopping
+    // before a command, and splits them among the writers.  Unlike tryPopAndWaitForMore it
+    // never waits, and leaves draining and the other checks made between batches to
+    // oplogApplication, which finishes assembling the batch.
+    void SyncTail::prepareNextBatch(OpQueue* next) {
+        TimerHolder timer(&prepareBatchStats);
+        const size_t numOps = next->getDeque().size();
+
+        BSONObj op;
+        while (next->getDeque().size() <= replBatchLimitOperations &&
+               next->getSize() < replBatchLimitBytes &&
+               peek(&op) &&
+               !mustApplyAlone(op)) {
+            checkOplogVersion(op);
+            next->push_back(op);
+            _networkQueue->consume();
+        }
+
+        pipelinedOpsStats.increment(next->getDeque().size() - numOps);
+        fillWriterVectors(next);
     }
 
     // Doles out all the work to the writer pool threads and waits for them to complete
-    OpTime SyncTail::multiApply(OperationContext* txn, std::deque<BSONObj>& ops) {
+    OpTime SyncTail::multiApply(OperationContext* txn, OpQueue* ops, OpQueue* next) {
 
         if (getGlobalEnvironment()->getGlobalStorageEngine()->isMmapV1()) {
             // Use a ThreadPool to prefetch all the operations in a batch.
-            prefetchOps(ops);
+            prefetchOps(ops->getDeque());
         }
         
-        std::vector< std::vector<BSONObj> > writerVectors(replWriterThreadCount);
-        fillWriterVectors(ops, &writerVectors);
-        LOG(2) << "replication batch size is " << ops.size() << endl;
+        {
+            TimerHolder timer(&prepareBatchStats);
+            fillWriterVectors(ops);
+        }
+        LOG(2) << "replication batch size is " << ops->getDeque().size() << endl;
         // We must grab this because we're going to grab write locks later.
         // We hold this mutex the entire time we're writing; it doesn't matter
         // because all readers are blocked anyway.
         SimpleMutex::scoped_lock fsynclk(filesLockedFsync);
 
-        // stop all readers until we're done
-        Lock::ParallelBatchWriterMode pbwm;
-
         ReplicationCoordinator* replCoord = getGlobalReplicationCoordinator();
         if (replCoord->getMemberState().primary() &&
             !replCoord->isWaitingForApplierToDrain()) {
@@ -289,24 +708,50 @@ namespace repl {
             fassertFailed(28527);
         }
 
-        applyOps(writerVectors);
+        OpTime lastOpTime;
+        if (!canDeferCommit(ops->getDeque()) || !applyOpsDeferred(txn, ops, next, &lastOpTime)) {
+            bool oplogWritten;
+            {
+                // stop all readers until we're done
+                Lock::ParallelBatchWriterMode pbwm;
 
-        if (inShutdown()) {
-            return OpTime();
+                oplogWritten = applyOps(txn, ops, next, &lastOpTime);
+            }
+
+            if (inShutdown()) {
+                return OpTime();
+            }
+
+            if (oplogWritten) {
+                finishWritingOpsToOplog(txn, ops->getDeque(), lastOpTime);
+            }
+            else {
+                TimerHolder timer(&oplogWriteStats);
+                lastOpTime = writeOpsToOplog(txn, ops->getDeque());
+            }
         }
 
-        OpTime lastOpTime = writeOpsToOplog(txn, ops);
+        // Ops taken for the next batch haven't been applied yet.
+        if (next == NULL || next->empty()) {
+            BackgroundSync::get()->notify(txn);
+        }
 
-        BackgroundSync::get()->notify(txn);
+        const OpTime lastFetched = BackgroundSync::get()->getLastOpTimeFetched();
+        applyLagSecs.store(lastFetched > lastOpTime ?
+                           lastFetched.getSecs() - lastOpTime.getSecs() : 0);
 
         return lastOpTime;
     }
 
-    void SyncTail::fillWriterVectors(const std::deque<BSONObj>& ops,
-                                     std::vector< std::vector<BSONObj> >* writerVectors) {
+    void SyncTail::fillWriterVectors(OpQueue* ops) {
+        std::vector< std::vector<BSONObj> >* writerVectors = &ops->getWriterVectors();
+        if (writerVectors->empty()) {
+            writerVectors->resize(_numWriters * kBucketsPerWriter);
+        }
 
-        for (std::deque<BSONObj>::const_iterator it = ops.begin();
-             it != ops.end();
+        const std::deque<BSONObj>& deque = ops->getDeque();
+        for (std::deque<BSONObj>::const_iterator it = deque.begin() + ops->getNumDistributed();
+             it != deque.end();
              ++it) {
             const BSONElement e = it->getField("ns");
             verify(e.type() == String);
@@ -336,6 +781,7 @@ namespace repl {
 
             (*writerVectors)[hash % writerVectors->size()].push_back(*it);
         }
+        ops->setNumDistributed(deque.size());
     }
     void SyncTail::oplogApplication(OperationContext* txn, const OpTime& endOpTime) {
         _applyOplogUntil(txn, endOpTime);
@@ -384,7 +830,7 @@ namespace repl {
             bytesApplied += ops.getSize();
             entriesApplied += ops.getDeque().size();
 
-            const OpTime lastOpTime = multiApply(txn, ops.getDeque());
+            const OpTime lastOpTime = multiApply(txn, &ops);
 
             if (inShutdown()) {
                 return;
@@ -437,26 +883,23 @@ namespace {
     void SyncTail::oplogApplication() {
         ReplicationCoordinator* replCoord = getGlobalReplicationCoordinator();
 
+        // The start of the next batch, taken while the previous one was being applied.
+        OpQueue next;
+
         while(!inShutdown()) {
             OpQueue ops;
+            ops.swap(next);
             OperationContextImpl txn;
 
             Timer batchTimer;
-            int lastTimeChecked = 0;
+            int lastTimeChecked = -1;
 
             do {
                 int now = batchTimer.seconds();
 
-                // apply replication batch limits
-                if (!ops.empty()) {
-                    if (now > replBatchLimitSeconds)
-                        break;
-                    if (ops.getDeque().size() > replBatchLimitOperations)
-                        break;
-                }
                 // occasionally check some things
-                // (always checked in the first iteration of this do-while loop, because
-                // ops is empty)
+                // (always checked in the first iteration of this do-while loop, even if the
+                // batch was already started while applying the previous one)
                 if (ops.empty() || now > lastTimeChecked) {
                     BackgroundSync* bgsync = BackgroundSync::get();
                     if (bgsync->getInitialSyncRequestedFlag()) {
@@ -470,6 +913,14 @@ namespace {
                     tryToGoLiveAsASecondary(&txn, replCoord);
                 }
 
+                // apply replication batch limits
+                if (!ops.empty()) {
+                    if (now > replBatchLimitSeconds)
+                        break;
+                    if (ops.getDeque().size() > replBatchLimitOperations)
+                        break;
+                }
+
                 const int slaveDelaySecs = replCoord->getSlaveDelaySecs().total_seconds();
                 if (!ops.empty() && slaveDelaySecs > 0) {
                     const BSONObj& lastOp = ops.getDeque().back();
@@ -507,7 +958,22 @@ namespace {
             // if we should crash and restart before updating the oplog
             OpTime minValid = lastOp["ts"]._opTime();
             setMinValid(&txn, minValid);
-            multiApply(&txn, ops.getDeque());
+
+            // With a slaveDelay, ops have to wait their turn, so don't take any early.
+            const bool slaveDelayed = replCoord->getSlaveDelaySecs().total_seconds() > 0;
+            try {
+                multiApply(&txn, &ops, slaveDelayed ? NULL : &next);
+            }
+            catch (...) {
+                // The ops taken for the next batch are gone from the bgsync queue, so the
+                // SyncTail started after this one unwinds would skip them.
+                if (!next.empty()) {
+                    severe() << "exception while applying a batch, with "
+                             << next.getDeque().size() << " ops taken for the next batch";
+                    fassertFailedNoTrace(28700);
+                }
+                throw;
+            }
         }
     }
 
@@ -536,6 +1002,8 @@ namespace {
                         // is complete.
                         return false;
                     }
+                    // No more batches will be committed under the gate, readers can skip it.
+                    Lock::SnapshotGate::setActive(false);
                     replCoord->signalDrainComplete(txn);
                 }
                 // block up to 1 second
@@ -547,13 +1015,8 @@ namespace {
             return true;
         }
 
-        const char* ns = op["ns"].valuestrsafe();
-
         // check for commands
-        if ((op["op"].valuestrsafe()[0] == 'c') ||
-            // Index builds are acheived through the use of an insert op, not a command op.
-            // The following line is the same as what the insert code uses to detect an index build.
-            ( *ns != '\0' && nsToCollectionSubstring(ns) == "system.indexes" )) {
+        if (mustApplyAlone(op)) {
 
             if (ops->empty()) {
                 // apply commands one-at-a-time
@@ -566,20 +1029,8 @@ namespace {
         }
 
         // check for oplog version change
-        BSONElement elemVersion = op["v"];
-        int curVersion = 0;
-        if (elemVersion.eoo())
-            // missing version means version 1
-            curVersion = 1;
-        else
-            curVersion = elemVersion.Int();
-        
-        if (curVersion != OPLOG_VERSION) {
-            severe() << "expected oplog version " << OPLOG_VERSION << " but found version " 
-                     << curVersion << " in oplog entry: " << op;
-            fassertFailedNoTrace(18820);
-        }
-    
+        checkOplogVersion(op);
+
         // Copy the op to the deque and remove it from the bgsync queue.
         ops->push_back(op);
         _networkQueue->consume();
@@ -633,40 +1084,147 @@ namespace {
         }
     }
 
-    // This free function is used by the writer threads to apply each op
-    void multiSyncApply(const std::vector<BSONObj>& ops, SyncTail* st) {
-        initializeWriterThread();
+    // Applies the ops in the caller's unit of work.  Returns false, leaving it to be rolled
+    // back, if one of them couldn't be applied in it, or on shutdown.
+    static bool syncApplyInUnitOfWork(OperationContext* txn,
+                                      std::vector<BSONObj>::const_iterator begin,
+                                      std::vector<BSONObj>::const_iterator end,
+                                      SyncTail* st) {
+        invariant(txn->lockState()->inAWriteUnitOfWork());
 
-        OperationContextImpl txn;
-
-        // allow us to get through the magic barrier
-        txn.lockState()->setIsBatchWriter(true);
-
-        bool convertUpdatesToUpserts = true;
-
-        for (std::vector<BSONObj>::const_iterator it = ops.begin();
-             it != ops.end();
-             ++it) {
+        for (std::vector<BSONObj>::const_iterator it = begin; it != end; ++it) {
             try {
-                if (!st->syncApply(&txn, *it, convertUpdatesToUpserts)) {
+                if (!st->syncApply(txn, *it, true)) {
                     fassertFailedNoTrace(16359);
                 }
             }
+            catch (const WriteConflictException&) {
+                return false;
+            }
             catch (const DBException& e) {
                 error() << "writer worker caught exception: " << causedBy(e)
                         << " on: " << it->toString();
 
                 if (inShutdown()) {
-                    return;
+                    return false;
                 }
 
                 fassertFailedNoTrace(16360);
             }
         }
+        return true;
     }
 
-    // This free function is used by the initial sync writer threads to apply each op
-    void multiInitialSyncApply(const std::vector<BSONObj>& ops, SyncTail* st) {
+    // Applies the ops of every bucket the writer takes in one unit of work, committed only if
+    // every writer of the batch succeeds.  Otherwise the applier applies the batch again with
+    // readers blocked.
+    static void deferredSyncApply(OperationContext* txn,
+                                  SyncTail::WriterQueue* queue,
+                                  size_t writerId,
+                                  SyncTail* st,
+                                  SyncTail::DeferredCommit* deferredCommit) {
+        WriteUnitOfWork wunit(txn);
+        bool ok = true;
+        size_t numOps = 0;
+        {
+            WriterBusyTimer busyTimer(writerId);
+            while (const std::vector<BSONObj>* ops = queue->next(writerId)) {
+                if (ok && deferredCommit->aborted()) {
+                    ok = false;
+                }
+                if (ok) {
+                    ok = syncApplyInUnitOfWork(txn, ops->begin(), ops->end(), st);
+                    numOps += ops->size();
+                }
+            }
+        }
+        if (deferredCommit->writerDone(ok)) {
+            wunit.commit();
+            opsAppliedStats.increment(numOps);
+        }
+    }
+
+    std::vector<BSONObj>::const_iterator endOfGroup(
+            std::vector<BSONObj>::const_iterator begin,
+            std::vector<BSONObj>::const_iterator end,
+            int maxOps,
+            int maxBytes) {
+        std::vector<BSONObj>::const_iterator it = begin;
+        int groupBytes = 0;
+        while (it != end &&
+               it - begin < maxOps &&
+               groupBytes < maxBytes &&
+               canApplyInGroup(*it)) {
+            groupBytes += it->objsize();
+            ++it;
+        }
+        return it;
+    }
+
+    // Applies one bucket of ops, returning false on shutdown.
+    static bool syncApplyBucket(OperationContext* txn,
+                                const std::vector<BSONObj>& ops,
+                                SyncTail* st) {
+        bool convertUpdatesToUpserts = true;
+
+        // Without document-level locking, CRUD ops lock their collection exclusively, so they
+        // can't keep their locks for a whole group.
+        const bool groupOps =
+            getGlobalEnvironment()->getGlobalStorageEngine()->supportsDocLocking();
+
+        std::vector<BSONObj>::const_iterator it = ops.begin();
+        while (it != ops.end()) {
+            // Readers are blocked for the whole batch, so rather than paying for a commit per
+            // op, apply runs of ops that only need intent locks in one unit of work.
+            std::vector<BSONObj>::const_iterator groupEnd =
+                groupOps ? endOfGroup(it, ops.end(), replApplyGroupMaxOps, replApplyGroupMaxBytes)
+                         : it;
+            if (groupEnd - it > 1) {
+                {
+                    WriteUnitOfWork wunit(txn);
+                    if (syncApplyInUnitOfWork(txn, it, groupEnd, st)) {
+                        wunit.commit();
+                        opsAppliedStats.increment(groupEnd - it);
+                        applyGroupStats.increment();
+                        it = groupEnd;
+                        continue;
+                    }
+                }
+
+                if (inShutdown()) {
+                    return false;
+                }
+
+                // Rolled back, so apply them one at a time instead.
+                applyGroupFallbackStats.increment();
+            }
+            else if (groupEnd == it) {
+                ++groupEnd;
+            }
+
+            for (; it != groupEnd; ++it) {
+                try {
+                    if (!st->syncApply(txn, *it, convertUpdatesToUpserts)) {
+                        fassertFailedNoTrace(16359);
+                    }
+                }
+                catch (const DBException& e) {
+                    error() << "writer worker caught exception: " << causedBy(e)
+                            << " on: " << it->toString();
+
+                    if (inShutdown()) {
+                        return false;
+                    }
+
+                    fassertFailedNoTrace(16360);
+                }
+            }
+        }
+        return true;
+    }
+
+    // This free function is used by the writer threads to apply each op
+    void multiSyncApply(SyncTail::WriterQueue* queue, size_t writerId, SyncTail* st) {
         initializeWriterThread();
 
         OperationContextImpl txn;
@@ -674,14 +1232,32 @@ namespace {
         // allow us to get through the magic barrier
         txn.lockState()->setIsBatchWriter(true);
 
+        SyncTail::DeferredCommit* deferredCommit = st->deferredCommit();
+        if (deferredCommit != NULL) {
+            deferredSyncApply(&txn, queue, writerId, st, deferredCommit);
+            return;
+        }
+
+        WriterBusyTimer busyTimer(writerId);
+        while (const std::vector<BSONObj>* ops = queue->next(writerId)) {
+            if (!syncApplyBucket(&txn, *ops, st)) {
+                return;
+            }
+        }
+    }
+
+    // Applies one bucket of ops during initial sync, returning false on shutdown.
+    static bool initialSyncApplyBucket(OperationContext* txn,
+                                       const std::vector<BSONObj>& ops,
+                                       SyncTail* st) {
         for (std::vector<BSONObj>::const_iterator it = ops.begin();
              it != ops.end();
              ++it) {
             try {
-                if (!st->syncApply(&txn, *it)) {
+                if (!st->syncApply(txn, *it)) {
 
-                    if (st->shouldRetry(&txn, *it)) {
-                        if (!st->syncApply(&txn, *it)) {
+                    if (st->shouldRetry(txn, *it)) {
+                        if (!st->syncApply(txn, *it)) {
                             fassertFailedNoTrace(15915);
                         }
                     }
@@ -696,12 +1272,30 @@ namespace {
                         << " on: " << it->toString();
 
                 if (inShutdown()) {
-                    return;
+                    return false;
                 }
 
                 fassertFailedNoTrace(16361);
             }
         }
+        return true;
+    }
+
+    // This free function is used by the initial sync writer threads to apply each op
+    void multiInitialSyncApply(SyncTail::WriterQueue* queue, size_t writerId, SyncTail* st) {
+        initializeWriterThread();
+
+        OperationContextImpl txn;
+
+        // allow us to get through the magic barrier
+        txn.lockState()->setIsBatchWriter(true);
+
+        WriterBusyTimer busyTimer(writerId);
+        while (const std::vector<BSONObj>* ops = queue->next(writerId)) {
+            if (!initialSyncApplyBucket(&txn, *ops, st)) {
+                return;
+            }
+        }
     }
 
 } // namespace repl
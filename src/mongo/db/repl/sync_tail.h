@@ -28,10 +28,16 @@
 
 #pragma once
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <algorithm>
 #include <deque>
+#include <vector>
 
+#include "mongo/base/disallow_copying.h"
 #include "mongo/db/storage/mmap_v1/dur.h"
 #include "mongo/db/repl/sync.h"
+#include "mongo/platform/atomic_word.h"
 #include "mongo/util/concurrency/thread_pool.h"
 
 namespace mongo {
@@ -46,7 +52,10 @@ namespace repl {
      * "Normal" replica set syncing
      */
     class SyncTail : public Sync {
-        typedef void (*MultiSyncApplyFunc)(const std::vector<BSONObj>& ops, SyncTail* st);
+    public:
+        class WriterQueue;
+    private:
+        typedef void (*MultiSyncApplyFunc)(WriterQueue* queue, size_t writerId, SyncTail* st);
     public:
         SyncTail(BackgroundSyncInterface *q, MultiSyncApplyFunc func);
         virtual ~SyncTail();
@@ -64,7 +73,7 @@ namespace repl {
 
         class OpQueue {
         public:
-            OpQueue() : _size(0) {}
+            OpQueue() : _size(0), _numDistributed(0) {}
             size_t getSize() { return _size; }
             std::deque<BSONObj>& getDeque() { return _deque; }
             void push_back(BSONObj& op) {
@@ -80,9 +89,26 @@ namespace repl {
                 return _deque.back();
             }
 
+            void swap(OpQueue& other) {
+                _deque.swap(other._deque);
+                std::swap(_size, other._size);
+                _writerVectors.swap(other._writerVectors);
+                std::swap(_numDistributed, other._numDistributed);
+            }
+
+            /**
+             * The first getNumDistributed() ops, split into buckets by fillWriterVectors, which
+             * keeps the ops of each document in one bucket.  Empty until it has been called.
+             */
+            std::vector< std::vector<BSONObj> >& getWriterVectors() { return _writerVectors; }
+            size_t getNumDistributed() const { return _numDistributed; }
+            void setNumDistributed(size_t numDistributed) { _numDistributed = numDistributed; }
+
         private:
             std::deque<BSONObj> _deque;
             size_t _size;
+            std::vector< std::vector<BSONObj> > _writerVectors;
+            size_t _numDistributed;
         };
 
         // returns true if we should continue waiting for BSONObjs, false if we should
@@ -91,6 +117,77 @@ namespace repl {
                                   OpQueue* ops,
                                   ReplicationCoordinator* replCoord);
 
+        /**
+         * Hands out the buckets of a batch to the writer threads.  Each bucket is applied by
+         * one writer, in order, but writers take buckets as they become free, largest first,
+         * so that a few large buckets don't leave the other writers idle.
+         */
+        class WriterQueue {
+            MONGO_DISALLOW_COPYING(WriterQueue);
+        public:
+            explicit WriterQueue(const std::vector< std::vector<BSONObj> >& buckets);
+
+            // The number of non-empty buckets.
+            size_t size() const { return _buckets.size(); }
+
+            /**
+             * Returns the next bucket for the writer to apply, or NULL once they have all
+             * been taken.
+             */
+            const std::vector<BSONObj>* next(size_t writerId);
+
+        private:
+            std::vector<const std::vector<BSONObj>*> _buckets;
+            AtomicUInt32 _next;
+        };
+
+        /**
+         * Lets the writer threads of a batch keep their ops in open transactions until every
+         * writer is done, so that the applier can commit the whole batch at once, and readers
+         * with snapshot isolation see either all of it or none of it.
+         */
+        class DeferredCommit {
+            MONGO_DISALLOW_COPYING(DeferredCommit);
+        public:
+            explicit DeferredCommit(size_t numWriters);
+
+            /**
+             * Called by each writer once it has applied its ops, with whether it succeeded.
+             * Blocks until the applier has decided, and returns whether to commit.
+             */
+            bool writerDone(bool ok);
+
+            /**
+             * Called by the applier.  Waits up to 'timeoutMillis' for every writer to be done,
+             * and returns whether they all were, and all succeeded.
+             */
+            bool waitForWriters(int timeoutMillis);
+
+            /**
+             * Called by the applier to let the writers commit, or roll back.
+             */
+            void release(bool commit);
+
+            /**
+             * Whether the applier has already decided to roll back, so the writers can stop.
+             */
+            bool aborted();
+
+        private:
+            boost::mutex _mutex;
+            boost::condition_variable _cond;
+            size_t _pending;
+            bool _allOk;
+            bool _released;
+            bool _commit;
+        };
+
+        /**
+         * Non-NULL while the writers should apply their ops in one transaction each and wait
+         * for the applier to commit them.
+         */
+        DeferredCommit* deferredCommit() const { return _deferredCommit; }
+
     protected:
         // Cap the batches using the limit on journal commits.
         // This works out to be 100 MB (64 bit) or 50 MB (32 bit)
@@ -100,8 +197,9 @@ namespace repl {
 
         // Prefetch and write a deque of operations, using the supplied function.
         // Initial Sync and Sync Tail each use a different function.
+        // If 'next' isn't NULL, the next batch is started in it while this one is applied.
         // Returns the last OpTime applied.
-        OpTime multiApply(OperationContext* txn, std::deque<BSONObj>& ops);
+        OpTime multiApply(OperationContext* txn, OpQueue* ops, OpQueue* next = NULL);
 
         /**
          * Applies oplog entries until reaching "endOpTime".
@@ -121,23 +219,60 @@ namespace repl {
         // Used by the thread pool readers to prefetch an op
         static void prefetchOp(const BSONObj& op);
 
-        // Doles out all the work to the writer pool threads and waits for them to complete
-        void applyOps(const std::vector< std::vector<BSONObj> >& writerVectors);
+        // Doles out all the work to the writer pool threads and waits for them to complete,
+        // starting the next batch in 'next', if not NULL, meanwhile.  If it can, also inserts
+        // the batch into the oplog meanwhile, committed once the writers are done, and returns
+        // true; the caller must then call finishWritingOpsToOplog.
+        bool applyOps(OperationContext* txn, OpQueue* ops, OpQueue* next, OpTime* lastOpTime);
+
+        // Whether applyOps may insert the batch into the oplog while the writers apply it.
+        bool canWriteOplogDuringApply(const std::deque<BSONObj>& ops) const;
+
+        // Starts as many writers as there are buckets to apply, up to the size of the pool.
+        // Returns the number started.
+        size_t scheduleWriters(WriterQueue* queue);
+
+        // Applies the batch and writes it to the oplog without blocking readers, committing
+        // all of it at once.  Returns false, having applied nothing, if some writer couldn't
+        // apply its ops that way.
+        bool applyOpsDeferred(OperationContext* txn,
+                              OpQueue* ops,
+                              OpQueue* next,
+                              OpTime* lastOpTime);
 
-        void fillWriterVectors(const std::deque<BSONObj>& ops, 
-                               std::vector< std::vector<BSONObj> >* writerVectors);
+        // Takes the ops that are ready in the queue for the next batch, without waiting.
+        void prepareNextBatch(OpQueue* next);
+
+        // Whether the batch may be applied with applyOpsDeferred.
+        bool canDeferCommit(const std::deque<BSONObj>& ops) const;
+
+        // Splits the ops that haven't been yet among the writer buckets.
+        void fillWriterVectors(OpQueue* ops);
         void handleSlaveDelay(const BSONObj& op);
 
+        // number of threads in _writerPool, see replWriterThreadCount
+        const int _numWriters;
         // persistent pool of worker threads for writing ops to the databases
         threadpool::ThreadPool _writerPool;
         // persistent pool of worker threads for prefetching
         threadpool::ThreadPool _prefetcherPool;
 
+        DeferredCommit* _deferredCommit;
+
     };
 
     // These free functions are used by the thread pool workers to write ops to the db.
-    void multiSyncApply(const std::vector<BSONObj>& ops, SyncTail* st);
-    void multiInitialSyncApply(const std::vector<BSONObj>& ops, SyncTail* st);
+    // Each applies the buckets it takes from the queue, as writer number 'writerId'.
+    void multiSyncApply(SyncTail::WriterQueue* queue, size_t writerId, SyncTail* st);
+    void multiInitialSyncApply(SyncTail::WriterQueue* queue, size_t writerId, SyncTail* st);
+
+    // Returns the end of the group of ops starting at 'begin' that a writer may apply in one
+    // unit of work: ops that only need intent locks, up to 'maxOps' ops, stopping once they
+    // add up to 'maxBytes'.
+    std::vector<BSONObj>::const_iterator endOfGroup(std::vector<BSONObj>::const_iterator begin,
+                                                    std::vector<BSONObj>::const_iterator end,
+                                                    int maxOps,
+                                                    int maxBytes);
 
 } // namespace repl
 } // namespace mongo
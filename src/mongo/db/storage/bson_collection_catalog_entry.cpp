@@ -37,22 +37,22 @@ namespace mongo {
     }
 
     CollectionOptions BSONCollectionCatalogEntry::getCollectionOptions( OperationContext* txn ) const {
-        MetaData md = _getMetaData( txn );
-        return md.options;
+        boost::shared_ptr<const MetaData> md = _getMetaDataSnapshot( txn );
+        return md->options;
     }
 
     int BSONCollectionCatalogEntry::getTotalIndexCount( OperationContext* txn ) const {
-        MetaData md = _getMetaData( txn );
+        boost::shared_ptr<const MetaData> md = _getMetaDataSnapshot( txn );
 
-        return static_cast<int>( md.indexes.size() );
+        return static_cast<int>( md->indexes.size() );
     }
 
     int BSONCollectionCatalogEntry::getCompletedIndexCount( OperationContext* txn ) const {
-        MetaData md = _getMetaData( txn );
+        boost::shared_ptr<const MetaData> md = _getMetaDataSnapshot( txn );
 
         int num = 0;
-        for ( unsigned i = 0; i < md.indexes.size(); i++ ) {
-            if ( md.indexes[i].ready )
+        for ( unsigned i = 0; i < md->indexes.size(); i++ ) {
+            if ( md->indexes[i].ready )
                 num++;
         }
         return num;
@@ -60,48 +60,48 @@ namespace mongo {
 
     BSONObj BSONCollectionCatalogEntry::getIndexSpec( OperationContext* txn,
                                                       StringData indexName ) const {
-        MetaData md = _getMetaData( txn );
+        boost::shared_ptr<const MetaData> md = _getMetaDataSnapshot( txn );
 
-        int offset = md.findIndexOffset( indexName );
+        int offset = md->findIndexOffset( indexName );
         invariant( offset >= 0 );
-        return md.indexes[offset].spec.getOwned();
+        return md->indexes[offset].spec.getOwned();
     }
 
 
     void BSONCollectionCatalogEntry::getAllIndexes( OperationContext* txn,
                                                     std::vector<std::string>* names ) const {
-        MetaData md = _getMetaData( txn );
+        boost::shared_ptr<const MetaData> md = _getMetaDataSnapshot( txn );
 
-        for ( unsigned i = 0; i < md.indexes.size(); i++ ) {
-            names->push_back( md.indexes[i].spec["name"].String() );
+        for ( unsigned i = 0; i < md->indexes.size(); i++ ) {
+            names->push_back( md->indexes[i].spec["name"].String() );
         }
     }
 
     bool BSONCollectionCatalogEntry::isIndexMultikey( OperationContext* txn,
                                                       StringData indexName) const {
-        MetaData md = _getMetaData( txn );
+        boost::shared_ptr<const MetaData> md = _getMetaDataSnapshot( txn );
 
-        int offset = md.findIndexOffset( indexName );
+        int offset = md->findIndexOffset( indexName );
         invariant( offset >= 0 );
-        return md.indexes[offset].multikey;
+        return md->indexes[offset].multikey;
     }
 
     RecordId BSONCollectionCatalogEntry::getIndexHead( OperationContext* txn,
                                                       StringData indexName ) const {
-        MetaData md = _getMetaData( txn );
+        boost::shared_ptr<const MetaData> md = _getMetaDataSnapshot( txn );
 
-        int offset = md.findIndexOffset( indexName );
+        int offset = md->findIndexOffset( indexName );
         invariant( offset >= 0 );
-        return md.indexes[offset].head;
+        return md->indexes[offset].head;
     }
 
     bool BSONCollectionCatalogEntry::isIndexReady( OperationContext* txn,
                                                    StringData indexName ) const {
-        MetaData md = _getMetaData( txn );
+        boost::shared_ptr<const MetaData> md = _getMetaDataSnapshot( txn );
 
-        int offset = md.findIndexOffset( indexName );
+        int offset = md->findIndexOffset( indexName );
         invariant( offset >= 0 );
-        return md.indexes[offset].ready;
+        return md->indexes[offset].ready;
     }
 
     // --------------------------
@@ -33,6 +33,8 @@
 #include <string>
 #include <vector>
 
+#include <boost/shared_ptr.hpp>
+
 #include "mongo/db/catalog/collection_catalog_entry.h"
 
 namespace mongo {
@@ -107,6 +109,14 @@ namespace mongo {
     protected:
         virtual MetaData _getMetaData( OperationContext* txn ) const = 0;
 
+        /**
+         * The read-only accessors above use this.  Implementations that keep parsed metadata
+         * around can hand out their copy instead of building a new one for every call.
+         */
+        virtual boost::shared_ptr<const MetaData> _getMetaDataSnapshot( OperationContext* txn ) const {
+            return boost::shared_ptr<const MetaData>( new MetaData( _getMetaData( txn ) ) );
+        }
+
     };
 
 }
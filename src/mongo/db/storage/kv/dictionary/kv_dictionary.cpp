@@ -28,6 +28,8 @@
  *    it in the license file.
  */
 
+#include <boost/scoped_ptr.hpp>
+
 #include "mongo/base/status.h"
 #include "mongo/db/storage/key_string.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
@@ -53,6 +55,76 @@ namespace mongo {
             std::copy(p, p + (sizeof big), data);
         }
 
+        /**
+         * Builder used by dictionaries that don't have a native bulk loader, which just inserts
+         * each pair in the current unit of work.
+         */
+        class KVDictionaryInsertBuilder : public KVDictionaryBuilder {
+            KVDictionary *_db;
+            OperationContext *_opCtx;
+
+        public:
+            KVDictionaryInsertBuilder(KVDictionary *db, OperationContext *opCtx)
+                : _db(db),
+                  _opCtx(opCtx)
+            {}
+
+            virtual Status insert(const Slice &key, const Slice &value) {
+                return _db->insert(_opCtx, key, value, false);
+            }
+
+            virtual Status commit(bool mayInterrupt) {
+                return Status::OK();
+            }
+        };
+
+    }
+
+    Status KVDictionary::getMany(OperationContext *opCtx, const std::vector<Slice> &keys, GetManyCallback &cb) const {
+        for (std::vector<Slice>::const_iterator it = keys.begin(); it != keys.end(); ++it) {
+            Slice value;
+            Status s = get(opCtx, *it, value);
+            if (s.isOK()) {
+                cb.found(*it, value);
+            } else if (s.code() != ErrorCodes::NoSuchKey) {
+                return s;
+            }
+        }
+        return Status::OK();
+    }
+
+    Status KVDictionary::removeRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                     int64_t *numRemoved, int64_t *sizeRemoved) {
+        int64_t n = 0;
+        int64_t size = 0;
+        for (boost::scoped_ptr<Cursor> c(getCursor(opCtx, left, 1)); c->ok(); ) {
+            // The cursor's key is only valid until it moves, so grab a copy before advancing past
+            // it and removing it.
+            const Slice key = c->currKey().owned();
+            if (Encoding::cmp(key, right) >= 0) {
+                break;
+            }
+            ++n;
+            size += c->currVal().size();
+            c->advance(opCtx);
+
+            Status s = remove(opCtx, key);
+            if (!s.isOK()) {
+                return s;
+            }
+        }
+
+        if (numRemoved != NULL) {
+            *numRemoved = n;
+        }
+        if (sizeRemoved != NULL) {
+            *sizeRemoved = size;
+        }
+        return Status::OK();
+    }
+
+    KVDictionaryBuilder *KVDictionary::getBuilder(OperationContext *opCtx) {
+        return new KVDictionaryInsertBuilder(this, opCtx);
     }
 
     KVDictionary::Encoding::Encoding()
@@ -31,6 +31,8 @@
 
 #pragma once
 
+#include <vector>
+
 #include "mongo/base/status.h"
 #include "mongo/bson/ordering.h"
 #include "mongo/db/storage/kv/slice.h"
@@ -42,6 +44,33 @@ namespace mongo {
     class KVUpdateMessage;
     class OperationContext;
 
+    /**
+     * Bulk loads key/value pairs into an empty KVDictionary.
+     *
+     * Pairs must be handed over in strictly increasing key order.  They become visible when
+     * commit() returns and the unit of work the builder was created in commits.
+     */
+    class KVDictionaryBuilder {
+    public:
+        virtual ~KVDictionaryBuilder() { }
+
+        /**
+         * Add `key' and its associated `value' to the dictionary being built.
+         *
+         * Requires: `key' is greater than any key previously inserted into this builder.
+         * Return: Status::OK() success.
+         */
+        virtual Status insert(const Slice &key, const Slice &value) = 0;
+
+        /**
+         * Finish loading the dictionary.  If `mayInterrupt' is true, the implementation may check
+         * for interruption of the operation while it works.
+         *
+         * Return: Status::OK() success.
+         */
+        virtual Status commit(bool mayInterrupt) = 0;
+    };
+
     /**
      * A sorted dictionary interface for mapping binary keys to binary
      * values.
@@ -152,6 +181,32 @@ namespace mongo {
          */
         virtual Status get(OperationContext *opCtx, const Slice &key, Slice &value, bool skipPessimisticLocking=false) const = 0;
 
+        /**
+         * Receives the results of getMany().
+         */
+        class GetManyCallback {
+        public:
+            virtual ~GetManyCallback() { }
+
+            /**
+             * Called once for each requested key that exists, in key order.  `value' is owned.
+             */
+            virtual void found(const Slice &key, const Slice &value) = 0;
+        };
+
+        /**
+         * Look up many keys at once, calling `cb.found()' for each one that exists in the
+         * dictionary.
+         *
+         * Implementations may be able to do this much more cheaply than with a get() per key, for
+         * example by reading runs of nearby keys with one cursor.  The default implementation just
+         * calls get() for each key.
+         *
+         * Requires: `keys' is sorted and contains no duplicates.
+         * Return: Status::OK() success.
+         */
+        virtual Status getMany(OperationContext *opCtx, const std::vector<Slice> &keys, GetManyCallback &cb) const;
+
         /**
          * Insert `key' into the dictionary and associate it with `value',
          * overwriting any existing value.
@@ -168,6 +223,34 @@ namespace mongo {
          */
         virtual Status remove(OperationContext *opCtx, const Slice &key) = 0;
 
+        /**
+         * Remove every key in the range [`left', `right') and its associated value from the
+         * dictionary, as if by calling remove() on each of them.
+         *
+         * The default implementation does just that, with a cursor.  Implementations that can
+         * delete without looking up each key first should override this.
+         *
+         * If `numRemoved' and `sizeRemoved' are not NULL, they are set to the number of keys
+         * removed and the total size of their values.  Implementations that don't look at each
+         * key may report estimates.
+         *
+         * Return: Status::OK() success.
+         */
+        virtual Status removeRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                   int64_t *numRemoved, int64_t *sizeRemoved);
+
+        /**
+         * Get a builder that bulk loads pre-sorted key/value pairs into this dictionary, which
+         * must be empty.
+         *
+         * The default implementation just calls insert() for each pair, in the unit of work
+         * `opCtx' has open.  Implementations with a native bulk loading mechanism should override
+         * this.
+         *
+         * Return: KVDictionaryBuilder implementation (ownership passes to caller)
+         */
+        virtual KVDictionaryBuilder *getBuilder(OperationContext *opCtx);
+
         /**
          * Returns true if the underlying implementation supports a fast update mechanism.  If so,
          * it should implement both overloads of update() below.
@@ -265,6 +348,21 @@ namespace mongo {
          */
         virtual Stats getStats() const = 0;
 
+        /**
+         * Find up to `numRanges - 1' keys that split the dictionary into `numRanges' ranges of
+         * about the same size, for scanning it in parallel.  The keys are appended to
+         * `splitKeys' in order, and are owned.
+         *
+         * Fewer keys (possibly none) may be returned if the dictionary is too small to split
+         * that finely, or if the implementation can't estimate where to split.  The default
+         * implementation returns none.
+         *
+         * Return: Status::OK() success.
+         */
+        virtual Status getSplitKeys(OperationContext *opCtx, size_t numRanges, std::vector<Slice> &splitKeys) const {
+            return Status::OK();
+        }
+
         /**
          * Append specific stats about this dictionary to the given bson
          * builder.
@@ -334,6 +432,23 @@ namespace mongo {
              * Requires: ok() is true
              */
             virtual Slice currVal() const = 0;
+
+            /**
+             * Called when the caller is about to give up its operation context (on a yield or
+             * between getMore batches) but would like to keep using this cursor afterwards.
+             * The only calls allowed after this are reattach() and destruction.
+             */
+            virtual void detach() { }
+
+            /**
+             * Resumes using a detached cursor with a new operation context.
+             *
+             * Return: true, the cursor is positioned on the key it was on when detached, or the
+             *               next key in its direction if that key is gone
+             *         false, the cursor can't be reused and the caller must get a new one
+             * Requires: ok() was true when detach() was called
+             */
+            virtual bool reattach(OperationContext *opCtx) { return false; }
         };
 
         /**
@@ -347,6 +462,23 @@ namespace mongo {
         virtual Cursor *getCursor(OperationContext *opCtx, const Slice &key, const int direction = 1) const = 0;
 
         virtual Cursor *getCursor(OperationContext *opCtx, const int direction = 1) const = 0;
+
+        /**
+         * Get a cursor positioned like getCursor(opCtx, key, direction), which the caller will
+         * stop using once it passes 'endKey' in its direction (or reaches it, if
+         * !endKeyInclusive).
+         *
+         * Implementations may use the end key to avoid reading ahead of, or locking, anything
+         * past it, in which case the cursor stops there.  The default ignores it, so callers must
+         * still check for the end themselves.
+         *
+         * Return: Cursor interface implementation (ownership passes to caller)
+         */
+        virtual Cursor *getRangeCursor(OperationContext *opCtx, const Slice &key,
+                                       const Slice &endKey, bool endKeyInclusive,
+                                       const int direction = 1) const {
+            return getCursor(opCtx, key, direction);
+        }
     };
 
 } // namespace mongo
@@ -0,0 +1,218 @@
+// kv_dictionary_parallel_scan.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "mongo/base/owned_pointer_vector.h"
+#include "mongo/db/operation_context_noop.h"
+#include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
+#include "mongo/db/storage/kv/dictionary/kv_dictionary_parallel_scan.h"
+#include "mongo/db/storage/kv/dictionary/kv_recovery_unit.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/progress_meter.h"
+#include "mongo/util/scopeguard.h"
+
+namespace mongo {
+
+    namespace {
+
+        // How often the thread calling run() reports progress and checks for interrupts while
+        // other threads scan.
+        const int kPollIntervalMillis = 500;
+
+        // How often a scan on the caller's own thread checks for interrupts, in entries.
+        const long long kInterruptCheckInterval = 1024;
+
+    }
+
+    KVDictionaryParallelScan::KVDictionaryParallelScan(const KVDictionary *db)
+        : _db(db),
+          _nextRange(0),
+          _numRunning(0),
+          _error(Status::OK())
+    {}
+
+    size_t KVDictionaryParallelScan::split(OperationContext *txn, size_t maxRanges) {
+        _splitKeys.clear();
+        if (maxRanges > 1) {
+            Status s = _db->getSplitKeys(txn, maxRanges, _splitKeys);
+            if (!s.isOK()) {
+                // Still correct, just slower.
+                _splitKeys.clear();
+            }
+        }
+        return _splitKeys.size() + 1;
+    }
+
+    Status KVDictionaryParallelScan::run(OperationContext *txn, const std::vector<RangeVisitor *> &visitors,
+                                         size_t maxThreads, const char *progressMessage,
+                                         unsigned long long progressTotal) {
+        invariant(visitors.size() == _splitKeys.size() + 1);
+
+        boost::scoped_ptr<ProgressMeterHolder> progress;
+        if (progressMessage != NULL) {
+            progress.reset(new ProgressMeterHolder(*txn->setMessage(progressMessage, "Scan Progress",
+                                                                    progressTotal)));
+        }
+
+        // Other threads read from the caller's snapshot with recovery units that share it, which
+        // only a KVRecoveryUnit may know how to make.
+        KVRecoveryUnit *ru = dynamic_cast<KVRecoveryUnit *>(txn->recoveryUnit());
+        const size_t maxWorkers = ru == NULL ? 1 : std::min(maxThreads, visitors.size());
+        OwnedPointerVector<KVRecoveryUnit> workerRUs;
+        for (size_t i = 0; maxWorkers > 1 && i < maxWorkers; ++i) {
+            KVRecoveryUnit *workerRU = ru->newSharedSnapshotRecoveryUnit(txn);
+            if (workerRU == NULL) {
+                break;
+            }
+            workerRUs.push_back(workerRU);
+        }
+        const size_t numThreads = workerRUs.size();
+
+        if (numThreads <= 1) {
+            for (size_t i = 0; i < visitors.size(); ++i) {
+                Status s = _scanRange(txn, i, visitors[i], progress.get());
+                if (!s.isOK()) {
+                    return s;
+                }
+            }
+            return Status::OK();
+        }
+
+        _numScanned.store(0);
+        _nextRange = 0;
+        _numRunning = numThreads;
+        _error = Status::OK();
+
+        boost::thread_group threads;
+        for (size_t i = 0; i < numThreads; ++i) {
+            threads.create_thread(boost::bind(&KVDictionaryParallelScan::_worker, this,
+                                              workerRUs[i], boost::cref(visitors)));
+        }
+
+        long long reported = 0;
+        {
+            boost::mutex::scoped_lock lk(_mutex);
+            while (_numRunning > 0) {
+                _workerDone.timed_wait(lk, boost::posix_time::milliseconds(kPollIntervalMillis));
+                if (progress) {
+                    const long long scanned = _numScanned.load();
+                    progress->hit(static_cast<int>(scanned - reported));
+                    reported = scanned;
+                }
+                Status interrupted = txn->checkForInterruptNoAssert();
+                if (!interrupted.isOK() && _error.isOK()) {
+                    _error = interrupted;
+                }
+            }
+        }
+        threads.join_all();
+
+        return _error;
+    }
+
+    void KVDictionaryParallelScan::_worker(KVRecoveryUnit *ru, const std::vector<RangeVisitor *> &visitors) {
+        // The recovery unit stays owned by run(), it must go away before the caller's snapshot.
+        OperationContextNoop opCtx(ru);
+        ON_BLOCK_EXIT_OBJ(opCtx, &OperationContextNoop::releaseRecoveryUnit);
+
+        while (true) {
+            size_t i;
+            {
+                boost::mutex::scoped_lock lk(_mutex);
+                if (!_error.isOK() || _nextRange == visitors.size()) {
+                    break;
+                }
+                i = _nextRange++;
+            }
+
+            Status s = Status::OK();
+            try {
+                s = _scanRange(&opCtx, i, visitors[i], NULL);
+            } catch (const DBException &e) {
+                s = e.toStatus();
+            }
+            if (!s.isOK()) {
+                _setError(s);
+            }
+        }
+
+        boost::mutex::scoped_lock lk(_mutex);
+        _numRunning--;
+        _workerDone.notify_all();
+    }
+
+    Status KVDictionaryParallelScan::_scanRange(OperationContext *opCtx, size_t i, RangeVisitor *visitor,
+                                                ProgressMeterHolder *progress) {
+        const Slice start = i == 0 ? Slice() : _splitKeys[i - 1];
+        const bool hasEnd = i < _splitKeys.size();
+        boost::scoped_ptr<KVDictionary::Cursor> cur(hasEnd
+                                                    ? _db->getRangeCursor(opCtx, start, _splitKeys[i], false)
+                                                    : _db->getCursor(opCtx, start));
+
+        for (long long n = 1; cur->ok(); cur->advance(opCtx), n++) {
+            const Slice key = cur->currKey();
+            if (hasEnd && KVDictionary::Encoding::cmp(key, _splitKeys[i]) >= 0) {
+                break;
+            }
+
+            Status s = visitor->visit(key, cur->currVal());
+            if (!s.isOK()) {
+                return s;
+            }
+            _numScanned.fetchAndAdd(1);
+
+            if (progress != NULL) {
+                // Only set when scanning on the caller's thread, with its OperationContext.
+                progress->hit();
+                if (n % kInterruptCheckInterval == 0) {
+                    s = opCtx->checkForInterruptNoAssert();
+                    if (!s.isOK()) {
+                        return s;
+                    }
+                }
+            }
+        }
+        return Status::OK();
+    }
+
+    void KVDictionaryParallelScan::_setError(const Status &s) {
+        boost::mutex::scoped_lock lk(_mutex);
+        if (_error.isOK()) {
+            _error = s;
+        }
+    }
+
+} // namespace mongo
@@ -0,0 +1,118 @@
+// kv_dictionary_parallel_scan.h
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/base/status.h"
+#include "mongo/db/storage/kv/slice.h"
+#include "mongo/platform/atomic_word.h"
+
+namespace mongo {
+
+    class KVDictionary;
+    class KVRecoveryUnit;
+    class OperationContext;
+    class ProgressMeterHolder;
+
+    /**
+     * Scans a whole KVDictionary in key ranges, several at a time, for validate.
+     *
+     * The dictionary is split with getSplitKeys(), and each range is given its own RangeVisitor,
+     * so visitors don't need any locking and callers combine their results once run() returns.
+     * Every range is read from the caller's snapshot: other scanning threads get recovery units
+     * that share it (see KVRecoveryUnit::newSharedSnapshotRecoveryUnit), and if the caller's
+     * can't be shared, all ranges are scanned on the caller's thread.
+     */
+    class KVDictionaryParallelScan {
+        MONGO_DISALLOW_COPYING(KVDictionaryParallelScan);
+    public:
+        /**
+         * Sees the entries of one range, in order, all on the same thread.
+         */
+        class RangeVisitor {
+        public:
+            virtual ~RangeVisitor() { }
+
+            virtual Status visit(const Slice &key, const Slice &value) = 0;
+        };
+
+        explicit KVDictionaryParallelScan(const KVDictionary *db);
+
+        /**
+         * Splits the dictionary into at most `maxRanges' ranges.
+         *
+         * Return: the number of ranges, and visitors, run() needs (at least 1).
+         */
+        size_t split(OperationContext *txn, size_t maxRanges);
+
+        /**
+         * Scans range i with visitors[i], on at most `maxThreads' threads.  Stops as soon as a
+         * visitor fails or the operation is killed.
+         *
+         * If `progressMessage' isn't NULL, progress through `progressTotal' entries is reported
+         * with the operation's CurOp.
+         *
+         * Return: Status::OK(), success
+         *         the first error from a visitor or the interrupt check, otherwise
+         */
+        Status run(OperationContext *txn, const std::vector<RangeVisitor *> &visitors, size_t maxThreads,
+                   const char *progressMessage, unsigned long long progressTotal);
+
+    private:
+        // Scans ranges until there are none left or something failed.
+        void _worker(KVRecoveryUnit *ru, const std::vector<RangeVisitor *> &visitors);
+
+        // `progress' is only given when scanning on the caller's thread.
+        Status _scanRange(OperationContext *opCtx, size_t i, RangeVisitor *visitor,
+                          ProgressMeterHolder *progress);
+
+        void _setError(const Status &s);
+
+        const KVDictionary *_db;
+        // Range i is [_splitKeys[i-1], _splitKeys[i]), the first and last are unbounded.
+        std::vector<Slice> _splitKeys;
+
+        AtomicInt64 _numScanned;
+
+        boost::mutex _mutex;
+        boost::condition_variable _workerDone;
+        size_t _nextRange;
+        size_t _numRunning;
+        Status _error;
+    };
+
+} // namespace mongo
@@ -36,6 +36,7 @@
 #include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary_test_harness.h"
 #include "mongo/db/storage/kv/slice.h"
+#include "mongo/platform/endian.h"
 #include "mongo/unittest/unittest.h"
 
 namespace mongo {
@@ -419,4 +420,372 @@ namespace mongo {
 
     }
 
+    TEST( KVDictionary, CursorSeekJumps ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<KVDictionary> db( harnessHelper->newKVDictionary() );
+
+        const unsigned char nKeys = 200;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                for (unsigned char i = 0; i < nKeys; i += 2) {
+                    const Slice slice = Slice::of(i);
+                    Status status = db->insert( opCtx.get(), slice, slice, false );
+                    ASSERT( status.isOK() );
+                }
+                uow.commit();
+            }
+        }
+
+        // Seek a little ahead, far ahead, and back, in both directions.
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                scoped_ptr<KVDictionary::Cursor> cursor( db->getCursor( opCtx.get(), 1 ) );
+                const unsigned char targets[] = { 5, 7, 150, 3, 3, 198, 0 };
+                const unsigned char expected[] = { 6, 8, 150, 4, 4, 198, 0 };
+                for (size_t i = 0; i < sizeof(targets); i++) {
+                    cursor->seek( opCtx.get(), Slice::of(targets[i]) );
+                    ASSERT( cursor->ok() );
+                    ASSERT( cursor->currKey().as<unsigned char>() == expected[i] );
+                }
+                const unsigned char pastEnd = 199;
+                cursor->seek( opCtx.get(), Slice::of(pastEnd) );
+                ASSERT( !cursor->ok() );
+                const unsigned char start = 1;
+                cursor->seek( opCtx.get(), Slice::of(start) );
+                ASSERT( cursor->ok() );
+                ASSERT( cursor->currKey().as<unsigned char>() == 2 );
+            }
+            {
+                scoped_ptr<KVDictionary::Cursor> cursor( db->getCursor( opCtx.get(), -1 ) );
+                const unsigned char targets[] = { 195, 193, 51, 197, 197, 1 };
+                const unsigned char expected[] = { 194, 192, 50, 196, 196, 0 };
+                for (size_t i = 0; i < sizeof(targets); i++) {
+                    cursor->seek( opCtx.get(), Slice::of(targets[i]) );
+                    ASSERT( cursor->ok() );
+                    ASSERT( cursor->currKey().as<unsigned char>() == expected[i] );
+                }
+            }
+        }
+    }
+
+    TEST( KVDictionary, BuilderSorted ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<KVDictionary> db( harnessHelper->newKVDictionary() );
+
+        const unsigned char nKeys = 100;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                scoped_ptr<KVDictionaryBuilder> builder( db->getBuilder( opCtx.get() ) );
+                for (unsigned char i = 0; i < nKeys; i++) {
+                    const Slice slice = Slice::of(i);
+                    Status status = builder->insert( slice, slice );
+                    ASSERT( status.isOK() );
+                }
+                Status status = builder->commit( false );
+                ASSERT( status.isOK() );
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                unsigned char i = 0;
+                for (scoped_ptr<KVDictionary::Cursor> c(db->getCursor(opCtx.get(), 1));
+                     c->ok(); c->advance(opCtx.get()), i++) {
+                    ASSERT( c->currKey().as<unsigned char>() == i );
+                    ASSERT( c->currVal().as<unsigned char>() == i );
+                }
+                ASSERT( i == nKeys );
+            }
+        }
+
+    }
+
+    TEST( KVDictionary, BuilderAbandoned ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<KVDictionary> db( harnessHelper->newKVDictionary() );
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                scoped_ptr<KVDictionaryBuilder> builder( db->getBuilder( opCtx.get() ) );
+                for (unsigned char i = 0; i < 10; i++) {
+                    const Slice slice = Slice::of(i);
+                    Status status = builder->insert( slice, slice );
+                    ASSERT( status.isOK() );
+                }
+                // no commit
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                scoped_ptr<KVDictionary::Cursor> c(db->getCursor(opCtx.get(), 1));
+                ASSERT( !c->ok() );
+            }
+        }
+
+    }
+
+    namespace {
+
+        class CollectingCallback : public KVDictionary::GetManyCallback {
+        public:
+            std::vector<unsigned char> keys;
+            std::vector<unsigned char> vals;
+
+            virtual void found(const Slice &key, const Slice &value) {
+                keys.push_back(key.as<unsigned char>());
+                vals.push_back(value.as<unsigned char>());
+            }
+        };
+
+    }
+
+    TEST( KVDictionary, GetMany ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<KVDictionary> db( harnessHelper->newKVDictionary() );
+
+        const unsigned char nKeys = 100;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                // Only insert the even keys.
+                for (unsigned char i = 0; i < nKeys; i += 2) {
+                    const Slice key = Slice::of(i);
+                    const Slice val = Slice::of(static_cast<unsigned char>(i + 1));
+                    Status status = db->insert( opCtx.get(), key, val, false );
+                    ASSERT( status.isOK() );
+                }
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                std::vector<unsigned char> wanted;
+                for (unsigned char i = 10; i < 30; i++) {
+                    wanted.push_back(i);
+                }
+                wanted.push_back(50);
+                wanted.push_back(99);
+
+                std::vector<Slice> keys;
+                for (size_t i = 0; i < wanted.size(); i++) {
+                    keys.push_back(Slice::of(wanted[i]));
+                }
+
+                CollectingCallback cb;
+                Status status = db->getMany( opCtx.get(), keys, cb );
+                ASSERT( status.isOK() );
+
+                ASSERT_EQUALS( cb.keys.size(), 11U );
+                for (size_t i = 0; i < cb.keys.size(); i++) {
+                    ASSERT( cb.keys[i] % 2 == 0 );
+                    ASSERT( cb.vals[i] == cb.keys[i] + 1 );
+                }
+                ASSERT( cb.keys.front() == 10 );
+                ASSERT( cb.keys[9] == 28 );
+                ASSERT( cb.keys.back() == 50 );
+            }
+        }
+    }
+
+    TEST( KVDictionary, RemoveRange ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<KVDictionary> db( harnessHelper->newKVDictionary() );
+
+        const unsigned char nKeys = 100;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                for (unsigned char i = 0; i < nKeys; i++) {
+                    const Slice slice = Slice::of(i);
+                    Status status = db->insert( opCtx.get(), slice, slice, false );
+                    ASSERT( status.isOK() );
+                }
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                const unsigned char left = 10;
+                const unsigned char right = 20;
+                int64_t numRemoved = 0;
+                int64_t sizeRemoved = 0;
+                Status status = db->removeRange( opCtx.get(), Slice::of(left), Slice::of(right),
+                                                 &numRemoved, &sizeRemoved );
+                ASSERT( status.isOK() );
+                ASSERT_EQUALS( numRemoved, 10 );
+                ASSERT_EQUALS( sizeRemoved, 10 );
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                unsigned char expected = 0;
+                int n = 0;
+                for (scoped_ptr<KVDictionary::Cursor> c(db->getCursor(opCtx.get(), 1));
+                     c->ok(); c->advance(opCtx.get()), n++) {
+                    if (expected == 10) {
+                        expected = 20;
+                    }
+                    ASSERT( c->currKey().as<unsigned char>() == expected );
+                    expected++;
+                }
+                ASSERT_EQUALS( n, nKeys - 10 );
+            }
+        }
+    }
+
+    TEST( KVDictionary, CursorReattach ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<KVDictionary> db( harnessHelper->newKVDictionary() );
+
+        const unsigned char nKeys = 100;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                for (unsigned char i = 0; i < nKeys; i++) {
+                    const Slice slice = Slice::of(i);
+                    Status status = db->insert( opCtx.get(), slice, slice, false );
+                    ASSERT( status.isOK() );
+                }
+                uow.commit();
+            }
+        }
+
+        scoped_ptr<KVDictionary::Cursor> c;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            c.reset(db->getCursor(opCtx.get(), 1));
+            for (unsigned char i = 0; i < 10; i++) {
+                ASSERT( c->ok() );
+                ASSERT( c->currKey().as<unsigned char>() == i );
+                c->advance(opCtx.get());
+            }
+            c->detach();
+        }
+
+        {
+            // Remove the key the cursor is on while it's detached.
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                const unsigned char key = 10;
+                Status status = db->remove( opCtx.get(), Slice::of(key) );
+                ASSERT( status.isOK() );
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            if (!c->reattach(opCtx.get())) {
+                return;
+            }
+            unsigned char expected = 11;
+            for (; c->ok(); c->advance(opCtx.get()), expected++) {
+                ASSERT( c->currKey().as<unsigned char>() == expected );
+            }
+            ASSERT_EQUALS( expected, nKeys );
+        }
+    }
+
+    TEST( KVDictionary, RangeCursor ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<KVDictionary> db( harnessHelper->newKVDictionary() );
+
+        const unsigned char nKeys = 100;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                for (unsigned char i = 0; i < nKeys; i++) {
+                    const Slice slice = Slice::of(i);
+                    Status status = db->insert( opCtx.get(), slice, slice, false );
+                    ASSERT( status.isOK() );
+                }
+                uow.commit();
+            }
+        }
+
+        // The end key is only a hint, so stop at it ourselves, but everything up to it has to be
+        // there.
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            const unsigned char start = 20, end = 30;
+            scoped_ptr<KVDictionary::Cursor> c( db->getRangeCursor( opCtx.get(), Slice::of(start),
+                                                                    Slice::of(end), true, 1 ) );
+            unsigned char expected = start;
+            for (; c->ok() && c->currKey().as<unsigned char>() <= end;
+                 c->advance(opCtx.get()), expected++) {
+                ASSERT( c->currKey().as<unsigned char>() == expected );
+            }
+            ASSERT_EQUALS( expected, end + 1 );
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            const unsigned char start = 30, end = 20;
+            scoped_ptr<KVDictionary::Cursor> c( db->getRangeCursor( opCtx.get(), Slice::of(start),
+                                                                    Slice::of(end), false, -1 ) );
+            unsigned char expected = start;
+            for (; c->ok() && c->currKey().as<unsigned char>() > end;
+                 c->advance(opCtx.get()), expected--) {
+                ASSERT( c->currKey().as<unsigned char>() == expected );
+            }
+            ASSERT_EQUALS( expected, end );
+        }
+    }
+
+    TEST( KVDictionary, GetSplitKeys ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<KVDictionary> db( harnessHelper->newKVDictionary() );
+
+        const int nKeys = 10000;
+        const std::string value(100, 'x');
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                for (int i = 0; i < nKeys; i++) {
+                    const int key = endian::nativeToBig(i);
+                    Status status = db->insert( opCtx.get(), Slice::of(key), Slice(value), false );
+                    ASSERT( status.isOK() );
+                }
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            const size_t numRanges = 4;
+            std::vector<Slice> splitKeys;
+            Status status = db->getSplitKeys( opCtx.get(), numRanges, splitKeys );
+            ASSERT( status.isOK() );
+            ASSERT_LESS_THAN( splitKeys.size(), numRanges );
+            for (size_t i = 1; i < splitKeys.size(); i++) {
+                ASSERT_LESS_THAN( KVDictionary::Encoding::cmp( splitKeys[i - 1], splitKeys[i] ), 0 );
+            }
+        }
+    }
+
 }
@@ -28,6 +28,8 @@
  *    it in the license file.
  */
 
+#include <algorithm>
+
 #include "mongo/db/storage/kv/dictionary/kv_dictionary_update.h"
 #include "mongo/db/storage/kv/dictionary/simple_serializer.h"
 #include "mongo/platform/endian.h"
@@ -58,6 +60,8 @@ namespace mongo {
             return KVUpdateWithDamagesMessage::deserializeFrom(slice);
         case UpdateIncrement:
             return KVUpdateIncrementMessage::deserializeFrom(slice);
+        case UpdateBSONDiff:
+            return KVUpdateBSONDiffMessage::deserializeFrom(slice);
         default:
             invariant(false);
         }
@@ -186,5 +190,85 @@ namespace mongo {
         return new KVUpdateIncrementMessage(delta);
     }
 
+    // ---------------------------------------------------------------------- //
+
+    namespace {
+
+        // Size of the int32 length header at the beginning of every BSON object.
+        const size_t kBSONHeaderSize = sizeof(int32_t);
+
+    }
+
+    KVUpdateBSONDiffMessage KVUpdateBSONDiffMessage::diff(const Slice &oldObj, const Slice &newObj) {
+        invariant(oldObj.size() >= kBSONHeaderSize && newObj.size() >= kBSONHeaderSize);
+        const size_t maxCommon = std::min(oldObj.size(), newObj.size()) - kBSONHeaderSize;
+
+        size_t prefixSize = 0;
+        const char *oldBody = oldObj.data() + kBSONHeaderSize;
+        const char *newBody = newObj.data() + kBSONHeaderSize;
+        while (prefixSize < maxCommon && oldBody[prefixSize] == newBody[prefixSize]) {
+            ++prefixSize;
+        }
+
+        // The suffix can't overlap the prefix in either object.
+        size_t suffixSize = 0;
+        const char *oldLast = oldObj.data() + oldObj.size() - 1;
+        const char *newLast = newObj.data() + newObj.size() - 1;
+        while (prefixSize + suffixSize < maxCommon && *(oldLast - suffixSize) == *(newLast - suffixSize)) {
+            ++suffixSize;
+        }
+
+        const size_t middleSize = newObj.size() - kBSONHeaderSize - prefixSize - suffixSize;
+        return KVUpdateBSONDiffMessage(prefixSize, suffixSize, newBody + prefixSize, middleSize);
+    }
+
+    Status KVUpdateBSONDiffMessage::apply(const Slice &oldValue, Slice &newValue) const {
+        invariant(oldValue.size() >= kBSONHeaderSize + _prefixSize + _suffixSize);
+
+        const size_t newSize = kBSONHeaderSize + _prefixSize + _middleSize + _suffixSize;
+        newValue = Slice(newSize);
+        char *dest = newValue.mutableData();
+
+        const int32_t littleSize = mongo::endian::nativeToLittle(static_cast<int32_t>(newSize));
+        std::copy(reinterpret_cast<const char *>(&littleSize),
+                  reinterpret_cast<const char *>(&littleSize) + kBSONHeaderSize, dest);
+        dest += kBSONHeaderSize;
+
+        const char *oldBody = oldValue.data() + kBSONHeaderSize;
+        dest = std::copy(oldBody, oldBody + _prefixSize, dest);
+        dest = std::copy(_middle, _middle + _middleSize, dest);
+        const char *oldEnd = oldValue.data() + oldValue.size();
+        std::copy(oldEnd - _suffixSize, oldEnd, dest);
+
+        return Status::OK();
+    }
+
+    size_t KVUpdateBSONDiffMessage::serializedSize() const {
+        return sizeof(size_t) + sizeof(size_t) + _middleSize;
+    }
+
+    // The serialized format is the prefix and suffix sizes, followed by the middle bytes, whose
+    // size is whatever is left.
+    void KVUpdateBSONDiffMessage::serializeTo(char *dest) const {
+        BufferWriter writer(dest);
+
+        writer.write(_prefixSize);
+        writer.write(_suffixSize);
+        std::copy(_middle, _middle + _middleSize, writer.get());
+    }
+
+    KVUpdateMessage *KVUpdateBSONDiffMessage::deserializeFrom(const Slice &serialized) {
+        BufferReader reader(serialized.data());
+
+        invariant(serialized.size() >= sizeof(size_t) + sizeof(size_t));
+        const size_t prefixSize = reader.read<size_t>();
+        const size_t suffixSize = reader.read<size_t>();
+
+        const char *middle = reader.get();
+        const size_t middleSize = serialized.size() - (middle - serialized.data());
+
+        return new KVUpdateBSONDiffMessage(prefixSize, suffixSize, middle, middleSize);
+    }
+
 } // namespace mongo
 
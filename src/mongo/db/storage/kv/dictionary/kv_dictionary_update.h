@@ -84,6 +84,7 @@ namespace mongo {
         enum Type {
             UpdateWithDamages,
             UpdateIncrement,
+            UpdateBSONDiff,
         };
 
         /**
@@ -168,4 +169,55 @@ namespace mongo {
         int64_t _delta;
     };
 
+    /**
+     * An update message that turns one BSON object into another by replacing whatever lies between
+     * the bytes they have in common at the beginning and at the end, and then rewriting the length
+     * header.  Updates to large documents usually only touch a small part of them, so this is
+     * much smaller than a full new image.
+     *
+     * Used by KVRecordStore::updateRecord.
+     */
+    class KVUpdateBSONDiffMessage : public KVUpdateMessage {
+    public:
+        KVUpdateBSONDiffMessage(size_t prefixSize, size_t suffixSize, const char *middle, size_t middleSize)
+            : _prefixSize(prefixSize),
+              _suffixSize(suffixSize),
+              _middle(middle),
+              _middleSize(middleSize)
+        {}
+
+        /**
+         * Return: the message that turns `oldObj' into `newObj', which points into `newObj'.
+         */
+        static KVUpdateBSONDiffMessage diff(const Slice &oldObj, const Slice &newObj);
+
+        static KVUpdateMessage *deserializeFrom(const Slice &serialized);
+
+        virtual Status apply(const Slice &oldValue, Slice &newValue) const;
+
+        /**
+         * Return: the number of bytes of the new object that the message carries.
+         */
+        size_t changedSize() const { return _middleSize; }
+
+        static bool usable() { return true; }
+
+    protected:
+        virtual Type getType() const {
+            return UpdateBSONDiff;
+        }
+
+        virtual size_t serializedSize() const;
+
+        virtual void serializeTo(char *dest) const;
+
+        // Bytes after the length header that are the same in the old and new objects.
+        size_t _prefixSize;
+        // Bytes at the end that are the same in the old and new objects.
+        size_t _suffixSize;
+        // Bytes of the new object between the prefix and suffix.
+        const char *_middle;
+        size_t _middleSize;
+    };
+
 } // namespace mongo
@@ -28,15 +28,23 @@
  *    it in the license file.
  */
 
+#include <set>
+
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
+#include "mongo/db/catalog/collection.h"
+#include "mongo/db/catalog/collection_options.h"
 #include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/operation_context_noop.h"
 #include "mongo/db/storage/kv/dictionary/kv_engine_impl.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
+#include "mongo/db/storage/kv/dictionary/kv_partitioned_dictionary.h"
 #include "mongo/db/storage/kv/dictionary/kv_record_store.h"
 #include "mongo/db/storage/kv/dictionary/kv_record_store_capped.h"
+#include "mongo/db/storage/kv/dictionary/kv_record_store_partitioned.h"
 #include "mongo/db/storage/kv/dictionary/kv_sorted_data_impl.h"
+#include "mongo/db/storage/kv/dictionary/kv_sorted_data_partitioned.h"
 
 namespace mongo {
 
@@ -50,7 +58,12 @@ namespace mongo {
             return _sizeStorer.get();
         }
         std::auto_ptr<KVSizeStorer> sizeStorer(new KVSizeStorer(getMetadataDictionary(), newRecoveryUnit()));
-        sizeStorer->loadFromDict(opCtx);
+        {
+            // Loading may write (to consume the clean shutdown marker), which the caller's
+            // operation may not be allowed to do, so use our own.
+            OperationContextNoop loadOpCtx(newRecoveryUnit());
+            sizeStorer->loadFromDict(&loadOpCtx);
+        }
         _sizeStorer.reset(sizeStorer.release());
         return _sizeStorer.get();
     }
@@ -63,6 +76,21 @@ namespace mongo {
                                             StringData ns,
                                             StringData ident,
                                             const CollectionOptions& options ) {
+        if (options.partitioned) {
+            // A partitioned record store is a metadata dictionary holding the partition list, and
+            // a dictionary for each partition, starting with just the first.  There's no
+            // dictionary named `ident' itself.
+            Status s = createKVDictionary(opCtx, KVRecordStorePartitioned::metadataIdent(ident),
+                                          KVDictionary::Encoding(), BSONObj());
+            if (!s.isOK()) {
+                return s;
+            }
+            const KVRecordStorePartitioned::Metadata metadata;
+            return createKVDictionary(opCtx,
+                                      KVRecordStorePartitioned::partitionIdent(ident, metadata.partitions[0].first),
+                                      KVDictionary::Encoding::forRecordStore(), options.storageEngine);
+        }
+
         // Creating a record store is as simple as creating one with the given `ident'
         return createKVDictionary(opCtx, ident, KVDictionary::Encoding::forRecordStore(),
                                   options.storageEngine);
@@ -77,12 +105,32 @@ namespace mongo {
                                                StringData ns,
                                                StringData ident,
                                                const CollectionOptions& options ) {
-        std::auto_ptr<KVDictionary> db(getKVDictionary(opCtx, ident, KVDictionary::Encoding::forRecordStore(),
-                                                  options.storageEngine));
-        std::auto_ptr<KVRecordStore> rs;
         KVSizeStorer *sizeStorer = (persistDictionaryStats()
                                     ? getSizeStorer(opCtx)
                                     : NULL);
+        if (options.partitioned) {
+            std::auto_ptr<KVDictionary> metadataDict(getKVDictionary(opCtx, KVRecordStorePartitioned::metadataIdent(ident),
+                                                                     KVDictionary::Encoding(), BSONObj()));
+            const KVRecordStorePartitioned::Metadata metadata =
+                    KVRecordStorePartitioned::Metadata::load(opCtx, metadataDict.get());
+
+            KVPartitionedDictionary::Partitions partitions;
+            for (size_t i = 0; i < metadata.partitions.size(); ++i) {
+                const int64_t id = metadata.partitions[i].first;
+                boost::shared_ptr<KVDictionary> db(getKVDictionary(opCtx, KVRecordStorePartitioned::partitionIdent(ident, id),
+                                                                   KVDictionary::Encoding::forRecordStore(),
+                                                                   options.storageEngine));
+                partitions.push_back(KVPartitionedDictionary::Partition(id, metadata.partitions[i].second, db));
+            }
+            std::auto_ptr<KVPartitionedDictionary> db(new KVPartitionedDictionary(ident.toString(), KVDictionary::Encoding::forRecordStore(),
+                                                                                  partitions));
+            return new KVRecordStorePartitioned(this, metadataDict.release(), db.release(), metadata,
+                                                opCtx, ns, ident, options, sizeStorer);
+        }
+
+        std::auto_ptr<KVDictionary> db(getKVDictionary(opCtx, ident, KVDictionary::Encoding::forRecordStore(),
+                                                  options.storageEngine));
+        std::auto_ptr<KVRecordStore> rs;
         // We separated the implementations of capped / non-capped record stores for readability.
         if (options.capped) {
             rs.reset(new KVRecordStoreCapped(db.release(), opCtx, ns, ident, options, sizeStorer, supportsDocLocking()));
@@ -94,20 +142,87 @@ namespace mongo {
 
     Status KVEngineImpl::dropIdent( OperationContext* opCtx,
                                     StringData ident ) {
-        return dropKVDictionary(opCtx, ident);
+        if (hasIdent(opCtx, ident)) {
+            return dropKVDictionary(opCtx, ident);
+        }
+
+        // A partitioned record store or index.  Drop every partition, including any that a
+        // dropPartition failed to remove, and then a record store's metadata.
+        const std::string metadataIdent = KVRecordStorePartitioned::metadataIdent(ident);
+        const std::vector<std::string> idents = getAllKVDictionaryIdents(opCtx);
+        for (std::vector<std::string>::const_iterator it = idents.begin(); it != idents.end(); ++it) {
+            if (*it == metadataIdent || KVRecordStorePartitioned::ownerIdent(*it) != ident) {
+                continue;
+            }
+            Status s = dropKVDictionary(opCtx, *it);
+            if (!s.isOK()) {
+                return s;
+            }
+        }
+        if (!hasIdent(opCtx, metadataIdent)) {
+            return Status::OK();
+        }
+        return dropKVDictionary(opCtx, metadataIdent);
+    }
+
+    std::vector<std::string> KVEngineImpl::getAllIdents( OperationContext* opCtx ) const {
+        const std::vector<std::string> dictionaryIdents = getAllKVDictionaryIdents(opCtx);
+        std::set<std::string> seen;
+        std::vector<std::string> idents;
+        for (std::vector<std::string>::const_iterator it = dictionaryIdents.begin();
+             it != dictionaryIdents.end(); ++it) {
+            const std::string ident = KVRecordStorePartitioned::ownerIdent(*it);
+            if (seen.insert(ident).second) {
+                idents.push_back(ident);
+            }
+        }
+        return idents;
     }
 
     // --------
 
+    namespace {
+
+        // The partitioned record store of the collection `desc' is on, or NULL if it isn't
+        // partitioned.
+        const KVRecordStorePartitioned *partitionedRecordStore(const IndexDescriptor* desc) {
+            if (desc == NULL || desc->getCollection() == NULL) {
+                return NULL;
+            }
+            const RecordStore *rs = desc->getCollection()->getRecordStore();
+            if (rs == NULL || !rs->isPartitioned()) {
+                return NULL;
+            }
+            return dynamic_cast<const KVRecordStorePartitioned *>(rs);
+        }
+
+    }
+
     Status KVEngineImpl::createSortedDataInterface(OperationContext* opCtx,
                                                    StringData ident,
                                                    const IndexDescriptor* desc) {
-        // Creating a sorted data impl is as simple as creating one with the given `ident'
         const BSONObj keyPattern = desc ? desc->keyPattern() : BSONObj();
         const BSONObj options = desc ? desc->infoObj().getObjectField("storageEngine") : BSONObj();
-        return createKVDictionary(opCtx, ident, KVDictionary::Encoding::forIndex(Ordering::make(keyPattern)),
-                                  options);
+        const KVDictionary::Encoding enc = KVDictionary::Encoding::forIndex(Ordering::make(keyPattern));
 
+        // An index on a partitioned collection gets a dictionary for each of its partitions, so
+        // dropping one doesn't have to touch the index's other entries.
+        const KVRecordStorePartitioned *rs = partitionedRecordStore(desc);
+        if (rs != NULL) {
+            const KVPartitionedDictionary::Partitions &partitions = rs->partitions();
+            for (KVPartitionedDictionary::Partitions::const_iterator it = partitions.begin();
+                 it != partitions.end(); ++it) {
+                Status s = createKVDictionary(opCtx, KVRecordStorePartitioned::partitionIdent(ident, it->id()),
+                                              enc, options);
+                if (!s.isOK()) {
+                    return s;
+                }
+            }
+            return Status::OK();
+        }
+
+        // Creating a sorted data impl is as simple as creating one with the given `ident'
+        return createKVDictionary(opCtx, ident, enc, options);
     }
 
     SortedDataInterface* KVEngineImpl::getSortedDataInterface(OperationContext* opCtx,
@@ -115,9 +230,29 @@ namespace mongo {
                                                               const IndexDescriptor* desc) {
         const BSONObj keyPattern = desc ? desc->keyPattern() : BSONObj();
         const BSONObj options = desc ? desc->infoObj().getObjectField("storageEngine") : BSONObj();
-        std::auto_ptr<KVDictionary> db(getKVDictionary(opCtx, ident, KVDictionary::Encoding::forIndex(Ordering::make(keyPattern)),
-                                                  options));
-        return new KVSortedDataImpl(db.release(), opCtx, desc);
+        const KVDictionary::Encoding enc = KVDictionary::Encoding::forIndex(Ordering::make(keyPattern));
+        KVSizeStorer *sizeStorer = (persistDictionaryStats()
+                                    ? getSizeStorer(opCtx)
+                                    : NULL);
+
+        // Indexes built on a partitioned collection before indexes could be partitioned are
+        // still a single dictionary.
+        const KVRecordStorePartitioned *rs = partitionedRecordStore(desc);
+        if (rs != NULL && !hasIdent(opCtx, ident)) {
+            const KVPartitionedDictionary::Partitions &rsPartitions = rs->partitions();
+            KVPartitionedDictionary::Partitions partitions;
+            for (KVPartitionedDictionary::Partitions::const_iterator it = rsPartitions.begin();
+                 it != rsPartitions.end(); ++it) {
+                boost::shared_ptr<KVDictionary> db(getKVDictionary(opCtx, KVRecordStorePartitioned::partitionIdent(ident, it->id()),
+                                                                   enc, options));
+                partitions.push_back(KVPartitionedDictionary::Partition(it->id(), it->max(), db));
+            }
+            std::auto_ptr<KVPartitionedDictionary> db(new KVPartitionedDictionary(ident.toString(), enc, partitions));
+            return new KVSortedDataPartitioned(this, db.release(), enc, options, opCtx, desc, ident, sizeStorer);
+        }
+
+        std::auto_ptr<KVDictionary> db(getKVDictionary(opCtx, ident, enc, options));
+        return new KVSortedDataImpl(db.release(), opCtx, desc, ident, sizeStorer);
     }
 
     Status KVEngineImpl::okToRename( OperationContext* opCtx,
@@ -138,6 +273,7 @@ namespace mongo {
         if (_sizeStorer) {
             OperationContextNoop opCtx(newRecoveryUnit());
             _sizeStorer->storeIntoDict(&opCtx);
+            _sizeStorer->markCleanShutdown(&opCtx);
             _sizeStorer.reset();
         }
         cleanShutdownImpl();
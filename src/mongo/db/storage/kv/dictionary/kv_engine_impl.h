@@ -91,6 +91,12 @@ namespace mongo {
         Status dropIdent( OperationContext* opCtx,
                           StringData ident );
 
+        /**
+         * Reports the idents of record stores and indexes, not of the dictionaries underneath
+         * them (a partitioned record store has several).
+         */
+        std::vector<std::string> getAllIdents( OperationContext* opCtx ) const;
+
         Status okToRename( OperationContext* opCtx,
                            StringData fromNS,
                            StringData toNS,
@@ -100,6 +106,11 @@ namespace mongo {
         void cleanShutdown();
 
     protected:
+        // Partitioned record stores and indexes create and drop their partitions' dictionaries
+        // themselves.
+        friend class KVRecordStorePartitioned;
+        friend class KVSortedDataPartitioned;
+
         // Create a KVDictionary (same rules as createRecordStore / createSortedDataInterface)
         // 
         // param: enc, the encoding that should be passed to the KVDictionary
@@ -121,6 +132,9 @@ namespace mongo {
         virtual Status dropKVDictionary(OperationContext* opCtx,
                                         StringData ident) = 0;
 
+        // Get the ident of every KVDictionary that exists
+        virtual std::vector<std::string> getAllKVDictionaryIdents(OperationContext* opCtx) const = 0;
+
         /**
          * If true, a record store built with this engine will store its stats (numRecords and
          * dataSize) in a separate metadata dictionary.
@@ -0,0 +1,313 @@
+// kv_lazy_dictionary.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/storage/kv/dictionary/kv_lazy_dictionary.h"
+#include "mongo/db/storage/kv/slice.h"
+
+namespace mongo {
+
+    KVDictionaryHandleCache::KVDictionaryHandleCache(size_t maxOpen)
+        : _maxOpen(maxOpen),
+          _numOpen(0),
+          _numOpens(0),
+          _numCloses(0)
+    {}
+
+    KVDictionaryHandleCache::~KVDictionaryHandleCache() {
+        // Every KVLazyDictionary must be gone by now, they point back at us.
+        invariant(_lru.empty());
+    }
+
+    size_t KVDictionaryHandleCache::maxOpen() const {
+        boost::mutex::scoped_lock lk(_mutex);
+        return _maxOpen;
+    }
+
+    void KVDictionaryHandleCache::setMaxOpen(size_t maxOpen) {
+        std::vector<boost::shared_ptr<KVDictionary> > closed;
+        boost::mutex::scoped_lock lk(_mutex);
+        _maxOpen = maxOpen;
+        _evictLocked(closed);
+        lk.unlock();
+    }
+
+    size_t KVDictionaryHandleCache::numOpen() const {
+        boost::mutex::scoped_lock lk(_mutex);
+        return _numOpen;
+    }
+
+    void KVDictionaryHandleCache::appendStats(BSONObjBuilder &b) const {
+        boost::mutex::scoped_lock lk(_mutex);
+        b.appendNumber("open", static_cast<long long>(_numOpen));
+        b.appendNumber("maxOpen", static_cast<long long>(_maxOpen));
+        b.appendNumber("opens", _numOpens);
+        b.appendNumber("closes", _numCloses);
+    }
+
+    void KVDictionaryHandleCache::_touchLocked(KVLazyDictionary *dict) {
+        _lru.splice(_lru.begin(), _lru, dict->_lruPos);
+    }
+
+    void KVDictionaryHandleCache::_addLocked(KVLazyDictionary *dict) {
+        dict->_lruPos = _lru.insert(_lru.begin(), dict);
+        _numOpen++;
+        _numOpens++;
+    }
+
+    void KVDictionaryHandleCache::_removeLocked(KVLazyDictionary *dict) {
+        _lru.erase(dict->_lruPos);
+        dict->_lruPos = _lru.end();
+        _numOpen--;
+    }
+
+    void KVDictionaryHandleCache::_evictLocked(std::vector<boost::shared_ptr<KVDictionary> > &closed) {
+        if (_maxOpen == 0) {
+            return;
+        }
+        while (_numOpen > _maxOpen) {
+            KVLazyDictionary *victim = _lru.back();
+            closed.push_back(victim->_db);
+            victim->_db.reset();
+            _removeLocked(victim);
+            _numCloses++;
+        }
+    }
+
+    namespace {
+
+        /**
+         * Keeps the real dictionary open for as long as a cursor on it exists.
+         */
+        class PinnedCursor : public KVDictionary::Cursor {
+            boost::shared_ptr<KVDictionary> _db;
+            boost::scoped_ptr<KVDictionary::Cursor> _cur;
+
+        public:
+            PinnedCursor(const boost::shared_ptr<KVDictionary> &db, KVDictionary::Cursor *cur)
+                : _db(db), _cur(cur)
+            {}
+
+            virtual bool ok() const { return _cur->ok(); }
+
+            virtual void seek(OperationContext *opCtx, const Slice &key) { _cur->seek(opCtx, key); }
+
+            virtual void advance(OperationContext *opCtx) { _cur->advance(opCtx); }
+
+            virtual Slice currKey() const { return _cur->currKey(); }
+
+            virtual Slice currVal() const { return _cur->currVal(); }
+
+            virtual void detach() { _cur->detach(); }
+
+            virtual bool reattach(OperationContext *opCtx) { return _cur->reattach(opCtx); }
+        };
+
+        /**
+         * Keeps the real dictionary open until a bulk load into it is done.
+         */
+        class PinnedBuilder : public KVDictionaryBuilder {
+            boost::shared_ptr<KVDictionary> _db;
+            boost::scoped_ptr<KVDictionaryBuilder> _builder;
+
+        public:
+            PinnedBuilder(const boost::shared_ptr<KVDictionary> &db, KVDictionaryBuilder *builder)
+                : _db(db), _builder(builder)
+            {}
+
+            virtual Status insert(const Slice &key, const Slice &value) {
+                return _builder->insert(key, value);
+            }
+
+            virtual Status commit(bool mayInterrupt) {
+                return _builder->commit(mayInterrupt);
+            }
+        };
+
+    }
+
+    KVLazyDictionary::KVLazyDictionary(KVDictionaryHandleCache &cache, const std::string &name, Opener *opener)
+        : _cache(cache),
+          _name(name),
+          _opener(opener)
+    {
+        invariant(_opener);
+    }
+
+    KVLazyDictionary::~KVLazyDictionary() {
+        boost::shared_ptr<KVDictionary> db;
+        boost::mutex::scoped_lock lk(_cache._mutex);
+        if (_db) {
+            db.swap(_db);
+            _cache._removeLocked(this);
+            _cache._numCloses++;
+        }
+        // Close it after unlocking, which may take a while.
+        lk.unlock();
+    }
+
+    bool KVLazyDictionary::isOpen() const {
+        boost::mutex::scoped_lock lk(_cache._mutex);
+        return _db.get() != NULL;
+    }
+
+    boost::shared_ptr<KVDictionary> KVLazyDictionary::_pin(OperationContext *opCtx) const {
+        KVLazyDictionary *self = const_cast<KVLazyDictionary *>(this);
+        {
+            boost::mutex::scoped_lock lk(_cache._mutex);
+            if (_db) {
+                _cache._touchLocked(self);
+                return _db;
+            }
+        }
+
+        boost::mutex::scoped_lock openLk(_openMutex);
+        {
+            // Someone else may have opened it while we waited.
+            boost::mutex::scoped_lock lk(_cache._mutex);
+            if (_db) {
+                _cache._touchLocked(self);
+                return _db;
+            }
+        }
+
+        boost::shared_ptr<KVDictionary> db(_opener->open(opCtx));
+        invariant(db);
+
+        std::vector<boost::shared_ptr<KVDictionary> > closed;
+        {
+            boost::mutex::scoped_lock lk(_cache._mutex);
+            _db = db;
+            _cache._addLocked(self);
+            // We're at the front of the LRU list, so this never closes us.
+            _cache._evictLocked(closed);
+        }
+        return db;
+    }
+
+    Status KVLazyDictionary::get(OperationContext *opCtx, const Slice &key, Slice &value, bool skipPessimisticLocking) const {
+        return _pin(opCtx)->get(opCtx, key, value, skipPessimisticLocking);
+    }
+
+    Status KVLazyDictionary::getMany(OperationContext *opCtx, const std::vector<Slice> &keys, GetManyCallback &cb) const {
+        return _pin(opCtx)->getMany(opCtx, keys, cb);
+    }
+
+    Status KVLazyDictionary::insert(OperationContext *opCtx, const Slice &key, const Slice &value, bool skipPessimisticLocking) {
+        return _pin(opCtx)->insert(opCtx, key, value, skipPessimisticLocking);
+    }
+
+    Status KVLazyDictionary::remove(OperationContext *opCtx, const Slice &key) {
+        return _pin(opCtx)->remove(opCtx, key);
+    }
+
+    Status KVLazyDictionary::removeRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                         int64_t *numRemoved, int64_t *sizeRemoved) {
+        return _pin(opCtx)->removeRange(opCtx, left, right, numRemoved, sizeRemoved);
+    }
+
+    KVDictionaryBuilder *KVLazyDictionary::getBuilder(OperationContext *opCtx) {
+        boost::shared_ptr<KVDictionary> db = _pin(opCtx);
+        return new PinnedBuilder(db, db->getBuilder(opCtx));
+    }
+
+    bool KVLazyDictionary::updateSupported() const {
+        return _pin(NULL)->updateSupported();
+    }
+
+    Status KVLazyDictionary::update(OperationContext *opCtx, const Slice &key, const Slice &oldValue,
+                                    const KVUpdateMessage &message) {
+        return _pin(opCtx)->update(opCtx, key, oldValue, message);
+    }
+
+    Status KVLazyDictionary::update(OperationContext *opCtx, const Slice &key, const KVUpdateMessage &message) {
+        return _pin(opCtx)->update(opCtx, key, message);
+    }
+
+    void KVLazyDictionary::justDeletedCappedRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                                  int64_t sizeSaved, int64_t docsRemoved) {
+        _pin(opCtx)->justDeletedCappedRange(opCtx, left, right, sizeSaved, docsRemoved);
+    }
+
+    Status KVLazyDictionary::dupKeyCheck(OperationContext *opCtx, const Slice &lookupLeft, const Slice &lookupRight, const RecordId &id) {
+        return _pin(opCtx)->dupKeyCheck(opCtx, lookupLeft, lookupRight, id);
+    }
+
+    bool KVLazyDictionary::supportsDupKeyCheck() const {
+        return _pin(NULL)->supportsDupKeyCheck();
+    }
+
+    KVDictionary::Stats KVLazyDictionary::getStats() const {
+        Stats stats;
+        if (!isOpen() && _opener->cachedStats(&stats)) {
+            return stats;
+        }
+        return _pin(NULL)->getStats();
+    }
+
+    Status KVLazyDictionary::getSplitKeys(OperationContext *opCtx, size_t numRanges, std::vector<Slice> &splitKeys) const {
+        return _pin(opCtx)->getSplitKeys(opCtx, numRanges, splitKeys);
+    }
+
+    bool KVLazyDictionary::appendCustomStats(OperationContext *opCtx, BSONObjBuilder* result, double scale) const {
+        return _pin(opCtx)->appendCustomStats(opCtx, result, scale);
+    }
+
+    bool KVLazyDictionary::compactSupported() const {
+        return _pin(NULL)->compactSupported();
+    }
+
+    bool KVLazyDictionary::compactsInPlace() const {
+        return _pin(NULL)->compactsInPlace();
+    }
+
+    Status KVLazyDictionary::compact(OperationContext *opCtx) {
+        return _pin(opCtx)->compact(opCtx);
+    }
+
+    KVDictionary::Cursor *KVLazyDictionary::getCursor(OperationContext *opCtx, const Slice &key, const int direction) const {
+        boost::shared_ptr<KVDictionary> db = _pin(opCtx);
+        return new PinnedCursor(db, db->getCursor(opCtx, key, direction));
+    }
+
+    KVDictionary::Cursor *KVLazyDictionary::getCursor(OperationContext *opCtx, const int direction) const {
+        boost::shared_ptr<KVDictionary> db = _pin(opCtx);
+        return new PinnedCursor(db, db->getCursor(opCtx, direction));
+    }
+
+    KVDictionary::Cursor *KVLazyDictionary::getRangeCursor(OperationContext *opCtx, const Slice &key,
+                                                           const Slice &endKey, bool endKeyInclusive,
+                                                           const int direction) const {
+        boost::shared_ptr<KVDictionary> db = _pin(opCtx);
+        return new PinnedCursor(db, db->getRangeCursor(opCtx, key, endKey, endKeyInclusive, direction));
+    }
+
+} // namespace mongo
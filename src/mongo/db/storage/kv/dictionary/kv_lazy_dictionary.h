@@ -0,0 +1,212 @@
+// kv_lazy_dictionary.h
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <list>
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+    class KVLazyDictionary;
+
+    /**
+     * Keeps at most a fixed number of KVLazyDictionaries open, closing the least recently used one
+     * when another needs to be opened.
+     *
+     * A dictionary that is closed while an operation, cursor, or builder is still using it stays
+     * open until they are done, so the budget can be exceeded briefly, but nothing ever has its
+     * handle closed underneath it.
+     */
+    class KVDictionaryHandleCache {
+        MONGO_DISALLOW_COPYING(KVDictionaryHandleCache);
+    public:
+        /**
+         * A `maxOpen' of 0 means there is no limit, dictionaries are still opened lazily.
+         */
+        explicit KVDictionaryHandleCache(size_t maxOpen);
+
+        ~KVDictionaryHandleCache();
+
+        size_t maxOpen() const;
+
+        /**
+         * Closes idle dictionaries until no more than `maxOpen' are open.
+         */
+        void setMaxOpen(size_t maxOpen);
+
+        size_t numOpen() const;
+
+        void appendStats(BSONObjBuilder &b) const;
+
+    private:
+        friend class KVLazyDictionary;
+
+        typedef std::list<KVLazyDictionary *> LRUList;
+
+        // Each of these requires _mutex.
+        void _touchLocked(KVLazyDictionary *dict);
+        void _addLocked(KVLazyDictionary *dict);
+        void _removeLocked(KVLazyDictionary *dict);
+        // Moves the handles of dictionaries over budget into `closed', so the caller can release
+        // them after unlocking.
+        void _evictLocked(std::vector<boost::shared_ptr<KVDictionary> > &closed);
+
+        mutable boost::mutex _mutex;
+        size_t _maxOpen;
+        // Open dictionaries, most recently used first.
+        LRUList _lru;
+        size_t _numOpen;
+        long long _numOpens;
+        long long _numCloses;
+    };
+
+    /**
+     * A KVDictionary that doesn't open the real one until something uses it, and lets a
+     * KVDictionaryHandleCache close it again when it has been idle for a while.
+     *
+     * This is for deployments with so many collections and indexes that opening all of them at
+     * startup, and keeping them open forever, is too expensive.  Every call pins the real
+     * dictionary for its duration, cursors and builders pin it for their lifetime.
+     */
+    class KVLazyDictionary : public KVDictionary {
+        MONGO_DISALLOW_COPYING(KVLazyDictionary);
+    public:
+        /**
+         * Knows how to open the real dictionary.
+         */
+        class Opener {
+        public:
+            virtual ~Opener() { }
+
+            /**
+             * Return: a newly opened dictionary (ownership passes to caller)
+             * Note: `opCtx' is NULL when the dictionary is opened for a call that doesn't have
+             *       one, like getStats().
+             */
+            virtual KVDictionary *open(OperationContext *opCtx) const = 0;
+
+            /**
+             * Return: true if the implementation remembers stats for the closed dictionary, in
+             *         `stats', so getStats() doesn't have to open it.
+             */
+            virtual bool cachedStats(Stats *stats) const { return false; }
+        };
+
+        /**
+         * Takes ownership of `opener'.  `cache' must outlive this dictionary.
+         */
+        KVLazyDictionary(KVDictionaryHandleCache &cache, const std::string &name, Opener *opener);
+
+        virtual ~KVLazyDictionary();
+
+        /**
+         * True if the real dictionary is open right now, mostly for tests.
+         */
+        bool isOpen() const;
+
+        virtual Status get(OperationContext *opCtx, const Slice &key, Slice &value, bool skipPessimisticLocking=false) const;
+
+        virtual Status getMany(OperationContext *opCtx, const std::vector<Slice> &keys, GetManyCallback &cb) const;
+
+        virtual Status insert(OperationContext *opCtx, const Slice &key, const Slice &value, bool skipPessimisticLocking);
+
+        virtual Status remove(OperationContext *opCtx, const Slice &key);
+
+        virtual Status removeRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                   int64_t *numRemoved, int64_t *sizeRemoved);
+
+        virtual KVDictionaryBuilder *getBuilder(OperationContext *opCtx);
+
+        virtual bool updateSupported() const;
+
+        virtual Status update(OperationContext *opCtx, const Slice &key, const Slice &oldValue,
+                              const KVUpdateMessage &message);
+
+        virtual Status update(OperationContext *opCtx, const Slice &key, const KVUpdateMessage &message);
+
+        virtual void justDeletedCappedRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                            int64_t sizeSaved, int64_t docsRemoved);
+
+        virtual const char *name() const { return _name.c_str(); }
+
+        virtual Status dupKeyCheck(OperationContext *opCtx, const Slice &lookupLeft, const Slice &lookupRight, const RecordId &id);
+
+        virtual bool supportsDupKeyCheck() const;
+
+        virtual Stats getStats() const;
+
+        virtual Status getSplitKeys(OperationContext *opCtx, size_t numRanges, std::vector<Slice> &splitKeys) const;
+
+        virtual bool appendCustomStats(OperationContext *opCtx, BSONObjBuilder* result, double scale) const;
+
+        virtual bool compactSupported() const;
+
+        virtual bool compactsInPlace() const;
+
+        virtual Status compact(OperationContext *opCtx);
+
+        virtual KVDictionary::Cursor *getCursor(OperationContext *opCtx, const Slice &key, const int direction = 1) const;
+
+        virtual KVDictionary::Cursor *getCursor(OperationContext *opCtx, const int direction = 1) const;
+
+        virtual KVDictionary::Cursor *getRangeCursor(OperationContext *opCtx, const Slice &key,
+                                                     const Slice &endKey, bool endKeyInclusive,
+                                                     const int direction = 1) const;
+
+    private:
+        friend class KVDictionaryHandleCache;
+
+        // Returns the real dictionary, opening it first if it's closed.
+        boost::shared_ptr<KVDictionary> _pin(OperationContext *opCtx) const;
+
+        KVDictionaryHandleCache &_cache;
+        const std::string _name;
+        boost::scoped_ptr<Opener> _opener;
+
+        // Serializes opening, so two threads don't both open the real dictionary.
+        mutable boost::mutex _openMutex;
+
+        // Guarded by the cache's mutex.
+        mutable boost::shared_ptr<KVDictionary> _db;
+        mutable KVDictionaryHandleCache::LRUList::iterator _lruPos;
+    };
+
+} // namespace mongo
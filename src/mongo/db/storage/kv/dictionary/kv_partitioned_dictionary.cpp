@@ -0,0 +1,452 @@
+// kv_partitioned_dictionary.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#include <algorithm>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/storage/key_string.h"
+#include "mongo/db/storage/kv/dictionary/kv_partitioned_dictionary.h"
+#include "mongo/db/storage/kv/slice.h"
+
+namespace mongo {
+
+    KVPartitionedDictionary::Partition::Partition(int64_t id, const RecordId &max,
+                                                  const boost::shared_ptr<KVDictionary> &db)
+        : _id(id),
+          _max(max),
+          _maxKey(max.isNull() ? Slice() : Slice::of(KeyString(max)).owned()),
+          _db(db)
+    {
+        invariant(_db);
+    }
+
+    KVPartitionedDictionary::KVPartitionedDictionary(const std::string &name, const Encoding &enc,
+                                                     const Partitions &partitions)
+        : _name(name),
+          _enc(enc),
+          _version(0)
+    {
+        invariant(_enc.isRecordStore() || _enc.isIndex());
+        setPartitions(partitions);
+    }
+
+    void KVPartitionedDictionary::setPartitions(const Partitions &partitions) {
+        invariant(!partitions.empty());
+        for (size_t i = 0; i + 1 < partitions.size(); ++i) {
+            invariant(partitions[i].bounded());
+            invariant(i == 0 || partitions[i - 1].max() < partitions[i].max());
+        }
+        invariant(!partitions.back().bounded());
+
+        _partitions = partitions;
+        _version++;
+    }
+
+    size_t KVPartitionedDictionary::_partitionFor(const Slice &key) const {
+        if (_enc.isIndex()) {
+            return _partitionForId(_enc.extractRecordId(key));
+        }
+
+        // Binary search for the first partition whose max is >= key.  The last partition is
+        // unbounded, so it's never compared.
+        size_t lo = 0;
+        size_t hi = _partitions.size() - 1;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (Encoding::cmp(_partitions[mid].maxKey(), key) < 0) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    size_t KVPartitionedDictionary::_partitionForId(const RecordId &id) const {
+        size_t lo = 0;
+        size_t hi = _partitions.size() - 1;
+        while (lo < hi) {
+            const size_t mid = lo + (hi - lo) / 2;
+            if (_partitions[mid].max() < id) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        return lo;
+    }
+
+    Status KVPartitionedDictionary::get(OperationContext *opCtx, const Slice &key, Slice &value, bool skipPessimisticLocking) const {
+        return _partitions[_partitionFor(key)].db()->get(opCtx, key, value, skipPessimisticLocking);
+    }
+
+    Status KVPartitionedDictionary::getMany(OperationContext *opCtx, const std::vector<Slice> &keys, GetManyCallback &cb) const {
+        if (_enc.isIndex()) {
+            // An index's keys don't come in runs by partition, and the callback wants them in
+            // order.
+            return KVDictionary::getMany(opCtx, keys, cb);
+        }
+
+        // Keys are sorted, so each partition's keys are a contiguous run.
+        std::vector<Slice>::const_iterator begin = keys.begin();
+        while (begin != keys.end()) {
+            const size_t idx = _partitionFor(*begin);
+            std::vector<Slice>::const_iterator end = begin + 1;
+            while (end != keys.end() && _partitionFor(*end) == idx) {
+                ++end;
+            }
+
+            const std::vector<Slice> run(begin, end);
+            Status s = _partitions[idx].db()->getMany(opCtx, run, cb);
+            if (!s.isOK()) {
+                return s;
+            }
+            begin = end;
+        }
+        return Status::OK();
+    }
+
+    Status KVPartitionedDictionary::insert(OperationContext *opCtx, const Slice &key, const Slice &value, bool skipPessimisticLocking) {
+        return _partitions[_partitionFor(key)].db()->insert(opCtx, key, value, skipPessimisticLocking);
+    }
+
+    Status KVPartitionedDictionary::remove(OperationContext *opCtx, const Slice &key) {
+        return _partitions[_partitionFor(key)].db()->remove(opCtx, key);
+    }
+
+    Status KVPartitionedDictionary::removeRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                                int64_t *numRemoved, int64_t *sizeRemoved) {
+        int64_t n = 0;
+        int64_t size = 0;
+        // Each partition only holds keys in its own range, so they can all be given the whole
+        // range.  Any of an index's partitions may hold keys in it.
+        const size_t first = _enc.isIndex() ? 0 : _partitionFor(left);
+        const size_t last = _enc.isIndex() ? _partitions.size() - 1 : _partitionFor(right);
+        for (size_t i = first; i <= last; ++i) {
+            int64_t partitionRemoved = 0;
+            int64_t partitionSize = 0;
+            Status s = _partitions[i].db()->removeRange(opCtx, left, right, &partitionRemoved, &partitionSize);
+            if (!s.isOK()) {
+                return s;
+            }
+            n += partitionRemoved;
+            size += partitionSize;
+        }
+
+        if (numRemoved != NULL) {
+            *numRemoved = n;
+        }
+        if (sizeRemoved != NULL) {
+            *sizeRemoved = size;
+        }
+        return Status::OK();
+    }
+
+    bool KVPartitionedDictionary::updateSupported() const {
+        // Partitions are all created the same way.
+        return _partitions.back().db()->updateSupported();
+    }
+
+    Status KVPartitionedDictionary::update(OperationContext *opCtx, const Slice &key, const Slice &oldValue,
+                                           const KVUpdateMessage &message) {
+        return _partitions[_partitionFor(key)].db()->update(opCtx, key, oldValue, message);
+    }
+
+    Status KVPartitionedDictionary::update(OperationContext *opCtx, const Slice &key, const KVUpdateMessage &message) {
+        return _partitions[_partitionFor(key)].db()->update(opCtx, key, message);
+    }
+
+    KVDictionary::Stats KVPartitionedDictionary::getStats() const {
+        Stats stats;
+        for (Partitions::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+            const Stats partitionStats = it->db()->getStats();
+            stats.dataSize += partitionStats.dataSize;
+            stats.storageSize += partitionStats.storageSize;
+            stats.numKeys += partitionStats.numKeys;
+        }
+        return stats;
+    }
+
+    Status KVPartitionedDictionary::getSplitKeys(OperationContext *opCtx, size_t numRanges, std::vector<Slice> &splitKeys) const {
+        if (_enc.isIndex()) {
+            size_t biggest = 0;
+            int64_t biggestSize = -1;
+            for (size_t i = 0; i < _partitions.size(); ++i) {
+                const int64_t size = _partitions[i].db()->getStats().dataSize;
+                if (size > biggestSize) {
+                    biggest = i;
+                    biggestSize = size;
+                }
+            }
+            return _partitions[biggest].db()->getSplitKeys(opCtx, numRanges, splitKeys);
+        }
+
+        const size_t n = _partitions.size();
+        numRanges = std::min(numRanges, n);
+        // Split before the first key of evenly spaced partitions, which is one past the max of
+        // the partition before it.
+        for (size_t k = 1; k < numRanges; ++k) {
+            const size_t idx = k * n / numRanges;
+            const RecordId start(_partitions[idx - 1].max().repr() + 1);
+            splitKeys.push_back(Slice::of(KeyString(start)).owned());
+        }
+        return Status::OK();
+    }
+
+    bool KVPartitionedDictionary::appendCustomStats(OperationContext *opCtx, BSONObjBuilder* result, double scale) const {
+        BSONArrayBuilder ab(result->subarrayStart("partitions"));
+        for (Partitions::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+            BSONObjBuilder b(ab.subobjStart());
+            b.append("_id", static_cast<long long>(it->id()));
+            if (it->bounded()) {
+                b.append("max", static_cast<long long>(it->max().repr()));
+            }
+            it->db()->appendCustomStats(opCtx, &b, scale);
+            b.doneFast();
+        }
+        ab.doneFast();
+        return true;
+    }
+
+    bool KVPartitionedDictionary::compactSupported() const {
+        return _partitions.back().db()->compactSupported();
+    }
+
+    bool KVPartitionedDictionary::compactsInPlace() const {
+        return _partitions.back().db()->compactsInPlace();
+    }
+
+    Status KVPartitionedDictionary::compact(OperationContext *opCtx) {
+        for (Partitions::const_iterator it = _partitions.begin(); it != _partitions.end(); ++it) {
+            Status s = it->db()->compact(opCtx);
+            if (!s.isOK()) {
+                return s;
+            }
+        }
+        return Status::OK();
+    }
+
+    KVDictionary::Cursor *KVPartitionedDictionary::getCursor(OperationContext *opCtx, const Slice &key, const int direction) const {
+        if (_enc.isIndex()) {
+            return new MergeCursor(*this, opCtx, key, direction);
+        }
+        return new Cursor(*this, opCtx, key, direction);
+    }
+
+    KVDictionary::Cursor *KVPartitionedDictionary::getCursor(OperationContext *opCtx, const int direction) const {
+        if (_enc.isIndex()) {
+            return new MergeCursor(*this, opCtx, direction);
+        }
+        return new Cursor(*this, opCtx, direction);
+    }
+
+    KVPartitionedDictionary::Cursor::Cursor(const KVPartitionedDictionary &dict, OperationContext *opCtx,
+                                            const Slice &key, const int direction)
+        : _dict(dict),
+          _direction(direction),
+          _version(dict._version),
+          _idx(0)
+    {
+        seek(opCtx, key);
+    }
+
+    KVPartitionedDictionary::Cursor::Cursor(const KVPartitionedDictionary &dict, OperationContext *opCtx,
+                                            const int direction)
+        : _dict(dict),
+          _direction(direction),
+          _version(dict._version),
+          _idx(direction > 0 ? 0 : dict._partitions.size() - 1)
+    {
+        _open(opCtx, _idx);
+        _skipExhausted(opCtx);
+    }
+
+    void KVPartitionedDictionary::Cursor::_open(OperationContext *opCtx, size_t idx) {
+        _idx = idx;
+        _cur.reset();
+        _db = _dict._partitions[idx].db();
+        _cur.reset(_db->getCursor(opCtx, _direction));
+    }
+
+    void KVPartitionedDictionary::Cursor::_open(OperationContext *opCtx, size_t idx, const Slice &key) {
+        _idx = idx;
+        _cur.reset();
+        _db = _dict._partitions[idx].db();
+        _cur.reset(_db->getCursor(opCtx, key, _direction));
+    }
+
+    void KVPartitionedDictionary::Cursor::_skipExhausted(OperationContext *opCtx) {
+        while (!_cur->ok()) {
+            if (_direction > 0 ? _idx + 1 >= _dict._partitions.size() : _idx == 0) {
+                return;
+            }
+            _open(opCtx, _direction > 0 ? _idx + 1 : _idx - 1);
+        }
+    }
+
+    bool KVPartitionedDictionary::Cursor::ok() const {
+        return _cur && _cur->ok();
+    }
+
+    void KVPartitionedDictionary::Cursor::seek(OperationContext *opCtx, const Slice &key) {
+        _version = _dict._version;
+        _open(opCtx, _dict._partitionFor(key), key);
+        _skipExhausted(opCtx);
+    }
+
+    void KVPartitionedDictionary::Cursor::advance(OperationContext *opCtx) {
+        invariant(ok());
+        _cur->advance(opCtx);
+        _skipExhausted(opCtx);
+    }
+
+    Slice KVPartitionedDictionary::Cursor::currKey() const {
+        invariant(ok());
+        return _cur->currKey();
+    }
+
+    Slice KVPartitionedDictionary::Cursor::currVal() const {
+        invariant(ok());
+        return _cur->currVal();
+    }
+
+    void KVPartitionedDictionary::Cursor::detach() {
+        invariant(ok());
+        _cur->detach();
+    }
+
+    bool KVPartitionedDictionary::Cursor::reattach(OperationContext *opCtx) {
+        if (_version != _dict._version) {
+            // A partition may have been dropped out from under us.
+            return false;
+        }
+        return _cur->reattach(opCtx);
+    }
+
+    KVPartitionedDictionary::MergeCursor::MergeCursor(const KVPartitionedDictionary &dict, OperationContext *opCtx,
+                                                      const Slice &key, const int direction)
+        : _dict(dict),
+          _direction(direction),
+          _version(dict._version),
+          _curr(0)
+    {
+        seek(opCtx, key);
+    }
+
+    KVPartitionedDictionary::MergeCursor::MergeCursor(const KVPartitionedDictionary &dict, OperationContext *opCtx,
+                                                      const int direction)
+        : _dict(dict),
+          _direction(direction),
+          _version(dict._version),
+          _curr(0)
+    {
+        _open(opCtx, NULL);
+    }
+
+    void KVPartitionedDictionary::MergeCursor::_open(OperationContext *opCtx, const Slice *key) {
+        _version = _dict._version;
+        _curs.clear();
+        _dbs.clear();
+        for (Partitions::const_iterator it = _dict._partitions.begin(); it != _dict._partitions.end(); ++it) {
+            _dbs.push_back(it->db());
+            _curs.push_back(boost::shared_ptr<KVDictionary::Cursor>(
+                    key == NULL ? it->db()->getCursor(opCtx, _direction) : it->db()->getCursor(opCtx, *key, _direction)));
+        }
+        _pick();
+    }
+
+    void KVPartitionedDictionary::MergeCursor::_pick() {
+        _curr = _curs.size();
+        for (size_t i = 0; i < _curs.size(); ++i) {
+            if (!_curs[i]) {
+                continue;
+            }
+            if (!_curs[i]->ok()) {
+                // Close exhausted cursors, so detach() and reattach() only deal with ones that
+                // have a position.
+                _curs[i].reset();
+                continue;
+            }
+            if (_curr == _curs.size() ||
+                Encoding::cmp(_curs[i]->currKey(), _curs[_curr]->currKey()) * _direction < 0) {
+                _curr = i;
+            }
+        }
+    }
+
+    bool KVPartitionedDictionary::MergeCursor::ok() const {
+        return _curr < _curs.size();
+    }
+
+    void KVPartitionedDictionary::MergeCursor::seek(OperationContext *opCtx, const Slice &key) {
+        _open(opCtx, &key);
+    }
+
+    void KVPartitionedDictionary::MergeCursor::advance(OperationContext *opCtx) {
+        invariant(ok());
+        _curs[_curr]->advance(opCtx);
+        _pick();
+    }
+
+    Slice KVPartitionedDictionary::MergeCursor::currKey() const {
+        invariant(ok());
+        return _curs[_curr]->currKey();
+    }
+
+    Slice KVPartitionedDictionary::MergeCursor::currVal() const {
+        invariant(ok());
+        return _curs[_curr]->currVal();
+    }
+
+    void KVPartitionedDictionary::MergeCursor::detach() {
+        invariant(ok());
+        for (size_t i = 0; i < _curs.size(); ++i) {
+            if (_curs[i]) {
+                _curs[i]->detach();
+            }
+        }
+    }
+
+    bool KVPartitionedDictionary::MergeCursor::reattach(OperationContext *opCtx) {
+        if (_version != _dict._version) {
+            return false;
+        }
+        for (size_t i = 0; i < _curs.size(); ++i) {
+            if (_curs[i] && !_curs[i]->reattach(opCtx)) {
+                return false;
+            }
+        }
+        // Cursors whose key was removed while detached may have moved on.
+        _pick();
+        return true;
+    }
+
+} // namespace mongo
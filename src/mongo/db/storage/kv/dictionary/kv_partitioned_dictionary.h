@@ -0,0 +1,240 @@
+// kv_partitioned_dictionary.h
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "mongo/db/record_id.h"
+#include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
+
+namespace mongo {
+
+    /**
+     * A KVDictionary for a record store or an index, split by RecordId into a sequence of
+     * partitions, each of which is its own KVDictionary.
+     *
+     * Every partition but the last holds the RecordIds up to and including its max, the last one
+     * holds everything after that.  Dropping a partition is just dropping its dictionary, which is
+     * what makes this useful for aging out old data.
+     *
+     * A record store's keys are RecordIds, so each partition holds a contiguous range of keys.
+     * An index's keys end in their RecordId, so every partition may hold keys anywhere in the key
+     * space, and cursors have to merge the partitions.
+     *
+     * The partition list is only changed with the collection locked exclusively, but cursors may
+     * be detached across such a change, so reattach() fails if the list changed since.
+     */
+    class KVPartitionedDictionary : public KVDictionary {
+    public:
+        class Partition {
+        public:
+            /**
+             * A null `max' means the partition is unbounded, which only the last one may be.
+             */
+            Partition(int64_t id, const RecordId &max, const boost::shared_ptr<KVDictionary> &db);
+
+            int64_t id() const { return _id; }
+
+            const RecordId &max() const { return _max; }
+
+            bool bounded() const { return !_max.isNull(); }
+
+            // Owned KeyString of max(), empty if unbounded.
+            const Slice &maxKey() const { return _maxKey; }
+
+            const boost::shared_ptr<KVDictionary> &db() const { return _db; }
+
+        private:
+            int64_t _id;
+            RecordId _max;
+            Slice _maxKey;
+            boost::shared_ptr<KVDictionary> _db;
+        };
+
+        typedef std::vector<Partition> Partitions;
+
+        /**
+         * Requires: `partitions' is not empty, is sorted by max, and only the last is unbounded.
+         *           `enc' is either a record store's or an index's, like each partition's.
+         */
+        KVPartitionedDictionary(const std::string &name, const Encoding &enc, const Partitions &partitions);
+
+        virtual ~KVPartitionedDictionary() { }
+
+        const Partitions &partitions() const { return _partitions; }
+
+        /**
+         * Replace the partition list, which invalidates any detached cursors.  Same requirements
+         * as the constructor.
+         */
+        void setPartitions(const Partitions &partitions);
+
+        virtual Status get(OperationContext *opCtx, const Slice &key, Slice &value, bool skipPessimisticLocking=false) const;
+
+        virtual Status getMany(OperationContext *opCtx, const std::vector<Slice> &keys, GetManyCallback &cb) const;
+
+        virtual Status insert(OperationContext *opCtx, const Slice &key, const Slice &value, bool skipPessimisticLocking);
+
+        virtual Status remove(OperationContext *opCtx, const Slice &key);
+
+        virtual Status removeRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                   int64_t *numRemoved, int64_t *sizeRemoved);
+
+        virtual bool updateSupported() const;
+
+        virtual Status update(OperationContext *opCtx, const Slice &key, const Slice &oldValue,
+                              const KVUpdateMessage &message);
+
+        virtual Status update(OperationContext *opCtx, const Slice &key, const KVUpdateMessage &message);
+
+        virtual const char *name() const { return _name.c_str(); }
+
+        virtual Stats getStats() const;
+
+        /**
+         * A record store splits on partition boundaries, which are cheap to scan up to and don't
+         * need any estimation.  An index's partitions each span the whole key space, so it uses
+         * the split keys of its biggest partition.
+         */
+        virtual Status getSplitKeys(OperationContext *opCtx, size_t numRanges, std::vector<Slice> &splitKeys) const;
+
+        virtual bool appendCustomStats(OperationContext *opCtx, BSONObjBuilder* result, double scale) const;
+
+        virtual bool compactSupported() const;
+
+        virtual bool compactsInPlace() const;
+
+        virtual Status compact(OperationContext *opCtx);
+
+        class Cursor : public KVDictionary::Cursor {
+        public:
+            Cursor(const KVPartitionedDictionary &dict, OperationContext *opCtx, const Slice &key, const int direction);
+
+            Cursor(const KVPartitionedDictionary &dict, OperationContext *opCtx, const int direction);
+
+            virtual bool ok() const;
+
+            virtual void seek(OperationContext *opCtx, const Slice &key);
+
+            virtual void advance(OperationContext *opCtx);
+
+            virtual Slice currKey() const;
+
+            virtual Slice currVal() const;
+
+            virtual void detach();
+
+            virtual bool reattach(OperationContext *opCtx);
+
+        private:
+            // Open a cursor on partition `idx', at its start in our direction, or at `key'.
+            void _open(OperationContext *opCtx, size_t idx);
+            void _open(OperationContext *opCtx, size_t idx, const Slice &key);
+
+            // Move to the next non-empty partition in our direction while the current one is
+            // exhausted.
+            void _skipExhausted(OperationContext *opCtx);
+
+            const KVPartitionedDictionary &_dict;
+            const int _direction;
+            uint64_t _version;
+            size_t _idx;
+            // Keeps the partition we're reading open until the cursor on it is gone.
+            boost::shared_ptr<KVDictionary> _db;
+            boost::scoped_ptr<KVDictionary::Cursor> _cur;
+        };
+
+        /**
+         * A cursor over an index, which keeps a cursor open on every partition and returns the
+         * least (or greatest, in reverse) of their keys.
+         */
+        class MergeCursor : public KVDictionary::Cursor {
+        public:
+            MergeCursor(const KVPartitionedDictionary &dict, OperationContext *opCtx, const Slice &key, const int direction);
+
+            MergeCursor(const KVPartitionedDictionary &dict, OperationContext *opCtx, const int direction);
+
+            virtual bool ok() const;
+
+            virtual void seek(OperationContext *opCtx, const Slice &key);
+
+            virtual void advance(OperationContext *opCtx);
+
+            virtual Slice currKey() const;
+
+            virtual Slice currVal() const;
+
+            virtual void detach();
+
+            virtual bool reattach(OperationContext *opCtx);
+
+        private:
+            // Open a cursor on each partition, at its start in our direction, or at `key' if
+            // it isn't NULL.
+            void _open(OperationContext *opCtx, const Slice *key);
+
+            // Point _curr at the cursor with the next key in our direction.
+            void _pick();
+
+            const KVPartitionedDictionary &_dict;
+            const int _direction;
+            uint64_t _version;
+            // Keep the partitions we're reading open until the cursors on them are gone.
+            std::vector<boost::shared_ptr<KVDictionary> > _dbs;
+            // One per partition, reset once exhausted.
+            std::vector<boost::shared_ptr<KVDictionary::Cursor> > _curs;
+            // Index into _curs of the current cursor, _curs.size() if all are exhausted.
+            size_t _curr;
+        };
+
+        virtual KVDictionary::Cursor *getCursor(OperationContext *opCtx, const Slice &key, const int direction = 1) const;
+
+        virtual KVDictionary::Cursor *getCursor(OperationContext *opCtx, const int direction = 1) const;
+
+    private:
+        // Index of the partition that holds `key'.
+        size_t _partitionFor(const Slice &key) const;
+
+        // Index of the partition that holds `id'.
+        size_t _partitionForId(const RecordId &id) const;
+
+        const std::string _name;
+        const Encoding _enc;
+        Partitions _partitions;
+        uint64_t _version;
+    };
+
+} // namespace mongo
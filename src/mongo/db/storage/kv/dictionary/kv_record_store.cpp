@@ -36,10 +36,12 @@
 #include <boost/scoped_ptr.hpp>
 #include <boost/static_assert.hpp>
 
+#include "mongo/base/owned_pointer_vector.h"
 #include "mongo/db/catalog/collection_options.h"
 #include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/operation_context.h"
 #include "mongo/db/storage/key_string.h"
+#include "mongo/db/storage/kv/dictionary/kv_dictionary_parallel_scan.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary_update.h"
 #include "mongo/db/storage/kv/dictionary/kv_record_store.h"
 #include "mongo/db/storage/kv/dictionary/kv_size_storer.h"
@@ -55,6 +57,23 @@ namespace mongo {
 
         const long long kScanOnCollectionCreateThreshold = 10000;
 
+        // Updates to records at least this big are written as a KVUpdateBSONDiffMessage instead
+        // of a full new image, if the dictionary supports updates and less than
+        // 1/kUpdateDiffMaxChangedFraction of the record changed.
+        const int kUpdateDiffMinSize = 1024;
+        const size_t kUpdateDiffMaxChangedFraction = 4;
+
+        // getManyIterators splits the record store into at most this many ranges, none smaller
+        // than kParallelScanMinRangeSize bytes.
+        const size_t kParallelScanMaxRanges = 16;
+        const long long kParallelScanMinRangeSize = 64 << 20;
+
+        // validate splits the record store into at most this many ranges, none smaller than
+        // kValidateMinRangeSize bytes, and scans up to kValidateMaxThreads of them at once.
+        const size_t kValidateMaxRanges = 64;
+        const long long kValidateMinRangeSize = 16 << 20;
+        const size_t kValidateMaxThreads = 8;
+
     }
 
     KVRecordStore::KVRecordStore( KVDictionary *db,
@@ -70,23 +89,19 @@ namespace mongo {
     {
         invariant(_db != NULL);
 
-        // Get the next id, which is one greater than the greatest stored.
-        boost::scoped_ptr<RecordIterator> iter(getIterator(opCtx, RecordId(), CollectionScanParams::BACKWARD));
-        if (!iter->isEOF()) {
-            const RecordId lastId = iter->curr();
-            invariant(lastId.isNormal());
-            _nextIdNum.store(lastId.repr() + 1);
-        } else {
-            // Need to start at 1 so we are within bounds of RecordId::isNormal()
-            _nextIdNum.store(1);
-        }
+        // The next id is found on the first insert, so that opening a collection doesn't have to
+        // touch its dictionary.  See _loadNextIdNum().
+        _nextIdNum.store(0);
 
         if (_sizeStorer) {
             long long numRecords;
             long long dataSize;
-            _sizeStorer->load(_ident, &numRecords, &dataSize);
+            const bool found = _sizeStorer->load(_ident, &numRecords, &dataSize);
 
-            if (numRecords < kScanOnCollectionCreateThreshold) {
+            // Stats written by a clean shutdown are exact, otherwise small collections are cheap
+            // enough to just recount.
+            if ((!found || !_sizeStorer->loadedAfterCleanShutdown()) &&
+                numRecords < kScanOnCollectionCreateThreshold) {
                 LOG(1) << "Doing scan of collection " << ns << " to refresh numRecords and dataSize";
                 _numRecords.store(0);
                 _dataSize.store(0);
@@ -219,15 +234,81 @@ namespace mongo {
         return true;
     }
 
+    namespace {
+
+        typedef std::pair<RecordId, size_t> RecordIdAndPosition;
+
+        /**
+         * Hands the values found by KVDictionary::getMany() back to every position in the caller's
+         * vector that asked for that RecordId.
+         */
+        class FindRecordsCallback : public KVDictionary::GetManyCallback {
+            const std::vector<RecordIdAndPosition> &_sorted;
+            std::vector<RecordData> &_out;
+            size_t _pos;
+
+        public:
+            FindRecordsCallback(const std::vector<RecordIdAndPosition> &sorted, std::vector<RecordData> &out)
+                : _sorted(sorted), _out(out), _pos(0)
+            {}
+
+            virtual void found(const Slice &key, const Slice &value) {
+                BufReader br(key.data(), key.size());
+                const RecordId id = KeyString::decodeRecordId(&br);
+                while (_pos < _sorted.size() && _sorted[_pos].first < id) {
+                    ++_pos;
+                }
+                for (; _pos < _sorted.size() && _sorted[_pos].first == id; ++_pos) {
+                    Slice owned = value.owned();
+                    _out[_sorted[_pos].second] = RecordData(std::move(owned.ownedBuf()), owned.size());
+                }
+            }
+        };
+
+    }
+
+    void KVRecordStore::findRecords( OperationContext* txn,
+                                     const std::vector<RecordId>& locs,
+                                     std::vector<RecordData>* out ) const {
+        out->clear();
+        out->resize(locs.size());
+
+        std::vector<RecordIdAndPosition> sorted;
+        sorted.reserve(locs.size());
+        for (size_t i = 0; i < locs.size(); ++i) {
+            sorted.push_back(RecordIdAndPosition(locs[i], i));
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        std::vector<Slice> keys;
+        keys.reserve(sorted.size());
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            if (i == 0 || sorted[i - 1].first != sorted[i].first) {
+                keys.push_back(Slice::of(KeyString(sorted[i].first)).owned());
+            }
+        }
+
+        FindRecordsCallback cb(sorted, *out);
+        Status status = _db->getMany(txn, keys, cb);
+        if (!status.isOK()) {
+            log() << "storage engine getMany() failed, operation will fail: " << status.toString();
+            uasserted(28624, status.toString());
+        }
+    }
+
     void KVRecordStore::deleteRecord(OperationContext* txn, const RecordId& id) {
         const KeyString key(id);
         Slice val;
         Status s = _db->get(txn, Slice::of(key), val, false);
         invariantKVOK(s, str::stream() << "KVRecordStore: couldn't find record " << id << " for delete: " << s.toString());
 
-        _updateStats(txn, -1, -val.size());
+        deleteRecord(txn, id, val.size());
+    }
+
+    void KVRecordStore::deleteRecord(OperationContext* txn, const RecordId& id, int oldSize) {
+        _updateStats(txn, -1, -oldSize);
 
-        s = _db->remove(txn, Slice::of(key));
+        Status s = _db->remove(txn, Slice::of(KeyString(id)));
         invariant(s.isOK());
     }
 
@@ -256,7 +337,7 @@ namespace mongo {
                                                      const char* data,
                                                      int len,
                                                      bool enforceQuota) {
-        const RecordId id = _nextId();
+        const RecordId id = _nextId(txn);
         const Slice value(data, len);
 
         const Status status = _insertRecord(txn, id, value);
@@ -284,16 +365,11 @@ namespace mongo {
         const KeyString key(id);
         const Slice value(data, len);
 
-        int64_t numRecordsDelta = 0;
-        int64_t dataSizeDelta = value.size();
-
         Slice val;
         Status status = _db->get(txn, Slice::of(key), val, false);
-        if (status.code() == ErrorCodes::NoSuchKey) {
-            numRecordsDelta += 1;
-        } else if (status.isOK()) {
-            dataSizeDelta -= val.size();
-        } else {
+        if (status.isOK()) {
+            return updateRecord(txn, id, RecordData(val.data(), val.size()), data, len, enforceQuota, notifier);
+        } else if (status.code() != ErrorCodes::NoSuchKey) {
             return StatusWith<RecordId>(status);
         }
 
@@ -303,7 +379,41 @@ namespace mongo {
             return StatusWith<RecordId>(status);
         }
 
-        _updateStats(txn, numRecordsDelta, dataSizeDelta);
+        _updateStats(txn, 1, value.size());
+
+        return StatusWith<RecordId>(id);
+    }
+
+    StatusWith<RecordId> KVRecordStore::updateRecord(OperationContext* txn,
+                                                     const RecordId& id,
+                                                     const RecordData& oldRec,
+                                                     const char* data,
+                                                     int len,
+                                                     bool enforceQuota,
+                                                     UpdateNotifier* notifier) {
+        const KeyString key(id);
+        const Slice oldValue(oldRec.data(), oldRec.size());
+        const Slice value(data, len);
+
+        Status status = Status::OK();
+        bool wroteDiff = false;
+        if (_db->updateSupported() && len >= kUpdateDiffMinSize) {
+            // For big documents, if not much changed, just write the part that did.
+            const KVUpdateBSONDiffMessage message = KVUpdateBSONDiffMessage::diff(oldValue, value);
+            if (message.changedSize() * kUpdateDiffMaxChangedFraction < static_cast<size_t>(len)) {
+                status = _db->update(txn, Slice::of(key), oldValue, message);
+                wroteDiff = true;
+            }
+        }
+        if (!wroteDiff) {
+            // An update with a complete new image (data, len) is implemented as an overwrite insert.
+            status = _db->insert(txn, Slice::of(key), value, false);
+        }
+        if (!status.isOK()) {
+            return StatusWith<RecordId>(status);
+        }
+
+        _updateStats(txn, 0, static_cast<long long>(len) - oldRec.size());
 
         return StatusWith<RecordId>(id);
     }
@@ -345,21 +455,45 @@ namespace mongo {
     }
 
     std::vector<RecordIterator *> KVRecordStore::getManyIterators( OperationContext* txn ) const {
+        const long long size = dataSize(txn);
+        const size_t numRanges = static_cast<size_t>(std::max(1LL, std::min(
+                static_cast<long long>(kParallelScanMaxRanges), size / kParallelScanMinRangeSize)));
+
+        std::vector<Slice> splitKeys;
+        Status s = _db->getSplitKeys(txn, numRanges, splitKeys);
+        if (!s.isOK()) {
+            LOG(1) << "KVRecordStore: couldn't split " << ns() << " for a parallel scan, "
+                   << "using one iterator: " << s;
+            splitKeys.clear();
+        }
+
+        // Each iterator scans from the previous split key up to (but not including) the next.
         std::vector<RecordIterator *> iterators;
-        iterators.push_back(getIterator(txn));
+        RecordId start;
+        for (std::vector<Slice>::const_iterator it = splitKeys.begin(); it != splitKeys.end(); ++it) {
+            BufReader br(it->data(), it->size());
+            const RecordId end = KeyString::decodeRecordId(&br);
+            iterators.push_back(new KVRecordIterator(*this, _db.get(), txn, start,
+                                                     CollectionScanParams::FORWARD, end));
+            start = end;
+        }
+        iterators.push_back(new KVRecordIterator(*this, _db.get(), txn, start,
+                                                 CollectionScanParams::FORWARD));
         return iterators;
     }
 
-    Status KVRecordStore::truncate( OperationContext* txn ) {
-        // This is not a very performant implementation of truncate.
-        //
-        // At the time of this writing, it is only used by 'emptycapped', a test-only command.
-        for (boost::scoped_ptr<RecordIterator> iter(getIterator(txn));
-             !iter->isEOF(); ) {
-            RecordId id = iter->getNext();
-            deleteRecord(txn, id);
-        }
+    void KVRecordStore::_removeRange(OperationContext *txn, const RecordId &left, const RecordId &right) {
+        int64_t numRemoved = 0;
+        int64_t sizeRemoved = 0;
+        Status s = _db->removeRange(txn, Slice::of(KeyString(left)), Slice::of(KeyString(right)),
+                                    &numRemoved, &sizeRemoved);
+        invariantKVOK(s, str::stream() << "KVRecordStore: couldn't remove records in [" << left << ", " << right << "): " << s.toString());
+
+        _updateStats(txn, -numRemoved, -sizeRemoved);
+    }
 
+    Status KVRecordStore::truncate( OperationContext* txn ) {
+        _removeRange(txn, RecordId::min(), RecordId::max());
         return Status::OK();
     }
 
@@ -370,35 +504,86 @@ namespace mongo {
         return _db->compact( txn );
     }
 
+    namespace {
+
+        /**
+         * Validates the records in one range of the record store, see KVRecordStore::validate.
+         */
+        class ValidateRangeVisitor : public KVDictionaryParallelScan::RangeVisitor {
+            const StringData _ns;
+            const bool _full;
+            const bool _scanData;
+            ValidateAdaptor *_adaptor;
+
+        public:
+            long long numRecords;
+            long long dataSize;
+            long long numInvalid;
+
+            ValidateRangeVisitor(StringData ns, bool full, bool scanData, ValidateAdaptor *adaptor)
+                : _ns(ns), _full(full), _scanData(scanData), _adaptor(adaptor),
+                  numRecords(0), dataSize(0), numInvalid(0)
+            {}
+
+            virtual Status visit(const Slice &key, const Slice &value) {
+                numRecords++;
+                if (_scanData && _full) {
+                    BufReader br(key.data(), key.size());
+                    const RecordId id = KeyString::decodeRecordId(&br);
+                    size_t recordSize;
+                    const Status status = _adaptor->validateRecord(id, RecordData(value.data(), value.size()),
+                                                                   &recordSize);
+                    if (!status.isOK()) {
+                        numInvalid++;
+                        log() << "Invalid object detected in " << _ns << ": " << status.reason();
+                    }
+                    dataSize += static_cast<long long>(recordSize);
+                }
+                return Status::OK();
+            }
+        };
+
+    }
+
     Status KVRecordStore::validate( OperationContext* txn,
                                     bool full,
                                     bool scanData,
                                     ValidateAdaptor* adaptor,
                                     ValidateResults* results,
                                     BSONObjBuilder* output ) {
-        bool invalidObject = false;
+        // Big record stores are validated in ranges, several at a time.
+        KVDictionaryParallelScan scan(_db.get());
+        const size_t numRanges = scan.split(txn, static_cast<size_t>(std::max(1LL, std::min(
+                static_cast<long long>(kValidateMaxRanges), dataSize(txn) / kValidateMinRangeSize))));
+
+        OwnedPointerVector<KVDictionaryParallelScan::RangeVisitor> visitors;
+        for (size_t i = 0; i < numRanges; i++) {
+            visitors.mutableVector().push_back(new ValidateRangeVisitor(ns(), full, scanData, adaptor));
+        }
+
+        Status s = scan.run(txn, visitors.vector(), kValidateMaxThreads, "validate: scanning records",
+                            static_cast<unsigned long long>(numRecords(txn)));
+        if (!s.isOK()) {
+            return s;
+        }
+
         long long numRecords = 0;
         long long dataSizeTotal = 0;
-        for (boost::scoped_ptr<RecordIterator> iter( getIterator( txn ) );
-             !iter->isEOF(); ) {
-            numRecords++;
-            if (scanData) {
-                RecordData data = dataFor( txn, iter->curr() );
-                size_t dataSize;
-                if (full) {
-                    const Status status = adaptor->validate( data, &dataSize );
-                    if (!status.isOK()) {
-                        results->valid = false;
-                        if ( invalidObject ) {
-                            results->errors.push_back("invalid object detected (see logs)");
-                        }
-                        invalidObject = true;
-                        log() << "Invalid object detected in " << _ns << ": " << status.reason();
-                    }
-                    dataSizeTotal += static_cast<long long>(dataSize);
-                }
+        long long numInvalid = 0;
+        for (size_t i = 0; i < numRanges; i++) {
+            const ValidateRangeVisitor *visitor = static_cast<const ValidateRangeVisitor *>(visitors[i]);
+            numRecords += visitor->numRecords;
+            dataSizeTotal += visitor->dataSize;
+            numInvalid += visitor->numInvalid;
+        }
+        if (numInvalid > 0) {
+            results->valid = false;
+            if (numInvalid > 1) {
+                results->errors.push_back("invalid object detected (see logs)");
             }
-            iter->getNext();
+        }
+        if (output) {
+            output->appendNumber("validateRanges", static_cast<long long>(numRanges));
         }
 
         if (_sizeStorer && full && scanData && results->valid) {
@@ -427,7 +612,9 @@ namespace mongo {
             _sizeStorer->store(this, _ident, numRecords, dataSizeTotal);
         }
 
-        output->appendNumber("nrecords", numRecords);
+        if (output) {
+            output->appendNumber("nrecords", numRecords);
+        }
 
         return Status::OK();
     }
@@ -438,7 +625,37 @@ namespace mongo {
         _db->appendCustomStats(txn, result, scale);
     }
 
-    RecordId KVRecordStore::_nextId() {
+    int64_t KVRecordStore::_loadNextIdNum(OperationContext *txn) {
+        int64_t next = _nextIdNum.load();
+        if (next != 0) {
+            return next;
+        }
+
+        boost::mutex::scoped_lock lk(_nextIdNumMutex);
+        next = _nextIdNum.load();
+        if (next != 0) {
+            return next;
+        }
+
+        // The next id is one greater than the greatest stored.  This uses the dictionary
+        // directly because subclasses call it while they're still being constructed.
+        boost::scoped_ptr<KVDictionary::Cursor> cur(_db->getCursor(txn, -1));
+        if (cur->ok()) {
+            const Slice key = cur->currKey();
+            BufReader br(key.data(), key.size());
+            const RecordId lastId = KeyString::decodeRecordId(&br);
+            invariant(lastId.isNormal());
+            next = lastId.repr() + 1;
+        } else {
+            // Need to start at 1 so we are within bounds of RecordId::isNormal()
+            next = 1;
+        }
+        _nextIdNum.store(next);
+        return next;
+    }
+
+    RecordId KVRecordStore::_nextId(OperationContext *txn) {
+        _loadNextIdNum(txn);
         return RecordId(_nextIdNum.fetchAndAdd(1));
     }
 
@@ -456,14 +673,23 @@ namespace mongo {
         // A new iterator with no start position will be either min() or max()
         invariant(id.isNormal() || id == RecordId::min() || id == RecordId::max());
         _cursor.reset(_db->getCursor(_txn, Slice::of(KeyString(id)), _dir));
+        _checkEnd();
+    }
+
+    void KVRecordStore::KVRecordIterator::_checkEnd() {
+        if (!_end.isNull() && !isEOF() && curr() >= _end) {
+            _cursor.reset();
+        }
     }
 
     KVRecordStore::KVRecordIterator::KVRecordIterator(const KVRecordStore &rs, KVDictionary *db, OperationContext *txn,
                                                       const RecordId &start,
-                                                      const CollectionScanParams::Direction &dir)
+                                                      const CollectionScanParams::Direction &dir,
+                                                      const RecordId &end)
         : _rs(rs),
           _db(db),
           _dir(dir),
+          _end(end),
           _savedLoc(),
           _savedVal(),
           _lowestInvisible(),
@@ -514,6 +740,7 @@ namespace mongo {
         // about to advance the underlying cursor.
         _saveLocAndVal();
         _cursor->advance(_txn);
+        _checkEnd();
 
         if (!isEOF()) {
             if (_idTracker) {
@@ -536,26 +763,38 @@ namespace mongo {
 
     void KVRecordStore::KVRecordIterator::invalidate(const RecordId& loc) {
         // this only gets called to invalidate potentially buffered
-        // `loc' results between saveState() and restoreState(). since
-        // we dropped our cursor and have no buffered rows, we do nothing.
+        // `loc' results between saveState() and restoreState(). a
+        // detached cursor only keeps its buffered rows if it's reattached
+        // in the same snapshot, in which case nothing could have been
+        // invalidated, so we do nothing.
     }
 
     void KVRecordStore::KVRecordIterator::saveState() {
-        // we need to drop the current cursor because it was created with
-        // an operation context that the caller intends to close after
-        // this function finishes (and before restoreState() is called,
-        // which will give us a new operation context)
+        // the current cursor was used with an operation context that the
+        // caller intends to close after this function finishes (and before
+        // restoreState() is called, which will give us a new operation
+        // context), so it must be detached from it or dropped
         _saveLocAndVal();
-        _cursor.reset();
+        if (isEOF()) {
+            _cursor.reset();
+        } else {
+            _cursor->detach();
+        }
         _txn = NULL;
     }
 
     bool KVRecordStore::KVRecordIterator::restoreState(OperationContext* txn) {
-        invariant(!_txn && !_cursor);
+        invariant(!_txn);
         _txn = txn;
         if (!_savedLoc.isNull()) {
             RecordId saved = _savedLoc;
-            _setCursor(_savedLoc);
+            if (!_cursor->reattach(txn)) {
+                // the dictionary couldn't keep the cursor, seek a new one
+                _cursor.reset();
+                _setCursor(_savedLoc);
+            } else {
+                _checkEnd();
+            }
             if (curr() != saved && _rs.isCapped()) {
                 // Doc was deleted either by cappedDeleteAsNeeded() or cappedTruncateAfter()
                 _cursor.reset();
@@ -34,6 +34,7 @@
 #include <string>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/thread/mutex.hpp>
 
 #include "mongo/db/storage/capped_callback.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
@@ -105,8 +106,14 @@ namespace mongo {
                                  RecordData* out,
                                  bool skipPessimisticLocking=false ) const;
 
+        virtual void findRecords( OperationContext* txn,
+                                  const std::vector<RecordId>& locs,
+                                  std::vector<RecordData>* out ) const;
+
         virtual void deleteRecord( OperationContext* txn, const RecordId& dl );
 
+        virtual void deleteRecord( OperationContext* txn, const RecordId& dl, int oldSize );
+
         virtual StatusWith<RecordId> insertRecord( OperationContext* txn,
                                                   const char* data,
                                                   int len,
@@ -123,6 +130,14 @@ namespace mongo {
                                                   bool enforceQuota,
                                                   UpdateNotifier* notifier );
 
+        virtual StatusWith<RecordId> updateRecord( OperationContext* txn,
+                                                  const RecordId& oldLocation,
+                                                  const RecordData& oldRec,
+                                                  const char* data,
+                                                  int len,
+                                                  bool enforceQuota,
+                                                  UpdateNotifier* notifier );
+
         virtual bool updateWithDamagesSupported() const {
             return _db->updateSupported();
         }
@@ -188,6 +203,8 @@ namespace mongo {
             const KVRecordStore &_rs;
             KVDictionary *_db;
             const CollectionScanParams::Direction _dir;
+            // If not null, a forward iterator stops before this id.
+            const RecordId _end;
             RecordId _savedLoc;
             Slice _savedVal;
 
@@ -203,10 +220,13 @@ namespace mongo {
 
             void _saveLocAndVal();
 
+            void _checkEnd();
+
         public: 
             KVRecordIterator(const KVRecordStore &rs, KVDictionary *db, OperationContext *txn,
                              const RecordId &start,
-                             const CollectionScanParams::Direction &dir);
+                             const CollectionScanParams::Direction &dir,
+                             const RecordId &end = RecordId());
 
             bool isEOF();
 
@@ -236,20 +256,30 @@ namespace mongo {
 
         void _updateStats(OperationContext *txn, long long nrDelta, long long dsDelta);
 
+        // Delete every record in [left, right) with KVDictionary::removeRange and update the
+        // stats to match.
+        void _removeRange(OperationContext *txn, const RecordId &left, const RecordId &right);
+
         // Internal version of dataFor that takes a KVDictionary - used by
         // the RecordIterator to implement dataFor.
         static RecordData _getDataFor(const KVDictionary* db, OperationContext* txn, const RecordId& loc, bool skipPessimisticLocking=false);
 
+        // Find the next RecordId from the greatest one stored, if that hasn't been done yet, and
+        // return it without using it up.
+        int64_t _loadNextIdNum(OperationContext *txn);
+
         // Generate the next unique RecordId key value for new records stored by this record store.
-        RecordId _nextId();
+        RecordId _nextId(OperationContext *txn);
 
         // An owned KVDictionary interface used to store records.
         // The key is a modified version of RecordId (see KeyString) and
         // the value is the raw record data as provided by insertRecord etc.
         boost::scoped_ptr<KVDictionary> _db;
 
-        // A thread-safe 64 bit integer for generating new unique RecordId keys.
+        // A thread-safe 64 bit integer for generating new unique RecordId keys, 0 until
+        // _loadNextIdNum() has run.
         AtomicInt64 _nextIdNum;
+        boost::mutex _nextIdNumMutex;
 
         // Locally cached copies of these counters.
         AtomicInt64 _dataSize;
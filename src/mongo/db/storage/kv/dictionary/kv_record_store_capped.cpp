@@ -63,8 +63,8 @@ namespace mongo {
           _isOplog(NamespaceString::oplog(ns)),
           _idTracker(_engineSupportsDocLocking
                      ? (_isOplog
-                        ? static_cast<VisibleIdTracker *>(new OplogIdTracker(_nextIdNum.load()))
-                        : static_cast<VisibleIdTracker *>(new CappedIdTracker(_nextIdNum.load())))
+                        ? static_cast<VisibleIdTracker *>(new OplogIdTracker(_loadNextIdNum(opCtx)))
+                        : static_cast<VisibleIdTracker *>(new CappedIdTracker(_loadNextIdNum(opCtx))))
                      : static_cast<VisibleIdTracker *>(new NoopIdTracker()))
     {}
 
@@ -264,15 +264,13 @@ namespace mongo {
     void KVRecordStoreCapped::temp_cappedTruncateAfter(OperationContext* txn,
                                                        RecordId end,
                                                        bool inclusive) {
-        WriteUnitOfWork wu( txn );
-        // Not very efficient, but it should only be used by tests.
-        for (boost::scoped_ptr<RecordIterator> iter(KVRecordStore::getIterator(txn, end)); !iter->isEOF(); ) {
-            RecordId loc = iter->getNext();
-            if (!inclusive && loc == end) {
-                continue;
-            }
-            deleteRecord(txn, loc);
+        if (!inclusive && end == RecordId::max()) {
+            return;
         }
+
+        WriteUnitOfWork wu( txn );
+        const RecordId left = inclusive ? end : RecordId(end.repr() + 1);
+        _removeRange(txn, left, RecordId::max());
         wu.commit();
     }
 
@@ -306,6 +304,12 @@ namespace mongo {
         return Status::OK();
     }
 
+    std::vector<RecordIterator *> KVRecordStoreCapped::getManyIterators( OperationContext* txn ) const {
+        std::vector<RecordIterator *> iterators;
+        iterators.push_back(getIterator(txn));
+        return iterators;
+    }
+
     RecordIterator* KVRecordStoreCapped::getIterator(OperationContext* txn,
                                                      const RecordId& start,
                                                      const CollectionScanParams::Direction& dir) const {
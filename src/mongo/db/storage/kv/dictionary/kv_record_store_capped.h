@@ -69,6 +69,10 @@ namespace mongo {
                                              const CollectionScanParams::Direction& dir =
                                              CollectionScanParams::FORWARD ) const;
 
+        // Capped collections must be read in order for visibility to work, so they are never
+        // split up.
+        virtual std::vector<RecordIterator *> getManyIterators( OperationContext* txn ) const;
+
         virtual void appendCustomStats( OperationContext* txn,
                                         BSONObjBuilder* result,
                                         double scale ) const;
@@ -0,0 +1,341 @@
+// kv_record_store_partitioned.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include <algorithm>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/catalog/collection_options.h"
+#include "mongo/db/operation_context.h"
+#include "mongo/db/storage/kv/dictionary/kv_engine_impl.h"
+#include "mongo/db/storage/kv/dictionary/kv_record_store_partitioned.h"
+#include "mongo/db/storage/kv/slice.h"
+#include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    namespace {
+
+        const std::string kMetadataKey("partitions");
+        const char kMetadataSuffix[] = ".partitions";
+        const char kPartitionSuffix[] = ".p";
+
+    }
+
+    KVRecordStorePartitioned::Metadata::Metadata()
+        : nextPartitionId(1)
+    {
+        partitions.push_back(std::make_pair(int64_t(0), RecordId()));
+    }
+
+    KVRecordStorePartitioned::Metadata KVRecordStorePartitioned::Metadata::load(OperationContext *opCtx,
+                                                                                const KVDictionary *metadataDict) {
+        Slice value;
+        Status s = metadataDict->get(opCtx, Slice(kMetadataKey), value);
+        if (s.code() == ErrorCodes::NoSuchKey) {
+            return Metadata();
+        }
+        massert(28625, str::stream() << "KVRecordStorePartitioned: couldn't read partition metadata: " << s.toString(),
+                s.isOK());
+
+        const BSONObj obj(value.data());
+        Metadata metadata;
+        metadata.nextPartitionId = obj["nextPartitionId"].numberLong();
+        if (obj.hasField("lastMax")) {
+            metadata.lastMax = RecordId(obj["lastMax"].numberLong());
+        }
+        metadata.partitions.clear();
+        BSONObjIterator it(obj.getObjectField("partitions"));
+        while (it.more()) {
+            const BSONObj partition = it.next().Obj();
+            metadata.partitions.push_back(std::make_pair(
+                    partition["_id"].numberLong(),
+                    partition.hasField("max") ? RecordId(partition["max"].numberLong()) : RecordId()));
+        }
+        massert(28626, str::stream() << "KVRecordStorePartitioned: bad partition metadata " << obj,
+                !metadata.partitions.empty());
+        return metadata;
+    }
+
+    Status KVRecordStorePartitioned::Metadata::store(OperationContext *opCtx, KVDictionary *metadataDict) const {
+        BSONObjBuilder b;
+        b.append("nextPartitionId", static_cast<long long>(nextPartitionId));
+        if (!lastMax.isNull()) {
+            b.append("lastMax", static_cast<long long>(lastMax.repr()));
+        }
+        {
+            BSONArrayBuilder ab(b.subarrayStart("partitions"));
+            for (std::vector<std::pair<int64_t, RecordId> >::const_iterator it = partitions.begin();
+                 it != partitions.end(); ++it) {
+                BSONObjBuilder pb(ab.subobjStart());
+                pb.append("_id", static_cast<long long>(it->first));
+                if (!it->second.isNull()) {
+                    pb.append("max", static_cast<long long>(it->second.repr()));
+                }
+                pb.doneFast();
+            }
+            ab.doneFast();
+        }
+        const BSONObj obj = b.obj();
+        return metadataDict->insert(opCtx, Slice(kMetadataKey), Slice(obj.objdata(), obj.objsize()), false);
+    }
+
+    std::string KVRecordStorePartitioned::metadataIdent(StringData ident) {
+        return ident.toString() + kMetadataSuffix;
+    }
+
+    std::string KVRecordStorePartitioned::partitionIdent(StringData ident, int64_t id) {
+        return str::stream() << ident << kPartitionSuffix << id;
+    }
+
+    std::string KVRecordStorePartitioned::ownerIdent(StringData ident) {
+        const size_t dot = ident.rfind('.');
+        if (dot == std::string::npos) {
+            return ident.toString();
+        }
+        const StringData suffix = ident.substr(dot);
+        if (suffix == kMetadataSuffix) {
+            return ident.substr(0, dot).toString();
+        }
+        if (suffix.startsWith(kPartitionSuffix) && suffix.size() > strlen(kPartitionSuffix)) {
+            const StringData digits = suffix.substr(strlen(kPartitionSuffix));
+            for (size_t i = 0; i < digits.size(); ++i) {
+                if (digits[i] < '0' || digits[i] > '9') {
+                    return ident.toString();
+                }
+            }
+            return ident.substr(0, dot).toString();
+        }
+        return ident.toString();
+    }
+
+    KVRecordStorePartitioned::KVRecordStorePartitioned( KVEngineImpl *engine,
+                                                        KVDictionary *metadataDict,
+                                                        KVPartitionedDictionary *db,
+                                                        const Metadata &metadata,
+                                                        OperationContext* opCtx,
+                                                        StringData ns,
+                                                        StringData ident,
+                                                        const CollectionOptions& options,
+                                                        KVSizeStorer *sizeStorer )
+        : KVRecordStore(db, opCtx, ns, ident, options, sizeStorer),
+          _engine(engine),
+          _metadataDict(metadataDict),
+          _metadata(metadata),
+          _engineOptions(options.storageEngine.getOwned())
+    {
+        // The partitions holding the greatest RecordIds may all have been dropped, but new
+        // records must still land after them.
+        if (!_metadata.lastMax.isNull() && _loadNextIdNum(opCtx) <= _metadata.lastMax.repr()) {
+            _nextIdNum.store(_metadata.lastMax.repr() + 1);
+        }
+    }
+
+    KVPartitionedDictionary *KVRecordStorePartitioned::_partitioned() const {
+        return static_cast<KVPartitionedDictionary *>(_db.get());
+    }
+
+    const KVPartitionedDictionary::Partitions &KVRecordStorePartitioned::partitions() const {
+        return _partitioned()->partitions();
+    }
+
+    class KVRecordStorePartitioned::PartitionsChange : public RecoveryUnit::Change {
+    public:
+        PartitionsChange(OperationContext *txn, KVRecordStorePartitioned *rs,
+                         const boost::shared_ptr<KVDictionary> &dropped, const std::string &droppedIdent)
+            : _txn(txn),
+              _rs(rs),
+              _oldPartitions(rs->_partitioned()->partitions()),
+              _oldMetadata(rs->_metadata),
+              _dropped(dropped),
+              _droppedIdent(droppedIdent)
+        {}
+
+        virtual void commit() {
+            if (!_dropped) {
+                return;
+            }
+
+            // The dictionary has to be closed before it can be dropped.  Cursors that were
+            // detached when the partition was dropped may still hold it open, in which case the
+            // drop fails and the dictionary is left for the collection's drop to remove.
+            _oldPartitions.clear();
+            _dropped.reset();
+            Status s = _rs->_engine->dropKVDictionary(_txn, _droppedIdent);
+            if (!s.isOK()) {
+                warning() << "KVRecordStorePartitioned: couldn't drop partition " << _droppedIdent
+                          << " of " << _rs->ns() << ": " << s;
+            }
+        }
+
+        virtual void rollback() {
+            _rs->_partitioned()->setPartitions(_oldPartitions);
+            _rs->_metadata = _oldMetadata;
+        }
+
+    private:
+        OperationContext *_txn;
+        KVRecordStorePartitioned *_rs;
+        KVPartitionedDictionary::Partitions _oldPartitions;
+        const Metadata _oldMetadata;
+        boost::shared_ptr<KVDictionary> _dropped;
+        const std::string _droppedIdent;
+    };
+
+    Status KVRecordStorePartitioned::_setPartitions(OperationContext *txn,
+                                                    const KVPartitionedDictionary::Partitions &partitions,
+                                                    const Metadata &metadata,
+                                                    const boost::shared_ptr<KVDictionary> &dropped,
+                                                    const std::string &droppedIdent) {
+        Status s = metadata.store(txn, _metadataDict.get());
+        if (!s.isOK()) {
+            return s;
+        }
+
+        txn->recoveryUnit()->registerChange(new PartitionsChange(txn, this, dropped, droppedIdent));
+        _partitioned()->setPartitions(partitions);
+        _metadata = metadata;
+        return Status::OK();
+    }
+
+    Status KVRecordStorePartitioned::addPartition( OperationContext* txn, long long* newId ) {
+        const RecordId max(_loadNextIdNum(txn) - 1);
+        if (!max.isNormal() || (!_metadata.lastMax.isNull() && max <= _metadata.lastMax)) {
+            return Status(ErrorCodes::IllegalOperation,
+                          str::stream() << "nothing has been inserted into the last partition of "
+                                        << ns() << ", not adding another");
+        }
+
+        const int64_t id = _metadata.nextPartitionId;
+        const std::string ident = partitionIdent(_ident, id);
+        Status s = _engine->createKVDictionary(txn, ident, KVDictionary::Encoding::forRecordStore(),
+                                               _engineOptions);
+        if (!s.isOK()) {
+            return s;
+        }
+        boost::shared_ptr<KVDictionary> db(_engine->getKVDictionary(txn, ident, KVDictionary::Encoding::forRecordStore(),
+                                                                    _engineOptions));
+
+        KVPartitionedDictionary::Partitions partitions(_partitioned()->partitions());
+        const KVPartitionedDictionary::Partition &last = partitions.back();
+        partitions.back() = KVPartitionedDictionary::Partition(last.id(), max, last.db());
+        partitions.push_back(KVPartitionedDictionary::Partition(id, RecordId(), db));
+
+        Metadata metadata(_metadata);
+        metadata.nextPartitionId = id + 1;
+        metadata.lastMax = max;
+        metadata.partitions.back().second = max;
+        metadata.partitions.push_back(std::make_pair(id, RecordId()));
+
+        LOG(1) << "KVRecordStorePartitioned: adding partition " << id << " to " << ns()
+               << ", previous partition ends at " << max;
+        s = _setPartitions(txn, partitions, metadata);
+        if (!s.isOK()) {
+            return s;
+        }
+        *newId = id;
+        return Status::OK();
+    }
+
+    Status KVRecordStorePartitioned::dropPartition( OperationContext* txn, long long id ) {
+        KVPartitionedDictionary::Partitions partitions(_partitioned()->partitions());
+        size_t idx = 0;
+        while (idx < partitions.size() && partitions[idx].id() != id) {
+            ++idx;
+        }
+        if (idx == partitions.size()) {
+            return Status(ErrorCodes::BadValue,
+                          str::stream() << ns() << " has no partition " << id);
+        }
+        if (idx == partitions.size() - 1) {
+            return Status(ErrorCodes::IllegalOperation,
+                          str::stream() << "can't drop the last partition of " << ns());
+        }
+
+        const boost::shared_ptr<KVDictionary> dropped = partitions[idx].db();
+        // The dictionary's stats may only be estimates, but counting the records exactly would
+        // cost as much as deleting them.
+        const KVDictionary::Stats stats = dropped->getStats();
+
+        partitions.erase(partitions.begin() + idx);
+        Metadata metadata(_metadata);
+        metadata.partitions.erase(metadata.partitions.begin() + idx);
+
+        LOG(1) << "KVRecordStorePartitioned: dropping partition " << id << " of " << ns();
+        Status s = _setPartitions(txn, partitions, metadata, dropped, partitionIdent(_ident, id));
+        if (!s.isOK()) {
+            return s;
+        }
+
+        _updateStats(txn,
+                     -std::min(static_cast<long long>(stats.numKeys), numRecords(txn)),
+                     -std::min(static_cast<long long>(stats.dataSize), dataSize(txn)));
+        return Status::OK();
+    }
+
+    Status KVRecordStorePartitioned::getPartitionBounds( OperationContext* txn, long long id,
+                                                         RecordId* min, RecordId* max ) const {
+        const KVPartitionedDictionary::Partitions &partitions = _partitioned()->partitions();
+        for (size_t i = 0; i < partitions.size(); ++i) {
+            if (partitions[i].id() != id) {
+                continue;
+            }
+            *min = (i == 0 ? RecordId::min() : RecordId(partitions[i - 1].max().repr() + 1));
+            *max = (partitions[i].bounded() ? partitions[i].max() : RecordId::max());
+            return Status::OK();
+        }
+        return Status(ErrorCodes::BadValue,
+                      str::stream() << ns() << " has no partition " << id);
+    }
+
+    Status KVRecordStorePartitioned::appendPartitionInfo( OperationContext* txn, BSONObjBuilder* output ) const {
+        const KVPartitionedDictionary::Partitions &partitions = _partitioned()->partitions();
+        BSONArrayBuilder ab(output->subarrayStart("partitions"));
+        for (KVPartitionedDictionary::Partitions::const_iterator it = partitions.begin();
+             it != partitions.end(); ++it) {
+            const KVDictionary::Stats stats = it->db()->getStats();
+            BSONObjBuilder b(ab.subobjStart());
+            b.append("_id", static_cast<long long>(it->id()));
+            if (it->bounded()) {
+                b.append("max", static_cast<long long>(it->max().repr()));
+            }
+            b.appendNumber("count", static_cast<long long>(stats.numKeys));
+            b.appendNumber("size", static_cast<long long>(stats.dataSize));
+            b.appendNumber("storageSize", static_cast<long long>(stats.storageSize));
+            b.doneFast();
+        }
+        ab.doneFast();
+        return Status::OK();
+    }
+
+} // namespace mongo
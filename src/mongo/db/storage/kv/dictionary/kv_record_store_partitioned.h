@@ -0,0 +1,145 @@
+// kv_record_store_partitioned.h
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost/scoped_ptr.hpp>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/db/storage/kv/dictionary/kv_partitioned_dictionary.h"
+#include "mongo/db/storage/kv/dictionary/kv_record_store.h"
+
+namespace mongo {
+
+    class KVEngineImpl;
+    class KVSizeStorer;
+
+    // Like a KVRecordStore, but records are kept in a KVPartitionedDictionary and whole
+    // partitions can be added and dropped.
+    //
+    // The partition list is kept in a small metadata dictionary of its own, and each partition
+    // is a dictionary named after the record store's ident (see partitionIdent()).
+    class KVRecordStorePartitioned : public KVRecordStore {
+    public:
+        /**
+         * The persisted partition list.
+         */
+        class Metadata {
+        public:
+            // A fresh record store has one unbounded partition, with id 0.
+            Metadata();
+
+            /**
+             * Read the partition list from `metadataDict', or return a fresh one if it hasn't
+             * been stored yet.
+             */
+            static Metadata load(OperationContext *opCtx, const KVDictionary *metadataDict);
+
+            Status store(OperationContext *opCtx, KVDictionary *metadataDict) const;
+
+            // The id the next partition created will get.
+            int64_t nextPartitionId;
+
+            // The greatest max any partition was ever capped at, so that RecordIds aren't reused
+            // after all the bounded partitions are dropped.
+            RecordId lastMax;
+
+            // Id and max of each partition, the last one's max is null.
+            std::vector<std::pair<int64_t, RecordId> > partitions;
+        };
+
+        static std::string metadataIdent(StringData ident);
+
+        static std::string partitionIdent(StringData ident, int64_t id);
+
+        /**
+         * If `ident' is a dictionary belonging to a partitioned record store, return the record
+         * store's ident, otherwise return `ident' unchanged.
+         */
+        static std::string ownerIdent(StringData ident);
+
+        // KVRecordStore takes ownership of db, and we take ownership of metadataDict.
+        KVRecordStorePartitioned( KVEngineImpl *engine,
+                                  KVDictionary *metadataDict,
+                                  KVPartitionedDictionary *db,
+                                  const Metadata &metadata,
+                                  OperationContext* opCtx,
+                                  StringData ns,
+                                  StringData ident,
+                                  const CollectionOptions& options,
+                                  KVSizeStorer *sizeStorer );
+
+        virtual ~KVRecordStorePartitioned() { }
+
+        virtual bool isPartitioned() const { return true; }
+
+        virtual Status addPartition( OperationContext* txn, long long* newId );
+
+        virtual Status dropPartition( OperationContext* txn, long long id );
+
+        virtual Status getPartitionBounds( OperationContext* txn, long long id,
+                                           RecordId* min, RecordId* max ) const;
+
+        virtual Status appendPartitionInfo( OperationContext* txn, BSONObjBuilder* output ) const;
+
+        /**
+         * The current partitions, which the collection's partitioned indexes are opened with.
+         */
+        const KVPartitionedDictionary::Partitions &partitions() const;
+
+    private:
+        class PartitionsChange;
+
+        // Store the new partition list and switch to it, putting the old one back on rollback.
+        // If `dropped' is set, it's a partition left out of the new list whose dictionary gets
+        // dropped on commit.
+        Status _setPartitions(OperationContext *txn, const KVPartitionedDictionary::Partitions &partitions,
+                              const Metadata &metadata,
+                              const boost::shared_ptr<KVDictionary> &dropped = boost::shared_ptr<KVDictionary>(),
+                              const std::string &droppedIdent = std::string());
+
+        KVPartitionedDictionary *_partitioned() const;
+
+        KVEngineImpl *_engine;
+
+        boost::scoped_ptr<KVDictionary> _metadataDict;
+
+        Metadata _metadata;
+
+        // Options new partitions are created with.
+        const BSONObj _engineOptions;
+    };
+
+} // namespace mongo
@@ -70,6 +70,19 @@ namespace mongo {
          * KVRecordStoreCapped::deleteAsNeeded).
          */
         virtual KVRecoveryUnit *newRecoveryUnit() const = 0;
+
+        /**
+         * Creates a read-only RecoveryUnit that reads from this one's snapshot (creating it if
+         * needed), for other threads to help with a read this one is doing (see
+         * KVDictionaryParallelScan).  It must not be used for writes or units of work, and must
+         * be destroyed before this one's snapshot ends.
+         *
+         * Return: NULL if the engine can't share snapshots, or if this one's transaction isn't a
+         *         read-only snapshot.
+         */
+        virtual KVRecoveryUnit *newSharedSnapshotRecoveryUnit(OperationContext *opCtx) {
+            return NULL;
+        }
     };
 
 } // namespace mongo
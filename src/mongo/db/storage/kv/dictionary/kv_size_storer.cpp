@@ -41,6 +41,7 @@
 #include "mongo/db/storage/kv/dictionary/kv_record_store.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
 #include "mongo/db/storage/kv/dictionary/kv_size_storer.h"
+#include "mongo/db/storage/kv/dictionary/kv_sorted_data_impl.h"
 #include "mongo/db/storage/kv/slice.h"
 #include "mongo/db/storage/recovery_unit.h"
 #include "mongo/stdx/functional.h"
@@ -51,10 +52,14 @@ namespace mongo {
 
     namespace {
         int MAGIC = 123321;
+
+        // Idents never contain '$', so this can't collide with an entry.
+        const char kCleanShutdownKey[] = "$cleanShutdown";
     }
 
     KVSizeStorer::KVSizeStorer(KVDictionary *metadataDict, RecoveryUnit *ru)
         : _metadataDict(metadataDict),
+          _loadedAfterCleanShutdown(false),
           _syncRunning(true),
           _syncTerminated(false),
           _syncThread(stdx::bind(&KVSizeStorer::syncThread, this, ru))
@@ -122,9 +127,29 @@ namespace mongo {
         entry.dataSize = dataSize;
         entry.dirty = true;
         entry.rs = rs;
+        entry.index = NULL;
+    }
+
+    void KVSizeStorer::onCreateIndex(KVSortedDataImpl *index, StringData ident, long long numKeys) {
+        storeIndex(index, ident, numKeys);
     }
 
-    void KVSizeStorer::load(StringData ident,
+    void KVSizeStorer::onDestroyIndex(StringData ident, long long numKeys) {
+        storeIndex(NULL, ident, numKeys);
+    }
+
+    void KVSizeStorer::storeIndex(KVSortedDataImpl *index, StringData ident, long long numKeys) {
+        _checkMagic();
+        boost::mutex::scoped_lock lk( _entriesMutex );
+        Entry& entry = _entries[ident.toString()];
+        entry.numRecords = numKeys;
+        entry.dataSize = 0;
+        entry.dirty = true;
+        entry.rs = NULL;
+        entry.index = index;
+    }
+
+    bool KVSizeStorer::load(StringData ident,
                             long long* numRecords, long long* dataSize) const {
         _checkMagic();
         boost::mutex::scoped_lock lk( _entriesMutex );
@@ -132,10 +157,11 @@ namespace mongo {
         if (it == _entries.end()) {
             *numRecords = 0;
             *dataSize = 0;
-            return;
+            return false;
         }
         *numRecords = it->second.numRecords;
         *dataSize = it->second.dataSize;
+        return true;
     }
 
     BSONObj KVSizeStorer::Entry::serialize() const {
@@ -147,26 +173,43 @@ namespace mongo {
         : numRecords(serialized["numRecords"].safeNumberLong()),
           dataSize(serialized["dataSize"].safeNumberLong()),
           dirty(false),
-          rs(NULL)
+          rs(NULL),
+          index(NULL)
     {}
 
     void KVSizeStorer::loadFromDict(OperationContext *opCtx) {
         _checkMagic();
 
         Map m;
+        bool cleanShutdown = false;
         {
             for (boost::scoped_ptr<KVDictionary::Cursor> cur(_metadataDict->getCursor(opCtx));
                  cur->ok(); cur->advance(opCtx)) {
                 const std::string key(cur->currKey().data(), cur->currKey().size());
                 BSONObj data(cur->currVal().data());
+                if (key == kCleanShutdownKey) {
+                    cleanShutdown = true;
+                    continue;
+                }
                 LOG(2) << "KVSizeStorer::loadFrom " << key << " -> " << data;
                 Entry& e = m[key];
                 e = Entry(data);
             }
         }
 
+        if (cleanShutdown) {
+            // From here on the stats can drift from the truth if we crash, so the next startup
+            // must not trust them unless we shut down cleanly again.
+            WriteUnitOfWork wuow(opCtx);
+            Status s = _metadataDict->remove(opCtx, Slice(kCleanShutdownKey, sizeof(kCleanShutdownKey) - 1));
+            massert(28628, str::stream() << "KVSizeStorer::loadFrom: remove: " << s.toString(), s.isOK());
+            wuow.commit();
+            LOG(1) << "KVSizeStorer::loadFrom found stats from a clean shutdown";
+        }
+
         boost::mutex::scoped_lock lk( _entriesMutex );
         _entries = m;
+        _loadedAfterCleanShutdown = cleanShutdown;
     }
 
     void KVSizeStorer::storeIntoDict(OperationContext *opCtx) {
@@ -187,6 +230,12 @@ namespace mongo {
                         entry.dirty = true;
                     }
                 }
+                if ( entry.index ) {
+                    if ( entry.numRecords != entry.index->numEntries( NULL ) ) {
+                        entry.numRecords = entry.index->numEntries( NULL );
+                        entry.dirty = true;
+                    }
+                }
 
                 if (!entry.dirty) {
                     continue;
@@ -219,4 +268,17 @@ namespace mongo {
         }
     }
 
+    void KVSizeStorer::markCleanShutdown(OperationContext *opCtx) {
+        _checkMagic();
+        const BSONObj data = BSON("cleanShutdown" << true);
+        WriteUnitOfWork wuow(opCtx);
+        Status s = _metadataDict->insert(opCtx, Slice(kCleanShutdownKey, sizeof(kCleanShutdownKey) - 1), Slice(data.objdata(), data.objsize()), false);
+        if (!s.isOK()) {
+            // Not fatal, the next startup just recounts.
+            warning() << "KVSizeStorer::markCleanShutdown: insert: " << s.toString();
+            return;
+        }
+        wuow.commit();
+    }
+
 }
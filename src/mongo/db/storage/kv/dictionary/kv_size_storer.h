@@ -42,6 +42,7 @@ namespace mongo {
 
     class KVDictionary;
     class KVRecordStore;
+    class KVSortedDataImpl;
     class RecoveryUnit;
 
     class KVSizeStorer {
@@ -54,24 +55,51 @@ namespace mongo {
         void onDestroy(StringData ident,
                        long long nr, long long ds);
 
+        /**
+         * Indexes keep their number of keys here too, in place of numRecords.
+         */
+        void onCreateIndex(KVSortedDataImpl *index, StringData ident, long long numKeys);
+        void onDestroyIndex(StringData ident, long long numKeys);
+        void storeIndex(KVSortedDataImpl *index, StringData ident, long long numKeys);
+
         void store(RecordStore *rs, StringData ident,
                    long long numRecords, long long dataSize);
 
-        void load(StringData ident,
+        /**
+         * Return: true if there are stored stats for `ident', otherwise both are set to 0.
+         */
+        bool load(StringData ident,
                   long long* numRecords, long long* dataSize) const;
 
+        /**
+         * Also consumes the clean shutdown marker, so the stats are only trusted if nothing could
+         * have changed since they were written.
+         */
         void loadFromDict(OperationContext *opCtx);
         void storeIntoDict(OperationContext *opCtx);
 
+        /**
+         * Records that the stats were just stored by a clean shutdown, so they are exact.  Call
+         * after the final storeIntoDict().
+         */
+        void markCleanShutdown(OperationContext *opCtx);
+
+        /**
+         * True if loadFromDict() found the stats written by a clean shutdown, in which case
+         * record stores don't need to recount themselves.
+         */
+        bool loadedAfterCleanShutdown() const { return _loadedAfterCleanShutdown; }
+
     private:
         void _checkMagic() const;
 
         struct Entry {
-            Entry() : numRecords(0), dataSize(0), dirty(false), rs(NULL) {}
+            Entry() : numRecords(0), dataSize(0), dirty(false), rs(NULL), index(NULL) {}
             long long numRecords;
             long long dataSize;
             bool dirty;
             RecordStore *rs;
+            KVSortedDataImpl *index;
 
             BSONObj serialize() const;
             Entry(const BSONObj &serialized);
@@ -83,6 +111,8 @@ namespace mongo {
 
         KVDictionary *_metadataDict;
 
+        bool _loadedAfterCleanShutdown;
+
         typedef std::map<std::string,Entry> Map;
         Map _entries;
         mutable boost::mutex _entriesMutex;
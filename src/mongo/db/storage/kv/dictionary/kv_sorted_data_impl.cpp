@@ -31,14 +31,18 @@
 
 #define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
 
+#include <algorithm>
 #include <boost/scoped_ptr.hpp>
 
 #include "mongo/base/checked_cast.h"
+#include "mongo/base/owned_pointer_vector.h"
 #include "mongo/db/concurrency/write_conflict_exception.h"
 #include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/storage/index_entry_comparison.h"
 #include "mongo/db/storage/key_string.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
+#include "mongo/db/storage/kv/dictionary/kv_dictionary_parallel_scan.h"
+#include "mongo/db/storage/kv/dictionary/kv_size_storer.h"
 #include "mongo/db/storage/kv/dictionary/kv_sorted_data_impl.h"
 #include "mongo/db/storage/kv/slice.h"
 #include "mongo/platform/endian.h"
@@ -51,6 +55,16 @@ namespace mongo {
 
         const int kTempKeyMaxSize = 1024; // this goes away with SERVER-3372
 
+        // Like record stores, indexes whose stored count may be stale are recounted when opened,
+        // unless they're too big for that to be cheap.
+        const long long kScanOnIndexOpenThreshold = 10000;
+
+        // A full validate splits the index into at most this many ranges, none smaller than
+        // kValidateMinRangeSize bytes, and scans up to kValidateMaxThreads of them at once.
+        const size_t kValidateMaxRanges = 64;
+        const long long kValidateMinRangeSize = 16 << 20;
+        const size_t kValidateMaxThreads = 8;
+
         Status checkKeySize(const BSONObj &key) {
             if (key.objsize() >= kTempKeyMaxSize) {
                 StringBuilder sb;
@@ -91,24 +105,159 @@ namespace mongo {
             return sb.str();
         }
 
+        /**
+         * The value stored with an index key is its TypeBits, or nothing at all when they're all
+         * zeros (which is the common case).
+         */
+        Slice typeBitsValue(const KeyString &keyString) {
+            const KeyString::TypeBits &typeBits = keyString.getTypeBits();
+            if (typeBits.isAllZeros()) {
+                return Slice();
+            }
+            // Gotta love that strong C type system, protecting us from all the important errors...
+            return Slice(reinterpret_cast<const char *>(typeBits.getBuffer()), typeBits.getSize());
+        }
+
+        /**
+         * A clustering index stores the TypeBits followed by the document.  Here the TypeBits are
+         * always written, even when they're all zeros, so we can tell where the document starts.
+         */
+        void buildClusteringValue(const KeyString &keyString, const BSONObj &doc, BufBuilder *bb) {
+            const KeyString::TypeBits &typeBits = keyString.getTypeBits();
+            bb->appendBuf(typeBits.getBuffer(), typeBits.getSize());
+            bb->appendBuf(doc.objdata(), doc.objsize());
+        }
+
     }  // namespace
 
     KVSortedDataImpl::KVSortedDataImpl(KVDictionary* db,
                                        OperationContext* opCtx,
-                                       const IndexDescriptor* desc)
+                                       const IndexDescriptor* desc,
+                                       StringData ident,
+                                       KVSizeStorer* sizeStorer)
         : _db(db),
-          _ordering(Ordering::make(desc ? desc->keyPattern() : BSONObj()))
+          _ordering(Ordering::make(desc ? desc->keyPattern() : BSONObj())),
+          _isClustering(desc && desc->isClustering()),
+          _ident(ident.toString()),
+          _ns(desc ? desc->parentNS() : std::string()),
+          _sizeStorer(sizeStorer)
     {
         invariant(_db);
+
+        if (_sizeStorer) {
+            long long numEntries;
+            long long unused;
+            const bool found = _sizeStorer->load(_ident, &numEntries, &unused);
+
+            if ((!found || !_sizeStorer->loadedAfterCleanShutdown()) &&
+                numEntries < kScanOnIndexOpenThreshold) {
+                LOG(1) << "Doing scan of index " << _ident << " to refresh numEntries";
+                _numEntries.store(_countEntries(opCtx));
+                if (found && numEntries != _numEntries.load()) {
+                    warning() << "Stored value for index " << _ident << " numEntries was " << numEntries
+                              << " but actual value is " << _numEntries.load();
+                }
+            } else {
+                _numEntries.store(numEntries);
+            }
+
+            _sizeStorer->onCreateIndex(this, _ident, _numEntries.load());
+        }
     }
 
+    KVSortedDataImpl::~KVSortedDataImpl() {
+        if (_sizeStorer) {
+            _sizeStorer->onDestroyIndex(_ident, _numEntries.load());
+        }
+    }
+
+    class RollbackNumEntriesChange : public RecoveryUnit::Change {
+        KVSortedDataImpl *_index;
+        long long _delta;
+    public:
+        RollbackNumEntriesChange(KVSortedDataImpl *index, long long delta)
+            : _index(index),
+              _delta(delta)
+        {}
+
+        void commit() {}
+
+        void rollback() {
+            _index->undoUpdateNumEntries(_delta);
+        }
+    };
+
+    void KVSortedDataImpl::undoUpdateNumEntries(long long delta) {
+        invariant(_sizeStorer);
+        _numEntries.subtractAndFetch(delta);
+    }
+
+    void KVSortedDataImpl::_updateNumEntries(OperationContext *txn, long long delta) {
+        if (_sizeStorer) {
+            _numEntries.addAndFetch(delta);
+            txn->recoveryUnit()->registerChange(new RollbackNumEntriesChange(this, delta));
+        }
+    }
+
+    KVSortedDataBuilderImpl::KVSortedDataBuilderImpl(KVSortedDataImpl *index,
+                                                     KVDictionary *db,
+                                                     OperationContext *txn,
+                                                     const Ordering &ordering,
+                                                     bool dupsAllowed)
+        : _index(index),
+          _txn(txn),
+          _wuow(txn),
+          _builder(db->getBuilder(txn)),
+          _ordering(ordering),
+          _dupsAllowed(dupsAllowed),
+          _lastKey(),
+          _lastLoc(),
+          _numKeys(0)
+    {}
+
     Status KVSortedDataBuilderImpl::addKey(const BSONObj& key, const RecordId& loc) {
-        return _impl->insert(_txn, key, loc, _dupsAllowed);
+        invariant(loc.isNormal());
+        dassert(!hasFieldNames(key));
+
+        Status s = checkKeySize(key);
+        if (!s.isOK()) {
+            return s;
+        }
+
+        if (!_lastLoc.isNull()) {
+            const int cmp = key.woCompare(_lastKey, _ordering);
+            if (cmp == 0 && !_dupsAllowed) {
+                return Status(ErrorCodes::DuplicateKey, dupKeyError(key));
+            }
+            if (cmp < 0 || (cmp == 0 && loc <= _lastLoc)) {
+                return Status(ErrorCodes::InternalError,
+                              str::stream() << "KVSortedDataBuilderImpl::addKey(): keys out of order, "
+                                            << key << ' ' << loc << " after "
+                                            << _lastKey << ' ' << _lastLoc);
+            }
+        }
+
+        KeyString keyString(key, _ordering, loc);
+        s = _builder->insert(Slice::of(keyString), typeBitsValue(keyString));
+        if (!s.isOK()) {
+            return s;
+        }
+
+        _lastKey = key.getOwned();
+        _lastLoc = loc;
+        _numKeys++;
+        return s;
+    }
+
+    void KVSortedDataBuilderImpl::commit(bool mayInterrupt) {
+        uassertStatusOK(_builder->commit(mayInterrupt));
+        _index->_updateNumEntries(_txn, _numKeys);
+        _wuow.commit();
     }
 
     SortedDataBuilderInterface* KVSortedDataImpl::getBulkBuilder(OperationContext* txn,
                                                                  bool dupsAllowed) {
-      return new KVSortedDataBuilderImpl(this, txn, dupsAllowed);
+        return new KVSortedDataBuilderImpl(this, _db.get(), txn, _ordering, dupsAllowed);
     }
 
     BSONObj KVSortedDataImpl::extractKey(const Slice &key, const Slice &val, const Ordering &ordering) {
@@ -128,6 +277,24 @@ namespace mongo {
                                     const BSONObj& key,
                                     const RecordId& loc,
                                     bool dupsAllowed) {
+        // A clustering index can't do without the document.
+        invariant(!_isClustering);
+        return _insert(txn, key, loc, NULL, dupsAllowed);
+    }
+
+    Status KVSortedDataImpl::insertWithDocument(OperationContext* txn,
+                                                const BSONObj& key,
+                                                const RecordId& loc,
+                                                const BSONObj& doc,
+                                                bool dupsAllowed) {
+        return _insert(txn, key, loc, _isClustering ? &doc : NULL, dupsAllowed);
+    }
+
+    Status KVSortedDataImpl::_insert(OperationContext* txn,
+                                     const BSONObj& key,
+                                     const RecordId& loc,
+                                     const BSONObj* doc,
+                                     bool dupsAllowed) {
         invariant(loc.isNormal());
         dassert(!hasFieldNames(key));
 
@@ -153,12 +320,36 @@ namespace mongo {
         }
 
         KeyString keyString(key, _ordering, loc);
-        Slice val;
-        if (!keyString.getTypeBits().isAllZeros()) {
-            // Gotta love that strong C type system, protecting us from all the important errors...
-            val = Slice(reinterpret_cast<const char *>(keyString.getTypeBits().getBuffer()), keyString.getTypeBits().getSize());
+        if (doc != NULL) {
+            BufBuilder bb;
+            buildClusteringValue(keyString, *doc, &bb);
+            s = _db->insert(txn, Slice::of(keyString), Slice(bb.buf(), bb.len()), false);
+        } else {
+            s = _db->insert(txn, Slice::of(keyString), typeBitsValue(keyString), false);
+        }
+        // Inserts are blind, so an entry inserted again (e.g. by oplog replay) is counted again.
+        // A full validate corrects the count.
+        if (s.isOK()) {
+            _updateNumEntries(txn, 1);
         }
-        return _db->insert(txn, Slice::of(keyString), val, false);
+        return s;
+    }
+
+    Status KVSortedDataImpl::replaceDocument(OperationContext* txn,
+                                             const BSONObj& key,
+                                             const RecordId& loc,
+                                             const BSONObj& doc) {
+        invariant(loc.isNormal());
+        dassert(!hasFieldNames(key));
+        if (!_isClustering) {
+            return Status::OK();
+        }
+
+        // The entry is already there, so there's nothing to check or count.
+        const KeyString keyString(key, _ordering, loc);
+        BufBuilder bb;
+        buildClusteringValue(keyString, doc, &bb);
+        return _db->insert(txn, Slice::of(keyString), Slice(bb.buf(), bb.len()), false);
     }
 
     void KVSortedDataImpl::unindex(OperationContext* txn,
@@ -167,7 +358,12 @@ namespace mongo {
                                    bool dupsAllowed) {
         invariant(loc.isNormal());
         dassert(!hasFieldNames(key));
-        _db->remove(txn, Slice::of(KeyString(key, _ordering, loc)));
+        // Removes are blind, so removing a missing entry is counted too.  A full validate
+        // corrects the count.
+        Status s = _db->remove(txn, Slice::of(KeyString(key, _ordering, loc)));
+        if (s.isOK()) {
+            _updateNumEntries(txn, -1);
+        }
     }
 
     Status KVSortedDataImpl::dupKeyCheck(OperationContext* txn,
@@ -185,15 +381,116 @@ namespace mongo {
         }
     }
 
+    long long KVSortedDataImpl::_countEntries(OperationContext* txn) const {
+        long long numKeys = 0;
+        for (boost::scoped_ptr<KVDictionary::Cursor> cursor(_db->getCursor(txn));
+             cursor->ok(); cursor->advance(txn)) {
+            ++numKeys;
+        }
+        return numKeys;
+    }
+
+    namespace {
+
+        class IndexRangeVisitor : public KVDictionaryParallelScan::RangeVisitor {
+            const Ordering &_ordering;
+            const bool _hash;
+
+        public:
+            long long numEntries;
+            uint64_t hash;
+
+            IndexRangeVisitor(const Ordering &ordering, bool hash)
+                : _ordering(ordering), _hash(hash), numEntries(0), hash(0)
+            {}
+
+            virtual Status visit(const Slice &key, const Slice &value) {
+                numEntries++;
+                if (_hash) {
+                    hash += SortedDataInterface::hashEntry(KVSortedDataImpl::extractKey(key, value, _ordering),
+                                                           KVSortedDataImpl::extractRecordId(key));
+                }
+                return Status::OK();
+            }
+        };
+
+    }
+
+    Status KVSortedDataImpl::_scanEntries(OperationContext* txn, long long* numEntriesOut, uint64_t* hashOut) const {
+        KVDictionaryParallelScan scan(_db.get());
+        const size_t numRanges = scan.split(txn, static_cast<size_t>(std::max(1LL, std::min(
+                static_cast<long long>(kValidateMaxRanges), _db->getStats().dataSize / kValidateMinRangeSize))));
+
+        OwnedPointerVector<KVDictionaryParallelScan::RangeVisitor> visitors;
+        for (size_t i = 0; i < numRanges; i++) {
+            visitors.mutableVector().push_back(new IndexRangeVisitor(_ordering, hashOut != NULL));
+        }
+
+        Status s = scan.run(txn, visitors.vector(), kValidateMaxThreads,
+                            hashOut != NULL ? "validate: hashing index entries" : "validate: counting index entries",
+                            static_cast<unsigned long long>(_sizeStorer ? _numEntries.load() : 0));
+        if (!s.isOK()) {
+            return s;
+        }
+
+        long long numEntries = 0;
+        uint64_t hash = 0;
+        for (size_t i = 0; i < numRanges; i++) {
+            const IndexRangeVisitor *visitor = static_cast<const IndexRangeVisitor *>(visitors[i]);
+            numEntries += visitor->numEntries;
+            hash += visitor->hash;
+        }
+        *numEntriesOut = numEntries;
+        if (hashOut != NULL) {
+            *hashOut = hash;
+        }
+        return Status::OK();
+    }
+
     void KVSortedDataImpl::fullValidate(OperationContext* txn, bool full, long long* numKeysOut,
                                         BSONObjBuilder* output) const {
-        if (numKeysOut) {
-            *numKeysOut = 0;
-            for (boost::scoped_ptr<KVDictionary::Cursor> cursor(_db->getCursor(txn));
-                 cursor->ok(); cursor->advance(txn)) {
-                ++(*numKeysOut);
-            }
+        if (!numKeysOut) {
+            return;
+        }
+
+        if (!full) {
+            *numKeysOut = _sizeStorer ? _numEntries.load() : _countEntries(txn);
+            return;
+        }
+
+        _fullValidate(txn, numKeysOut, NULL, output);
+    }
+
+    Status KVSortedDataImpl::fullValidateAndHash(OperationContext* txn, long long* numKeysOut,
+                                                 uint64_t* hashOut, BSONObjBuilder* output) const {
+        _fullValidate(txn, numKeysOut, hashOut, output);
+        return Status::OK();
+    }
+
+    void KVSortedDataImpl::_fullValidate(OperationContext* txn, long long* numKeysOut,
+                                         uint64_t* hashOut, BSONObjBuilder* output) const {
+        // Writers may change the count while we scan, so correct it by the difference from what
+        // it was when the scan started rather than overwriting their changes.
+        const long long stored = _numEntries.load();
+        uassertStatusOK(_scanEntries(txn, numKeysOut, hashOut));
+        if (!_sizeStorer) {
+            return;
+        }
+
+        if (output) {
+            output->appendNumber("storedNumEntries", stored);
         }
+        if (*numKeysOut != stored) {
+            warning() << "Stored value for index " << _ident << " numEntries was " << stored
+                      << " but actual value is " << *numKeysOut;
+            const long long corrected = _numEntries.addAndFetch(*numKeysOut - stored);
+            _sizeStorer->storeIndex(const_cast<KVSortedDataImpl *>(this), _ident, corrected);
+        }
+    }
+
+    Status KVSortedDataImpl::hashEntries(OperationContext* txn, uint64_t* hashOut) const {
+        long long numEntries;
+        return _scanEntries(txn, &numEntries, hashOut);
     }
 
     bool KVSortedDataImpl::isEmpty( OperationContext* txn ) {
@@ -202,9 +499,10 @@ namespace mongo {
     }
 
     long long KVSortedDataImpl::numEntries(OperationContext* txn) const {
-        long long numKeys = 0;
-        fullValidate(txn, true, &numKeys, NULL);
-        return numKeys;
+        if (_sizeStorer) {
+            return _numEntries.load();
+        }
+        return _countEntries(txn);
     }
 
     Status KVSortedDataImpl::initAsEmpty(OperationContext* txn) {
@@ -240,6 +538,17 @@ namespace mongo {
 
         mutable bool _initialized;
 
+        // Where the caller said it will stop (see setEndPosition), or empty if it didn't.
+        Slice _endKey;
+        bool _endKeyInclusive;
+
+        KVDictionary::Cursor *_getCursor(const KeyString &ks) const {
+            if (_endKey.size() == 0) {
+                return _db->getCursor(_txn, Slice::of(ks), _dir);
+            }
+            return _db->getRangeCursor(_txn, Slice::of(ks), _endKey, _endKeyInclusive, _dir);
+        }
+
         void _initialize() const {
             if (_initialized) {
                 return;
@@ -289,7 +598,13 @@ namespace mongo {
 
         bool _locate(const KeyString &ks) {
             invalidateCache();
-            _cursor.reset(_db->getCursor(_txn, Slice::of(ks), _dir));
+            if (_cursor) {
+                // Much cheaper than a new cursor, especially when the key is close by, as it often
+                // is for advanceTo.
+                _cursor->seek(_txn, Slice::of(ks));
+            } else {
+                _cursor.reset(_getCursor(ks));
+            }
             return !isEOF() &&
                     ks.getSize() == _cursor->currKey().size() &&
                     memcmp(ks.getBuffer(), _cursor->currKey().data(), ks.getSize()) == 0;
@@ -312,7 +627,9 @@ namespace mongo {
               _isTypeBitsValid(false),
               _typeBits(),
               _savedLoc(),
-              _initialized(false)
+              _initialized(false),
+              _endKey(),
+              _endKeyInclusive(false)
         {}
 
         virtual ~KVSortedDataInterfaceCursor() {}
@@ -421,6 +738,21 @@ namespace mongo {
             return _keyBson;
         }
 
+        BSONObj getDocument() const {
+            _initialize();
+            if (isEOF()) {
+                return BSONObj();
+            }
+            // Skip the TypeBits, anything after them is the document.
+            const Slice &val = _cursor->currVal();
+            BufReader br(val.data(), val.size());
+            KeyString::TypeBits::fromBuffer(&br);
+            if (br.remaining() == 0) {
+                return BSONObj();
+            }
+            return BSONObj(static_cast<const char *>(br.pos())).getOwned();
+        }
+
         RecordId getRecordId() const {
             _initialize();
             if (isEOF()) {
@@ -442,22 +774,45 @@ namespace mongo {
             }
         }
 
+        void setEndPosition(const BSONObj& key, bool inclusive) {
+            if (key.isEmpty()) {
+                _endKey = Slice();
+                return;
+            }
+            // Pick the RecordId so that an inclusive end takes in every entry with this key, and
+            // an exclusive one none of them.
+            const bool afterKey = (inclusive == (_dir > 0));
+            _endKey = Slice::of(KeyString(stripFieldNames(key), _ordering,
+                                          afterKey ? RecordId::max() : RecordId::min())).owned();
+            _endKeyInclusive = inclusive;
+        }
+
         void savePosition() {
             _initialize();
             if (!isEOF()) {
                 loadKeyIfNeeded();
             }
             _savedLoc = getRecordId();
-            _cursor.reset();
+            if (isEOF()) {
+                _cursor.reset();
+            } else {
+                _cursor->detach();
+            }
             _txn = NULL;
         }
 
         void restorePosition(OperationContext* txn) {
-            invariant(!_txn && !_cursor);
+            invariant(!_txn);
             _txn = txn;
             _initialized = true;
             if (!_savedLoc.isNull()) {
-                _locate(_keyString);
+                if (_cursor->reattach(txn)) {
+                    // The cursor may have moved past our key if it's gone now.
+                    invalidateCache();
+                } else {
+                    _cursor.reset();
+                    _locate(_keyString);
+                }
             } else {
                 invariant(isEOF()); // this is the whole point!
             }
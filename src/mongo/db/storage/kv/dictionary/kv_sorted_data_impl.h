@@ -35,44 +35,59 @@
 #include "mongo/bson/ordering.h"
 #include "mongo/db/storage/kv/slice.h"
 #include "mongo/db/storage/sorted_data_interface.h"
+#include "mongo/platform/atomic_word.h"
 
 namespace mongo {
 
     class KVDictionary;
+    class KVDictionaryBuilder;
+    class KVSizeStorer;
     class IndexDescriptor;
     class OperationContext;
     class KVSortedDataImpl;
 
     /**
-     * Dummy implementation for now.  We'd need a KVDictionaryBuilder to
-     * do better, let's worry about that later.
+     * Bulk builder for a KVSortedDataImpl.  Index builds hand us keys in sorted order, so we can
+     * check for duplicates against the previous key alone and pass the encoded entries on to the
+     * dictionary's KVDictionaryBuilder, which can usually load them much more cheaply than
+     * individual inserts.
      */
     class KVSortedDataBuilderImpl : public SortedDataBuilderInterface {
-        KVSortedDataImpl *_impl;
+        KVSortedDataImpl *_index;
         OperationContext *_txn;
         WriteUnitOfWork _wuow;
+        // Destroyed before _wuow, so an unfinished build is abandoned before the unit of work ends.
+        boost::scoped_ptr<KVDictionaryBuilder> _builder;
+        const Ordering _ordering;
         bool _dupsAllowed;
 
+        // The last key (and its RecordId) successfully added, used to check ordering and dups.
+        BSONObj _lastKey;
+        RecordId _lastLoc;
+        long long _numKeys;
+
     public:
-        KVSortedDataBuilderImpl(KVSortedDataImpl *impl, OperationContext *txn, bool dupsAllowed)
-            : _impl(impl),
-              _txn(txn),
-              _wuow(txn),
-              _dupsAllowed(dupsAllowed)
-        {}
+        KVSortedDataBuilderImpl(KVSortedDataImpl *index, KVDictionary *db, OperationContext *txn,
+                                const Ordering &ordering, bool dupsAllowed);
+
         virtual Status addKey(const BSONObj& key, const RecordId& loc);
-        virtual void commit(bool mayInterrupt) {
-            _wuow.commit();
-        }
+
+        virtual void commit(bool mayInterrupt);
     };
 
     /**
      * Generic implementation of the SortedDataInterface using a KVDictionary.
+     *
+     * If given a KVSizeStorer, the number of keys is kept up to date as keys are inserted and
+     * removed, and stored there, so numEntries() doesn't need to scan the index.
      */
     class KVSortedDataImpl : public SortedDataInterface {
         MONGO_DISALLOW_COPYING( KVSortedDataImpl );
     public:
-        KVSortedDataImpl( KVDictionary* db, OperationContext* opCtx, const IndexDescriptor *desc );
+        KVSortedDataImpl( KVDictionary* db, OperationContext* opCtx, const IndexDescriptor *desc,
+                          StringData ident, KVSizeStorer *sizeStorer );
+
+        virtual ~KVSortedDataImpl();
 
         virtual SortedDataBuilderInterface* getBulkBuilder(OperationContext* txn, bool dupsAllowed);
 
@@ -81,13 +96,41 @@ namespace mongo {
                               const RecordId& loc,
                               bool dupsAllowed);
 
+        virtual bool isClustering() const { return _isClustering; }
+
+        virtual Status insertWithDocument(OperationContext* txn,
+                                          const BSONObj& key,
+                                          const RecordId& loc,
+                                          const BSONObj& doc,
+                                          bool dupsAllowed);
+
+        virtual Status replaceDocument(OperationContext* txn,
+                                       const BSONObj& key,
+                                       const RecordId& loc,
+                                       const BSONObj& doc);
+
         virtual void unindex(OperationContext* txn, const BSONObj& key, const RecordId& loc, bool dupsAllowed);
 
         virtual Status dupKeyCheck(OperationContext* txn, const BSONObj& key, const RecordId& loc);
 
+        /**
+         * If the number of keys is tracked, only a full validate counts them, and corrects the
+         * tracked number if it was wrong and the collection is locked at least in MODE_S.
+         */
         virtual void fullValidate(OperationContext* txn, bool full, long long* numKeysOut,
                                   BSONObjBuilder* output) const;
 
+        /**
+         * Scans the index in ranges, several at a time.
+         */
+        virtual Status hashEntries(OperationContext* txn, uint64_t* hashOut) const;
+
+        /**
+         * Counts and hashes the keys in the same scan.
+         */
+        virtual Status fullValidateAndHash(OperationContext* txn, long long* numKeysOut,
+                                           uint64_t* hashOut, BSONObjBuilder* output) const;
+
         virtual bool isEmpty(OperationContext* txn);
 
         virtual long long numEntries(OperationContext* txn) const;
@@ -105,10 +148,40 @@ namespace mongo {
         static BSONObj extractKey(const Slice &key, const Slice &val, const Ordering &ordering);
         static RecordId extractRecordId(const Slice &s);
 
+        void undoUpdateNumEntries(long long delta);
+
     private:
-        // The KVDictionary interface used to store index keys, which map to empty values.
+        friend class KVSortedDataBuilderImpl;
+
+        // Count the keys with a cursor.
+        long long _countEntries(OperationContext* txn) const;
+
+        // A full validate, also hashing the keys if `hashOut' isn't NULL.
+        void _fullValidate(OperationContext* txn, long long* numKeysOut, uint64_t* hashOut,
+                           BSONObjBuilder* output) const;
+
+        // Count the keys, and hash them if `hashOut' isn't NULL, scanning ranges of the index
+        // in parallel.  Only for validate, which holds the collection lock.
+        Status _scanEntries(OperationContext* txn, long long* numEntriesOut, uint64_t* hashOut) const;
+
+        Status _insert(OperationContext* txn, const BSONObj& key, const RecordId& loc,
+                       const BSONObj* doc, bool dupsAllowed);
+
+    protected:
+        void _updateNumEntries(OperationContext* txn, long long delta);
+
+        // The KVDictionary interface used to store index keys, which map to their TypeBits, and
+        // for clustering indexes, the document.
         boost::scoped_ptr<KVDictionary> _db;
         const Ordering _ordering;
+        const bool _isClustering;
+
+        const std::string _ident;
+        // The collection's namespace, empty without an IndexDescriptor.
+        const std::string _ns;
+        KVSizeStorer *_sizeStorer;
+        // Only maintained if _sizeStorer is set.  A full validate may correct it.
+        mutable AtomicInt64 _numEntries;
     };
 
 } // namespace mongo
@@ -0,0 +1,152 @@
+// kv_sorted_data_partitioned.cpp
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include <algorithm>
+
+#include "mongo/db/operation_context.h"
+#include "mongo/db/storage/kv/dictionary/kv_engine_impl.h"
+#include "mongo/db/storage/kv/dictionary/kv_record_store_partitioned.h"
+#include "mongo/db/storage/kv/dictionary/kv_sorted_data_partitioned.h"
+#include "mongo/util/log.h"
+#include "mongo/util/mongoutils/str.h"
+
+namespace mongo {
+
+    KVSortedDataPartitioned::KVSortedDataPartitioned( KVEngineImpl *engine,
+                                                      KVPartitionedDictionary *db,
+                                                      const KVDictionary::Encoding &enc,
+                                                      const BSONObj &engineOptions,
+                                                      OperationContext* opCtx,
+                                                      const IndexDescriptor *desc,
+                                                      StringData ident,
+                                                      KVSizeStorer *sizeStorer )
+        : KVSortedDataImpl(db, opCtx, desc, ident, sizeStorer),
+          _engine(engine),
+          _enc(enc),
+          _engineOptions(engineOptions.getOwned())
+    {}
+
+    KVPartitionedDictionary *KVSortedDataPartitioned::_partitioned() const {
+        return static_cast<KVPartitionedDictionary *>(_db.get());
+    }
+
+    class KVSortedDataPartitioned::PartitionsChange : public RecoveryUnit::Change {
+    public:
+        PartitionsChange(OperationContext *txn, KVSortedDataPartitioned *index,
+                         const boost::shared_ptr<KVDictionary> &dropped, const std::string &droppedIdent)
+            : _txn(txn),
+              _index(index),
+              _oldPartitions(index->_partitioned()->partitions()),
+              _dropped(dropped),
+              _droppedIdent(droppedIdent)
+        {}
+
+        virtual void commit() {
+            if (!_dropped) {
+                return;
+            }
+
+            // Same as for the record store's partitions, a dictionary that detached cursors
+            // still hold open is left for the index's drop to remove.
+            _oldPartitions.clear();
+            _dropped.reset();
+            Status s = _index->_engine->dropKVDictionary(_txn, _droppedIdent);
+            if (!s.isOK()) {
+                warning() << "KVSortedDataPartitioned: couldn't drop partition " << _droppedIdent
+                          << ": " << s;
+            }
+        }
+
+        virtual void rollback() {
+            _index->_partitioned()->setPartitions(_oldPartitions);
+        }
+
+    private:
+        OperationContext *_txn;
+        KVSortedDataPartitioned *_index;
+        KVPartitionedDictionary::Partitions _oldPartitions;
+        boost::shared_ptr<KVDictionary> _dropped;
+        const std::string _droppedIdent;
+    };
+
+    Status KVSortedDataPartitioned::addPartition(OperationContext* txn, long long id,
+                                                 const RecordId& lastMax) {
+        const std::string ident = KVRecordStorePartitioned::partitionIdent(_ident, id);
+        Status s = _engine->createKVDictionary(txn, ident, _enc, _engineOptions);
+        if (!s.isOK()) {
+            return s;
+        }
+        boost::shared_ptr<KVDictionary> db(_engine->getKVDictionary(txn, ident, _enc, _engineOptions));
+
+        KVPartitionedDictionary::Partitions partitions(_partitioned()->partitions());
+        const KVPartitionedDictionary::Partition &last = partitions.back();
+        partitions.back() = KVPartitionedDictionary::Partition(last.id(), lastMax, last.db());
+        partitions.push_back(KVPartitionedDictionary::Partition(id, RecordId(), db));
+
+        LOG(1) << "KVSortedDataPartitioned: adding partition " << id << " to " << _ident;
+        txn->recoveryUnit()->registerChange(new PartitionsChange(txn, this, boost::shared_ptr<KVDictionary>(),
+                                                                 std::string()));
+        _partitioned()->setPartitions(partitions);
+        return Status::OK();
+    }
+
+    Status KVSortedDataPartitioned::dropPartition(OperationContext* txn, long long id) {
+        KVPartitionedDictionary::Partitions partitions(_partitioned()->partitions());
+        size_t idx = 0;
+        while (idx < partitions.size() && partitions[idx].id() != id) {
+            ++idx;
+        }
+        if (idx == partitions.size()) {
+            return Status(ErrorCodes::BadValue,
+                          str::stream() << "index " << _ident << " has no partition " << id);
+        }
+        if (idx == partitions.size() - 1) {
+            return Status(ErrorCodes::IllegalOperation,
+                          str::stream() << "can't drop the last partition of index " << _ident);
+        }
+
+        const boost::shared_ptr<KVDictionary> dropped = partitions[idx].db();
+        // Like the record store's, the count may only be an estimate.
+        const KVDictionary::Stats stats = dropped->getStats();
+        partitions.erase(partitions.begin() + idx);
+
+        LOG(1) << "KVSortedDataPartitioned: dropping partition " << id << " of " << _ident;
+        txn->recoveryUnit()->registerChange(new PartitionsChange(txn, this, dropped,
+                                                                 KVRecordStorePartitioned::partitionIdent(_ident, id)));
+        _partitioned()->setPartitions(partitions);
+
+        _updateNumEntries(txn, -std::min(static_cast<long long>(stats.numKeys), _numEntries.load()));
+        return Status::OK();
+    }
+
+} // namespace mongo
@@ -0,0 +1,85 @@
+// kv_sorted_data_partitioned.h
+
+/**
+*    Copyright (C) 2014 MongoDB Inc.
+*
+*    This program is free software: you can redistribute it and/or  modify
+*    it under the terms of the GNU Affero General Public License, version 3,
+*    as published by the Free Software Foundation.
+*
+*
+*    This program is distributed in the hope that it will be useful,
+*    but WITHOUT ANY WARRANTY; without even the implied warranty of
+*    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+*    GNU Affero General Public License for more details.
+*
+*    You should have received a copy of the GNU Affero General Public License
+*    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*    As a special exception, the copyright holders give permission to link the
+*    code of portions of this program with the OpenSSL library under certain
+*    conditions as described in each individual source file and distribute
+*    linked combinations including the program with the OpenSSL library. You
+*    must comply with the GNU Affero General Public License in all respects for
+*    all of the code used other than as permitted herein. If you modify file(s)
+*    with this exception, you may extend this exception to your version of the
+*    file(s), but you are not obligated to do so. If you do not wish to do so,
+*    delete this exception statement from your version. If you delete this
+*    exception statement from all source files in the program, then also delete
+*    it in the license file.
+*/
+
+#pragma once
+
+#include <string>
+
+#include "mongo/bson/bsonobj.h"
+#include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
+#include "mongo/db/storage/kv/dictionary/kv_partitioned_dictionary.h"
+#include "mongo/db/storage/kv/dictionary/kv_sorted_data_impl.h"
+
+namespace mongo {
+
+    class KVEngineImpl;
+
+    // Like a KVSortedDataImpl, but the entries are kept in a KVPartitionedDictionary split the
+    // same way as the collection's KVRecordStorePartitioned, so a partition's index entries go
+    // with it when it's dropped.
+    //
+    // The partition list isn't stored separately, it's the record store's: the index is opened
+    // with it, and the collection keeps the two in sync by calling addPartition() and
+    // dropPartition() in the same unit of work as the record store's.  Each partition is a
+    // dictionary named after the index's ident (see KVRecordStorePartitioned::partitionIdent()).
+    class KVSortedDataPartitioned : public KVSortedDataImpl {
+    public:
+        // KVSortedDataImpl takes ownership of db.
+        KVSortedDataPartitioned( KVEngineImpl *engine,
+                                 KVPartitionedDictionary *db,
+                                 const KVDictionary::Encoding &enc,
+                                 const BSONObj &engineOptions,
+                                 OperationContext* opCtx,
+                                 const IndexDescriptor *desc,
+                                 StringData ident,
+                                 KVSizeStorer *sizeStorer );
+
+        virtual ~KVSortedDataPartitioned() { }
+
+        virtual bool isPartitioned() const { return true; }
+
+        virtual Status addPartition(OperationContext* txn, long long id, const RecordId& lastMax);
+
+        virtual Status dropPartition(OperationContext* txn, long long id);
+
+    private:
+        class PartitionsChange;
+
+        KVPartitionedDictionary *_partitioned() const;
+
+        KVEngineImpl *_engine;
+
+        // What new partitions are created with.
+        const KVDictionary::Encoding _enc;
+        const BSONObj _engineOptions;
+    };
+
+} // namespace mongo
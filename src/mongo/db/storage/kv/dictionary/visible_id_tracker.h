@@ -31,7 +31,8 @@
 
 #pragma once
 
-#include <set>
+#include <algorithm>
+#include <vector>
 
 #include <boost/thread/mutex.hpp>
 
@@ -40,6 +41,7 @@
 #include "mongo/db/storage/kv/dictionary/kv_record_store.h"
 #include "mongo/db/storage/kv/dictionary/kv_recovery_unit.h"
 #include "mongo/db/storage/recovery_unit.h"
+#include "mongo/platform/atomic_word.h"
 
 namespace mongo {
 
@@ -67,13 +69,19 @@ namespace mongo {
         void setIteratorRestriction(KVRecoveryUnit *, KVRecordStore::KVRecordIterator *) const {}
     };
 
+    /**
+     * Tracks the ids that have been inserted into a capped collection but not yet committed or
+     * rolled back, so that forward iterators can stop before the first of them.
+     *
+     * Every capped insert, commit and rollback, and every forward iterator creation, goes
+     * through here, so there is no global lock.  Uncommitted ids are spread by id over
+     * kNumShards shards, each with its own mutex and a small sorted vector.  Each shard
+     * publishes its lowest id in an atomic, so lowestInvisible() never blocks.
+     */
     class CappedIdTracker : public VisibleIdTracker {
-    protected:
-        mutable boost::mutex _mutex;
-        std::set<RecordId> _uncommittedIds;
-        RecordId _highest;
-
     public:
+        static const size_t kNumShards = 16;
+
         CappedIdTracker(int64_t nextIdNum)
             : _highest(nextIdNum - 1)
         {}
@@ -87,18 +95,34 @@ namespace mongo {
         virtual void addUncommittedId(OperationContext *opCtx, const RecordId &id) {
             opCtx->recoveryUnit()->registerChange(new UncommittedIdChange(this, id));
 
-            boost::mutex::scoped_lock lk(_mutex);
-            _uncommittedIds.insert(id);
-            if (id > _highest) {
-                _highest = id;
+            Shard &shard = _shardFor(id);
+            {
+                boost::mutex::scoped_lock lk(shard.mutex);
+                // Ids are allocated in increasing order, so this is almost always an append.
+                shard.ids.insert(std::upper_bound(shard.ids.begin(), shard.ids.end(), id), id);
+                shard.lowest.store(shard.ids.front().repr());
+            }
+
+            // _highest may only pass this id once the id can be found in its shard, otherwise
+            // lowestInvisible() could return something above it.
+            long long highest = _highest.load();
+            while (id.repr() > highest) {
+                const long long seen = _highest.compareAndSwap(highest, id.repr());
+                if (seen == highest) {
+                    break;
+                }
+                highest = seen;
             }
         }
 
         virtual RecordId lowestInvisible() const {
-            boost::mutex::scoped_lock lk(_mutex);
-            return (_uncommittedIds.empty()
-                    ? RecordId(_highest.repr() + 1)
-                    : *_uncommittedIds.begin());
+            // _highest must be read before the shards: every uncommitted id at or below it is
+            // already in its shard by the time we look.
+            long long lowest = _highest.load() + 1;
+            for (size_t i = 0; i < kNumShards; ++i) {
+                lowest = std::min(lowest, _shards[i].lowest.load());
+            }
+            return RecordId(lowest);
         }
 
         virtual void setRecoveryUnitRestriction(KVRecoveryUnit *ru) const {}
@@ -127,11 +151,39 @@ namespace mongo {
         };
 
         void markIdVisible(const RecordId &id) {
-            boost::mutex::scoped_lock lk(_mutex);
-            _uncommittedIds.erase(id);
+            Shard &shard = _shardFor(id);
+            boost::mutex::scoped_lock lk(shard.mutex);
+            std::vector<RecordId>::iterator it =
+                    std::lower_bound(shard.ids.begin(), shard.ids.end(), id);
+            if (it != shard.ids.end() && *it == id) {
+                shard.ids.erase(it);
+            }
+            shard.lowest.store(shard.ids.empty()
+                               ? RecordId::max().repr()
+                               : shard.ids.front().repr());
         }
 
         friend class UncommittedIdChange;
+
+    private:
+        struct Shard {
+            Shard() : lowest(RecordId::max().repr()) {}
+
+            boost::mutex mutex;
+            // Sorted.  Only a handful of ids per shard are uncommitted at any time.
+            std::vector<RecordId> ids;
+            // ids.front(), or RecordId::max() if there are none.
+            AtomicInt64 lowest;
+            // Keeps neighboring shards' mutexes off each other's cache lines.
+            char pad[64];
+        };
+
+        Shard &_shardFor(const RecordId &id) {
+            return _shards[static_cast<uint64_t>(id.repr()) % kNumShards];
+        }
+
+        Shard _shards[kNumShards];
+        AtomicInt64 _highest;
     };
 
     class OplogIdTracker : public CappedIdTracker {
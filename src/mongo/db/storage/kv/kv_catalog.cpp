@@ -89,6 +89,62 @@ namespace {
         const Entry _entry;
     };
 
+    /**
+     * Publishes new metadata for a collection to the cache once it commits.  Until then, the
+     * collection's metadata is read from the record store, so other transactions never see it
+     * uncommitted, and the writer sees its own.
+     */
+    class KVCatalog::SetCachedMetaDataChange : public RecoveryUnit::Change {
+    public:
+        SetCachedMetaDataChange(KVCatalog* catalog, StringData ns, const RecordId& loc,
+                                const CachedMetaDataPtr& cached)
+            :_catalog(catalog), _ns(ns.toString()), _loc(loc), _cached(cached)
+        {}
+
+        virtual void commit() {
+            boost::mutex::scoped_lock lk(_catalog->_identsLock);
+            Entry* entry = _findEntry();
+            if (entry) {
+                entry->cached = _cached;
+                entry->version++;
+                entry->pendingWrites--;
+            }
+        }
+        virtual void rollback() {
+            boost::mutex::scoped_lock lk(_catalog->_identsLock);
+            Entry* entry = _findEntry();
+            if (entry) {
+                entry->version++;
+                entry->pendingWrites--;
+            }
+        }
+
+    private:
+        // The entry this change was made to, unless it was renamed or dropped since.
+        Entry* _findEntry() {
+            NSToIdentMap::iterator it = _catalog->_idents.find(_ns);
+            if (it == _catalog->_idents.end() ||
+                it->second.storedLoc != _loc ||
+                it->second.pendingWrites == 0) {
+                return NULL;
+            }
+            return &it->second;
+        }
+
+        KVCatalog* const _catalog;
+        const std::string _ns;
+        const RecordId _loc;
+        const CachedMetaDataPtr _cached;
+    };
+
+    KVCatalog::CachedMetaData::CachedMetaData( const BSONObj& o )
+        : obj( o.getOwned() ) {
+        const BSONElement mdElement = obj["md"];
+        if ( mdElement.isABSONObj() ) {
+            md.parse( mdElement.Obj() );
+        }
+    }
+
     KVCatalog::KVCatalog( RecordStore* rs,
                           bool isRsThreadSafe,
                           bool directoryPerDb,
@@ -198,6 +254,7 @@ namespace {
             return res.getStatus();
 
         old = Entry( ident, res.getValue() );
+        old.cached.reset( new CachedMetaData( obj ) );
         LOG(1) << "stored meta data for " << ns << " @ " << res.getValue();
         return Status::OK();
     }
@@ -212,11 +269,42 @@ namespace {
     std::string KVCatalog::getIndexIdent( OperationContext* opCtx,
                                           StringData ns,
                                           StringData idxName ) const {
-        BSONObj obj = _findEntry( opCtx, ns, NULL, true );
-        BSONObj idxIdent = obj["idxIdent"].Obj();
+        BSONObj idxIdent = _getCached( opCtx, ns )->obj["idxIdent"].Obj();
         return idxIdent[idxName].String();
     }
 
+    KVCatalog::CachedMetaDataPtr KVCatalog::_getCached( OperationContext* opCtx,
+                                                        StringData ns ) const {
+        unsigned long long version;
+        {
+            boost::mutex::scoped_lock lk( _identsLock );
+            NSToIdentMap::const_iterator it = _idents.find( ns.toString() );
+            invariant( it != _idents.end() );
+            if ( it->second.cached && it->second.pendingWrites == 0 ) {
+                return it->second.cached;
+            }
+            version = it->second.version;
+        }
+
+        BSONObj obj = _findEntry( opCtx, ns, NULL, true );
+        LOG(3) << " fetched CCE metadata: " << obj;
+        CachedMetaDataPtr cached( new CachedMetaData( obj ) );
+        if ( obj.isEmpty() ) {
+            // Not visible to this transaction, see _findEntry.
+            return cached;
+        }
+
+        boost::mutex::scoped_lock lk( _identsLock );
+        NSToIdentMap::const_iterator it = _idents.find( ns.toString() );
+        // If a writer got in while we were reading, what we read may already be stale, or not
+        // committed yet.
+        if ( it != _idents.end() && it->second.version == version &&
+             it->second.pendingWrites == 0 && !it->second.cached ) {
+            it->second.cached = cached;
+        }
+        return cached;
+    }
+
     BSONObj KVCatalog::_findEntry( OperationContext* opCtx,
                                    StringData ns,
                                    RecordId* out,
@@ -254,15 +342,22 @@ namespace {
 
     const BSONCollectionCatalogEntry::MetaData KVCatalog::getMetaData( OperationContext* opCtx,
                                                                        StringData ns ) {
-        BSONObj obj = _findEntry( opCtx, ns, NULL, true );
-        LOG(3) << " fetched CCE metadata: " << obj;
-        BSONCollectionCatalogEntry::MetaData md;
-        const BSONElement mdElement = obj["md"];
-        if ( mdElement.isABSONObj() ) {
-            LOG(3) << "returning metadata: " << mdElement;
-            md.parse( mdElement.Obj() );
-        }
-        return md;
+        return _getCached( opCtx, ns )->md;
+    }
+
+    boost::shared_ptr<const BSONCollectionCatalogEntry::MetaData> KVCatalog::getMetaDataSnapshot(
+            OperationContext* opCtx,
+            StringData ns ) const {
+        const CachedMetaDataPtr cached = _getCached( opCtx, ns );
+        // Shares ownership of the whole CachedMetaData.
+        return boost::shared_ptr<const BSONCollectionCatalogEntry::MetaData>( cached, &cached->md );
+    }
+
+    unsigned long long KVCatalog::getMetaDataVersion( StringData ns ) const {
+        boost::mutex::scoped_lock lk( _identsLock );
+        NSToIdentMap::const_iterator it = _idents.find( ns.toString() );
+        invariant( it != _idents.end() );
+        return it->second.version;
     }
 
     void KVCatalog::putMetaData( OperationContext* opCtx,
@@ -316,6 +411,14 @@ namespace {
                                                         NULL );
         fassert( 28521, status.getStatus() );
         invariant( status.getValue() == loc );
+
+        CachedMetaDataPtr cached( new CachedMetaData( obj ) );
+        boost::mutex::scoped_lock lk( _identsLock );
+        NSToIdentMap::iterator it = _idents.find( ns.toString() );
+        invariant( it != _idents.end() );
+        it->second.pendingWrites++;
+        opCtx->recoveryUnit()->registerChange(
+            new SetCachedMetaDataChange( this, ns, loc, cached ) );
     }
 
     Status KVCatalog::renameCollection( OperationContext* opCtx,
@@ -332,6 +435,7 @@ namespace {
 
         RecordId loc;
         BSONObj old = _findEntry( opCtx, fromNS, &loc, false ).getOwned();
+        BSONObj obj;
         {
             BSONObjBuilder b;
 
@@ -346,7 +450,7 @@ namespace {
 
             b.appendElementsUnique( old );
 
-            BSONObj obj = b.obj();
+            obj = b.obj();
             StatusWith<RecordId> status = _rs->updateRecord( opCtx,
                                                             loc,
                                                             obj.objdata(),
@@ -365,7 +469,9 @@ namespace {
         opCtx->recoveryUnit()->registerChange(new AddIdentChange(this, toNS));
 
         _idents.erase(fromIt);
-        _idents[toNS.toString()] = Entry( old["ident"].String(), loc );
+        Entry& entry = _idents[toNS.toString()];
+        entry = Entry( old["ident"].String(), loc );
+        entry.cached.reset( new CachedMetaData( obj ) );
 
         return Status::OK();
     }
@@ -34,6 +34,7 @@
 #include <string>
 
 #include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/mutex.hpp>
 
 #include "mongo/base/string_data.h"
@@ -76,6 +77,19 @@ namespace mongo {
 
         const BSONCollectionCatalogEntry::MetaData getMetaData( OperationContext* opCtx,
                                                                 StringData ns );
+
+        /**
+         * Like getMetaData(), but shares the parsed copy kept in memory instead of copying it.
+         * The snapshot never changes, later changes to the metadata replace it.
+         */
+        boost::shared_ptr<const BSONCollectionCatalogEntry::MetaData> getMetaDataSnapshot(
+                OperationContext* opCtx,
+                StringData ns ) const;
+
+        /**
+         * Changes whenever a change to the metadata for ns commits (or is rolled back).
+         */
+        unsigned long long getMetaDataVersion( StringData ns ) const;
         void putMetaData( OperationContext* opCtx,
                           StringData ns,
                           BSONCollectionCatalogEntry::MetaData& md );
@@ -95,6 +109,25 @@ namespace mongo {
     private:
         class AddIdentChange;
         class RemoveIdentChange;
+        class SetCachedMetaDataChange;
+
+        /**
+         * A collection's catalog document and its parsed metadata.  Never modified once built, so
+         * readers share it without copying or locking.
+         */
+        struct CachedMetaData {
+            explicit CachedMetaData( const BSONObj& obj );
+
+            BSONObj obj; // owned
+            BSONCollectionCatalogEntry::MetaData md;
+        };
+        typedef boost::shared_ptr<const CachedMetaData> CachedMetaDataPtr;
+
+        /**
+         * Returns the cached catalog document for ns, reading it from the record store first if
+         * nothing is cached yet, or instead if a write to it hasn't committed yet.
+         */
+        CachedMetaDataPtr _getCached( OperationContext* opCtx, StringData ns ) const;
 
         BSONObj _findEntry( OperationContext* opCtx,
                             StringData ns,
@@ -122,11 +155,18 @@ namespace mongo {
         AtomicUInt64 _next;
 
         struct Entry {
-            Entry(){}
+            Entry() : version( 0 ), pendingWrites( 0 ) {}
             Entry( std::string i, RecordId l )
-                : ident(i), storedLoc( l ) {}
+                : ident(i), storedLoc( l ), version( 0 ), pendingWrites( 0 ) {}
             std::string ident;
             RecordId storedLoc;
+
+            // Filled in by the first reader, replaced when writers commit.  All three are
+            // guarded by _identsLock.
+            mutable CachedMetaDataPtr cached;
+            mutable unsigned long long version;
+            // Uncommitted putMetaData() calls.  While there are any, the cache is bypassed.
+            unsigned pendingWrites;
         };
         typedef std::map<std::string,Entry> NSToIdentMap;
         NSToIdentMap _idents;
@@ -182,4 +182,9 @@ namespace mongo {
         return _catalog->getMetaData( txn, ns().toString() );
     }
 
+    boost::shared_ptr<const BSONCollectionCatalogEntry::MetaData>
+    KVCollectionCatalogEntry::_getMetaDataSnapshot( OperationContext* txn ) const {
+        return _catalog->getMetaDataSnapshot( txn, ns().toString() );
+    }
+
 }
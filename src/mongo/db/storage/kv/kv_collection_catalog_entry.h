@@ -86,6 +86,8 @@ namespace mongo {
     protected:
         virtual MetaData _getMetaData( OperationContext* txn ) const;
 
+        virtual boost::shared_ptr<const MetaData> _getMetaDataSnapshot( OperationContext* txn ) const;
+
     private:
         class AddIndexChange;
         class RemoveIndexChange;
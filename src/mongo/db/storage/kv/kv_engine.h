@@ -102,6 +102,11 @@ namespace mongo {
          */
         virtual bool supportsDocLocking() const = 0;
 
+        /**
+         * See StorageEngine::supportsBatchSnapshotReads.
+         */
+        virtual bool supportsBatchSnapshotReads() const { return false; }
+
         /**
          * Returns true if storage engine supports --directoryperdb.
          * See:
@@ -284,6 +284,70 @@ namespace mongo {
 
     }
 
+    TEST( KVCatalogTest, MetaDataCache ) {
+        scoped_ptr<KVHarnessHelper> helper( KVHarnessHelper::create() );
+        KVEngine* engine = helper->getEngine();
+
+        scoped_ptr<RecordStore> rs;
+        scoped_ptr<KVCatalog> catalog;
+        {
+            MyOperationContext opCtx( engine );
+            WriteUnitOfWork uow( &opCtx );
+            ASSERT_OK( engine->createRecordStore( &opCtx, "catalog", "catalog", CollectionOptions() ) );
+            rs.reset( engine->getRecordStore( &opCtx, "catalog", "catalog", CollectionOptions() ) );
+            catalog.reset( new KVCatalog( rs.get(), true, false, false) );
+            ASSERT_OK( catalog->newCollection( &opCtx, "a.b", CollectionOptions() ) );
+            uow.commit();
+        }
+
+        boost::shared_ptr<const BSONCollectionCatalogEntry::MetaData> before;
+        {
+            MyOperationContext opCtx( engine );
+            before = catalog->getMetaDataSnapshot( &opCtx, "a.b" );
+            ASSERT_EQUALS( 0U, before->indexes.size() );
+            // Readers share the same snapshot.
+            ASSERT( before == catalog->getMetaDataSnapshot( &opCtx, "a.b" ) );
+        }
+        const unsigned long long version = catalog->getMetaDataVersion( "a.b" );
+
+        BSONCollectionCatalogEntry::MetaData md;
+        md.ns = "a.b";
+        md.indexes.push_back( BSONCollectionCatalogEntry::IndexMetaData( BSON( "name" << "foo" ),
+                                                                         false,
+                                                                         RecordId(),
+                                                                         false ) );
+        {
+            // Rolled back, so readers still see the old metadata.
+            MyOperationContext opCtx( engine );
+            WriteUnitOfWork uow( &opCtx );
+            catalog->putMetaData( &opCtx, "a.b", md );
+            // The writer reads its own metadata, but nothing is published until it commits.
+            ASSERT_EQUALS( 1U, catalog->getMetaDataSnapshot( &opCtx, "a.b" )->indexes.size() );
+            ASSERT_EQUALS( version, catalog->getMetaDataVersion( "a.b" ) );
+        }
+        {
+            MyOperationContext opCtx( engine );
+            ASSERT( before == catalog->getMetaDataSnapshot( &opCtx, "a.b" ) );
+        }
+        ASSERT_NOT_EQUALS( version, catalog->getMetaDataVersion( "a.b" ) );
+
+        {
+            MyOperationContext opCtx( engine );
+            WriteUnitOfWork uow( &opCtx );
+            catalog->putMetaData( &opCtx, "a.b", md );
+            uow.commit();
+        }
+        {
+            MyOperationContext opCtx( engine );
+            boost::shared_ptr<const BSONCollectionCatalogEntry::MetaData> after =
+                catalog->getMetaDataSnapshot( &opCtx, "a.b" );
+            ASSERT_EQUALS( 1U, after->indexes.size() );
+            ASSERT_EQUALS( "foo", after->indexes[0].name() );
+            // The old snapshot is unchanged.
+            ASSERT_EQUALS( 0U, before->indexes.size() );
+        }
+    }
+
     TEST( KVCatalogTest, DirectoryPerDb1 ) {
         scoped_ptr<KVHarnessHelper> helper( KVHarnessHelper::create() );
         KVEngine* engine = helper->getEngine();
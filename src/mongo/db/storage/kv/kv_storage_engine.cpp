@@ -217,6 +217,10 @@ namespace mongo {
         return db;
     }
 
+    bool KVStorageEngine::supportsBatchSnapshotReads() const {
+        return _engine->supportsBatchSnapshotReads();
+    }
+
     Status KVStorageEngine::closeDatabase( OperationContext* txn, StringData db ) {
         // This is ok to be a no-op as there is no database layer in kv.
         return Status::OK();
@@ -77,6 +77,8 @@ namespace mongo {
 
         virtual bool supportsDocLocking() const { return _supportsDocLocking; }
 
+        virtual bool supportsBatchSnapshotReads() const;
+
         virtual Status closeDatabase( OperationContext* txn, StringData db );
 
         virtual Status dropDatabase( OperationContext* txn, StringData db );
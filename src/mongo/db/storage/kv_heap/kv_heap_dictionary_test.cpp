@@ -28,10 +28,20 @@
  *    it in the license file.
  */
 
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/operation_context_noop.h"
+#include "mongo/db/storage/key_string.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary_test_harness.h"
+#include "mongo/db/storage/kv/dictionary/kv_lazy_dictionary.h"
+#include "mongo/db/storage/kv/dictionary/kv_partitioned_dictionary.h"
+#include "mongo/db/storage/kv/dictionary/kv_sorted_data_impl.h"
 #include "mongo/db/storage/kv_heap/kv_heap_dictionary.h"
 #include "mongo/db/storage/kv_heap/kv_heap_recovery_unit.h"
 #include "mongo/db/storage/recovery_unit_noop.h"
+#include "mongo/unittest/unittest.h"
 
 namespace mongo {
 
@@ -55,4 +65,166 @@ namespace mongo {
     HarnessHelper* newHarnessHelper() {
         return new KVHeapDictionaryHarnessHelper();
     }
+
+    namespace {
+
+        class CountingHeapOpener : public KVLazyDictionary::Opener {
+            int &_opens;
+
+        public:
+            explicit CountingHeapOpener(int &opens) : _opens(opens) {}
+
+            virtual KVDictionary *open(OperationContext *opCtx) const {
+                _opens++;
+                return new KVHeapDictionary();
+            }
+        };
+
+        class CachedStatsHeapOpener : public CountingHeapOpener {
+        public:
+            explicit CachedStatsHeapOpener(int &opens) : CountingHeapOpener(opens) {}
+
+            virtual bool cachedStats(KVDictionary::Stats *stats) const {
+                stats->numKeys = 42;
+                return true;
+            }
+        };
+
+    }
+
+    TEST( KVLazyDictionary, OpensOnFirstUse ) {
+        KVDictionaryHandleCache cache( 0 );
+        int opens = 0;
+        KVLazyDictionary db( cache, "a", new CountingHeapOpener( opens ) );
+        ASSERT( !db.isOpen() );
+        ASSERT_EQUALS( 0, opens );
+
+        OperationContextNoop opCtx( new KVHeapRecoveryUnit() );
+        {
+            WriteUnitOfWork uow( &opCtx );
+            ASSERT_OK( db.insert( &opCtx, Slice::of("hi"), Slice::of("there"), false ) );
+            uow.commit();
+        }
+        Slice value;
+        ASSERT_OK( db.get( &opCtx, Slice::of("hi"), value ) );
+        ASSERT( value == Slice::of("there") );
+
+        ASSERT( db.isOpen() );
+        ASSERT_EQUALS( 1, opens );
+        ASSERT_EQUALS( 1U, cache.numOpen() );
+    }
+
+    TEST( KVLazyDictionary, ClosesLeastRecentlyUsed ) {
+        KVDictionaryHandleCache cache( 1 );
+        int opensA = 0;
+        int opensB = 0;
+        KVLazyDictionary a( cache, "a", new CountingHeapOpener( opensA ) );
+        KVLazyDictionary b( cache, "b", new CountingHeapOpener( opensB ) );
+
+        OperationContextNoop opCtx( new KVHeapRecoveryUnit() );
+        Slice value;
+        ASSERT_EQUALS( ErrorCodes::NoSuchKey, a.get( &opCtx, Slice::of("hi"), value ).code() );
+        ASSERT( a.isOpen() );
+
+        ASSERT_EQUALS( ErrorCodes::NoSuchKey, b.get( &opCtx, Slice::of("hi"), value ).code() );
+        ASSERT( !a.isOpen() );
+        ASSERT( b.isOpen() );
+        ASSERT_EQUALS( 1U, cache.numOpen() );
+
+        ASSERT_EQUALS( ErrorCodes::NoSuchKey, a.get( &opCtx, Slice::of("hi"), value ).code() );
+        ASSERT( a.isOpen() );
+        ASSERT( !b.isOpen() );
+        ASSERT_EQUALS( 2, opensA );
+        ASSERT_EQUALS( 1, opensB );
+    }
+
+    TEST( KVLazyDictionary, CursorKeepsDictionaryOpen ) {
+        KVDictionaryHandleCache cache( 1 );
+        int opensA = 0;
+        int opensB = 0;
+        KVLazyDictionary a( cache, "a", new CountingHeapOpener( opensA ) );
+        KVLazyDictionary b( cache, "b", new CountingHeapOpener( opensB ) );
+
+        OperationContextNoop opCtx( new KVHeapRecoveryUnit() );
+        {
+            WriteUnitOfWork uow( &opCtx );
+            ASSERT_OK( a.insert( &opCtx, Slice::of("hi"), Slice::of("there"), false ) );
+            uow.commit();
+        }
+
+        boost::scoped_ptr<KVDictionary::Cursor> cur( a.getCursor( &opCtx ) );
+        Slice value;
+        ASSERT_EQUALS( ErrorCodes::NoSuchKey, b.get( &opCtx, Slice::of("hi"), value ).code() );
+        ASSERT( !a.isOpen() );
+
+        // The cursor still reads the dictionary it was opened on.
+        ASSERT( cur->ok() );
+        ASSERT( cur->currKey() == Slice::of("hi") );
+        ASSERT( cur->currVal() == Slice::of("there") );
+        cur->advance( &opCtx );
+        ASSERT( !cur->ok() );
+    }
+
+    TEST( KVLazyDictionary, StatsFromOpenerWhileClosed ) {
+        KVDictionaryHandleCache cache( 0 );
+        int opens = 0;
+        KVLazyDictionary db( cache, "a", new CachedStatsHeapOpener( opens ) );
+        ASSERT_EQUALS( 42U, db.getStats().numKeys );
+        ASSERT( !db.isOpen() );
+        ASSERT_EQUALS( 0, opens );
+
+        // Once open, the real dictionary answers.
+        OperationContextNoop opCtx( new KVHeapRecoveryUnit() );
+        Slice value;
+        ASSERT_EQUALS( ErrorCodes::NoSuchKey, db.get( &opCtx, Slice::of("hi"), value ).code() );
+        ASSERT( db.isOpen() );
+        ASSERT_EQUALS( 0U, db.getStats().numKeys );
+    }
+
+    TEST( KVPartitionedDictionary, IndexCursorMergesPartitions ) {
+        const Ordering ordering = Ordering::make( BSON( "a" << 1 ) );
+        const KVDictionary::Encoding enc = KVDictionary::Encoding::forIndex( ordering );
+        boost::shared_ptr<KVDictionary> first( new KVHeapDictionary( enc ) );
+        boost::shared_ptr<KVDictionary> second( new KVHeapDictionary( enc ) );
+        KVPartitionedDictionary::Partitions partitions;
+        partitions.push_back( KVPartitionedDictionary::Partition( 0, RecordId( 10 ), first ) );
+        partitions.push_back( KVPartitionedDictionary::Partition( 1, RecordId(), second ) );
+        KVPartitionedDictionary db( "a", enc, partitions );
+
+        // In key order, with RecordIds alternating between the partitions.
+        const BSONObj keys[] = { BSON( "" << 1 ), BSON( "" << 2 ), BSON( "" << 3 ), BSON( "" << 4 ) };
+        const RecordId locs[] = { RecordId( 20 ), RecordId( 5 ), RecordId( 30 ), RecordId( 7 ) };
+
+        OperationContextNoop opCtx( new KVHeapRecoveryUnit() );
+        {
+            WriteUnitOfWork uow( &opCtx );
+            for ( int i = 0; i < 4; i++ ) {
+                ASSERT_OK( db.insert( &opCtx, Slice::of( KeyString( keys[i], ordering, locs[i] ) ),
+                                      Slice(), false ) );
+            }
+            uow.commit();
+        }
+        ASSERT_EQUALS( 2, first->getStats().numKeys );
+        ASSERT_EQUALS( 2, second->getStats().numKeys );
+
+        for ( int dir = 1; dir >= -1; dir -= 2 ) {
+            int i = dir > 0 ? 0 : 3;
+            for ( boost::scoped_ptr<KVDictionary::Cursor> c( db.getCursor( &opCtx, dir ) );
+                  c->ok(); c->advance( &opCtx ), i += dir ) {
+                ASSERT_EQUALS( locs[i], KVSortedDataImpl::extractRecordId( c->currKey() ) );
+            }
+            ASSERT_EQUALS( dir > 0 ? 4 : -1, i );
+        }
+
+        // A seek finds the next key in whichever partition has it.
+        boost::scoped_ptr<KVDictionary::Cursor> c(
+                db.getCursor( &opCtx, Slice::of( KeyString( keys[1], ordering, RecordId::min() ) ) ) );
+        ASSERT( c->ok() );
+        ASSERT_EQUALS( locs[1], KVSortedDataImpl::extractRecordId( c->currKey() ) );
+        c->advance( &opCtx );
+        ASSERT_EQUALS( locs[2], KVSortedDataImpl::extractRecordId( c->currKey() ) );
+
+        Slice value;
+        ASSERT_OK( db.get( &opCtx, Slice::of( KeyString( keys[3], ordering, locs[3] ) ), value ) );
+    }
 }
@@ -72,7 +72,7 @@ namespace mongo {
         return _map.find(ident) != _map.end();
     }
 
-    std::vector<std::string> KVHeapEngine::getAllIdents( OperationContext* opCtx ) const {
+    std::vector<std::string> KVHeapEngine::getAllKVDictionaryIdents( OperationContext* opCtx ) const {
         std::vector<std::string> idents;
         boost::mutex::scoped_lock lk(_mapMutex);
         for (HeapsMap::const_iterator it = _map.begin(); it != _map.end(); ++it) {
@@ -83,7 +83,7 @@ namespace mongo {
 
         bool hasIdent(OperationContext* opCtx, StringData ident) const;
 
-        std::vector<std::string> getAllIdents( OperationContext* opCtx ) const;
+        std::vector<std::string> getAllKVDictionaryIdents( OperationContext* opCtx ) const;
 
         void cleanShutdownImpl() {}
 
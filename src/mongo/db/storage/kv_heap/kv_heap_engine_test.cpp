@@ -29,7 +29,15 @@
  */
 
 #include "mongo/db/storage/kv/kv_engine_test_harness.h"
+
+#include <boost/scoped_ptr.hpp>
+
+#include "mongo/db/catalog/collection_options.h"
+#include "mongo/db/jsobj.h"
+#include "mongo/db/operation_context_noop.h"
 #include "mongo/db/storage/kv_heap/kv_heap_engine.h"
+#include "mongo/db/storage/record_store.h"
+#include "mongo/unittest/unittest.h"
 
 namespace mongo {
 
@@ -54,4 +62,91 @@ namespace mongo {
     KVHarnessHelper* KVHarnessHelper::create() {
         return new KVHeapEngineHarnessHelper();
     }
+
+    namespace {
+
+        int numPartitions(OperationContext* opCtx, RecordStore* rs) {
+            BSONObjBuilder b;
+            ASSERT_OK( rs->appendPartitionInfo( opCtx, &b ) );
+            return b.obj()["partitions"].Obj().nFields();
+        }
+
+    }
+
+    TEST( KVHeapEngine, PartitionedRecordStore ) {
+        KVHeapEngine engine;
+        OperationContextNoop opCtx( engine.newRecoveryUnit() );
+
+        const std::string ns = "a.b";
+        CollectionOptions options;
+        options.partitioned = true;
+        ASSERT_OK( engine.createRecordStore( &opCtx, ns, ns, options ) );
+        boost::scoped_ptr<RecordStore> rs( engine.getRecordStore( &opCtx, ns, ns, options ) );
+        ASSERT( rs->isPartitioned() );
+        ASSERT_EQUALS( 1, numPartitions( &opCtx, rs.get() ) );
+
+        // Nothing to split off yet.
+        long long id;
+        {
+            WriteUnitOfWork uow( &opCtx );
+            ASSERT_NOT_OK( rs->addPartition( &opCtx, &id ) );
+        }
+
+        std::vector<RecordId> locs;
+        for ( int i = 0; i < 5; i++ ) {
+            if ( i == 3 ) {
+                WriteUnitOfWork uow( &opCtx );
+                ASSERT_OK( rs->addPartition( &opCtx, &id ) );
+                ASSERT_EQUALS( 1, id );
+                uow.commit();
+            }
+            WriteUnitOfWork uow( &opCtx );
+            StatusWith<RecordId> res = rs->insertRecord( &opCtx, "abc", 4, false );
+            ASSERT_OK( res.getStatus() );
+            locs.push_back( res.getValue() );
+            uow.commit();
+        }
+        ASSERT_EQUALS( 2, numPartitions( &opCtx, rs.get() ) );
+        ASSERT_EQUALS( 5, rs->numRecords( &opCtx ) );
+
+        RecordId min;
+        RecordId max;
+        ASSERT_OK( rs->getPartitionBounds( &opCtx, 0, &min, &max ) );
+        ASSERT_EQUALS( locs[2], max );
+
+        // The last partition always stays.
+        {
+            WriteUnitOfWork uow( &opCtx );
+            ASSERT_NOT_OK( rs->dropPartition( &opCtx, 1 ) );
+        }
+
+        {
+            WriteUnitOfWork uow( &opCtx );
+            ASSERT_OK( rs->dropPartition( &opCtx, 0 ) );
+            uow.commit();
+        }
+        ASSERT_EQUALS( 1, numPartitions( &opCtx, rs.get() ) );
+        ASSERT_EQUALS( 2, rs->numRecords( &opCtx ) );
+        {
+            boost::scoped_ptr<RecordIterator> it( rs->getIterator( &opCtx ) );
+            ASSERT_EQUALS( locs[3], it->getNext() );
+            ASSERT_EQUALS( locs[4], it->getNext() );
+            ASSERT( it->isEOF() );
+        }
+        RecordData rd;
+        ASSERT( !rs->findRecord( &opCtx, locs[0], &rd ) );
+
+        // Partitions are not separate idents as far as the catalog is concerned.
+        std::vector<std::string> idents = engine.getAllIdents( &opCtx );
+        ASSERT_EQUALS( 1U, idents.size() );
+        ASSERT_EQUALS( ns, idents[0] );
+
+        // A rolled back add leaves the partitions as they were.
+        {
+            WriteUnitOfWork uow( &opCtx );
+            ASSERT_OK( rs->addPartition( &opCtx, &id ) );
+            ASSERT_EQUALS( 2, numPartitions( &opCtx, rs.get() ) );
+        }
+        ASSERT_EQUALS( 1, numPartitions( &opCtx, rs.get() ) );
+    }
 }
@@ -138,6 +138,11 @@ namespace mongo {
             return new KVHeapRecoveryUnit();
         }
 
+        virtual KVRecoveryUnit *newSharedSnapshotRecoveryUnit(OperationContext *opCtx) {
+            // No snapshots, every recovery unit reads the same thing.
+            return new KVHeapRecoveryUnit();
+        }
+
         virtual bool hasSnapshot() const {
             // not a doc-level locking engine
             invariant(false);
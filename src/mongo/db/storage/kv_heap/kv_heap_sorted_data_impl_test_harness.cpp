@@ -26,11 +26,16 @@
  *    it in the license file.
  */
 
+#include <boost/scoped_ptr.hpp>
+
+#include "mongo/db/index/index_descriptor.h"
 #include "mongo/db/storage/index_entry_comparison.h"
+#include "mongo/db/storage/kv/dictionary/kv_size_storer.h"
 #include "mongo/db/storage/kv/dictionary/kv_sorted_data_impl.h"
 #include "mongo/db/storage/kv_heap/kv_heap_dictionary.h"
 #include "mongo/db/storage/kv_heap/kv_heap_recovery_unit.h"
 #include "mongo/db/storage/sorted_data_interface_test_harness.h"
+#include "mongo/unittest/unittest.h"
 
 namespace mongo {
 
@@ -40,7 +45,7 @@ namespace mongo {
             std::auto_ptr<OperationContext> opCtx(newOperationContext());
             IndexEntryComparison iec(Ordering::make(BSONObj()));
             std::auto_ptr<KVDictionary> db(new KVHeapDictionary(KVDictionary::Encoding::forIndex(Ordering::make(BSONObj()))));
-            return new KVSortedDataImpl(db.release(), opCtx.get(), NULL);
+            return new KVSortedDataImpl(db.release(), opCtx.get(), NULL, "", NULL);
         }
 
         virtual RecoveryUnit* newRecoveryUnit() {
@@ -51,4 +56,152 @@ namespace mongo {
     HarnessHelper* newHarnessHelper() {
         return new KVSortedDataImplHarness();
     }
+
+    TEST( KVSortedDataImpl, Clustering ) {
+        boost::scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        boost::scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+
+        IndexDescriptor desc( NULL, "", BSON( "key" << BSON( "a" << 1 ) <<
+                                              "name" << "a_1" <<
+                                              "ns" << "test.clustering" <<
+                                              "clustering" << true ) );
+        KVSortedDataImpl sorted( new KVHeapDictionary(KVDictionary::Encoding::forIndex(Ordering::make(desc.keyPattern()))),
+                                 opCtx.get(), &desc, "", NULL );
+        ASSERT( sorted.isClustering() );
+
+        // One key with all-zero TypeBits and one without.
+        const BSONObj doc1 = BSON( "_id" << 1 << "a" << 5.0 << "b" << "x" );
+        const BSONObj doc2 = BSON( "_id" << 2 << "a" << 6 << "b" << "y" );
+        {
+            WriteUnitOfWork uow( opCtx.get() );
+            ASSERT_OK( sorted.insertWithDocument( opCtx.get(), BSON( "" << 5.0 ), RecordId( 1 ), doc1, true ) );
+            ASSERT_OK( sorted.insertWithDocument( opCtx.get(), BSON( "" << 6 ), RecordId( 2 ), doc2, true ) );
+            uow.commit();
+        }
+
+        {
+            boost::scoped_ptr<SortedDataInterface::Cursor> cursor( sorted.newCursor( opCtx.get(), 1 ) );
+            cursor->locate( BSON( "" << 5.0 ), RecordId() );
+            ASSERT( !cursor->isEOF() );
+            ASSERT_EQUALS( cursor->getRecordId(), RecordId( 1 ) );
+            ASSERT_EQUALS( cursor->getDocument(), doc1 );
+            cursor->advance();
+            ASSERT( !cursor->isEOF() );
+            ASSERT_EQUALS( cursor->getKey(), BSON( "" << 6 ) );
+            ASSERT_EQUALS( cursor->getDocument(), doc2 );
+        }
+
+        const BSONObj newDoc2 = BSON( "_id" << 2 << "a" << 6 << "b" << "z" );
+        {
+            WriteUnitOfWork uow( opCtx.get() );
+            ASSERT_OK( sorted.replaceDocument( opCtx.get(), BSON( "" << 6 ), RecordId( 2 ), newDoc2 ) );
+            uow.commit();
+        }
+
+        {
+            boost::scoped_ptr<SortedDataInterface::Cursor> cursor( sorted.newCursor( opCtx.get(), 1 ) );
+            cursor->locate( BSON( "" << 6 ), RecordId() );
+            ASSERT( !cursor->isEOF() );
+            ASSERT_EQUALS( cursor->getDocument(), newDoc2 );
+        }
+        ASSERT_EQUALS( sorted.numEntries( opCtx.get() ), 2 );
+    }
+
+    TEST( KVSortedDataImpl, TracksNumEntries ) {
+        boost::scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        boost::scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+
+        KVHeapDictionary metadataDict;
+        KVSizeStorer sizeStorer( &metadataDict, new KVHeapRecoveryUnit() );
+        sizeStorer.loadFromDict( opCtx.get() );
+
+        KVSortedDataImpl sorted( new KVHeapDictionary(KVDictionary::Encoding::forIndex(Ordering::make(BSONObj()))),
+                                 opCtx.get(), NULL, "index-1", &sizeStorer );
+        ASSERT_EQUALS( sorted.numEntries( opCtx.get() ), 0 );
+
+        {
+            WriteUnitOfWork uow( opCtx.get() );
+            ASSERT_OK( sorted.insert( opCtx.get(), BSON( "" << 1 ), RecordId( 1 ), true ) );
+            ASSERT_OK( sorted.insert( opCtx.get(), BSON( "" << 2 ), RecordId( 2 ), true ) );
+            uow.commit();
+        }
+        ASSERT_EQUALS( sorted.numEntries( opCtx.get() ), 2 );
+
+        {
+            // Rolled back, so not counted.
+            WriteUnitOfWork uow( opCtx.get() );
+            ASSERT_OK( sorted.insert( opCtx.get(), BSON( "" << 3 ), RecordId( 3 ), true ) );
+            sorted.unindex( opCtx.get(), BSON( "" << 1 ), RecordId( 1 ), true );
+        }
+        ASSERT_EQUALS( sorted.numEntries( opCtx.get() ), 2 );
+
+        {
+            WriteUnitOfWork uow( opCtx.get() );
+            sorted.unindex( opCtx.get(), BSON( "" << 1 ), RecordId( 1 ), true );
+            uow.commit();
+        }
+        ASSERT_EQUALS( sorted.numEntries( opCtx.get() ), 1 );
+
+        {
+            // Inserts are blind, so inserting an existing entry again counts it again.
+            WriteUnitOfWork uow( opCtx.get() );
+            ASSERT_OK( sorted.insert( opCtx.get(), BSON( "" << 2 ), RecordId( 2 ), true ) );
+            uow.commit();
+        }
+        ASSERT_EQUALS( sorted.numEntries( opCtx.get() ), 2 );
+
+        // A full validate corrects the count.
+        long long numKeys = 0;
+        sorted.fullValidate( opCtx.get(), true, &numKeys, NULL );
+        ASSERT_EQUALS( numKeys, 1 );
+        ASSERT_EQUALS( sorted.numEntries( opCtx.get() ), 1 );
+
+        sizeStorer.storeIntoDict( opCtx.get() );
+        long long storedNumKeys = 0;
+        long long unused = 0;
+        ASSERT( sizeStorer.load( "index-1", &storedNumKeys, &unused ) );
+        ASSERT_EQUALS( storedNumKeys, 1 );
+    }
+
+    TEST( KVSortedDataImpl, HashEntries ) {
+        boost::scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        boost::scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+        boost::scoped_ptr<SortedDataInterface> sorted( harnessHelper->newSortedDataInterface( false ) );
+
+        uint64_t hash = 1;
+        ASSERT_OK( sorted->hashEntries( opCtx.get(), &hash ) );
+        ASSERT_EQUALS( hash, 0U );
+
+        {
+            WriteUnitOfWork uow( opCtx.get() );
+            ASSERT_OK( sorted->insert( opCtx.get(), BSON( "" << 1 ), RecordId( 1 ), true ) );
+            ASSERT_OK( sorted->insert( opCtx.get(), BSON( "" << 1 ), RecordId( 2 ), true ) );
+            ASSERT_OK( sorted->insert( opCtx.get(), BSON( "" << "a" ), RecordId( 1 ), true ) );
+            uow.commit();
+        }
+
+        // The order entries are hashed in doesn't matter.
+        const uint64_t expected = SortedDataInterface::hashEntry( BSON( "" << "a" ), RecordId( 1 ) ) +
+                                  SortedDataInterface::hashEntry( BSON( "" << 1 ), RecordId( 2 ) ) +
+                                  SortedDataInterface::hashEntry( BSON( "" << 1 ), RecordId( 1 ) );
+        ASSERT_OK( sorted->hashEntries( opCtx.get(), &hash ) );
+        ASSERT_EQUALS( hash, expected );
+
+        // Validate counts and hashes the entries in the same scan.
+        long long numKeys = 0;
+        uint64_t validateHash = 0;
+        ASSERT_OK( sorted->fullValidateAndHash( opCtx.get(), &numKeys, &validateHash, NULL ) );
+        ASSERT_EQUALS( numKeys, 3 );
+        ASSERT_EQUALS( validateHash, expected );
+
+        // A different id for the same key changes the hash.
+        {
+            WriteUnitOfWork uow( opCtx.get() );
+            sorted->unindex( opCtx.get(), BSON( "" << 1 ), RecordId( 2 ), true );
+            ASSERT_OK( sorted->insert( opCtx.get(), BSON( "" << 1 ), RecordId( 3 ), true ) );
+            uow.commit();
+        }
+        ASSERT_OK( sorted->hashEntries( opCtx.get(), &hash ) );
+        ASSERT_NOT_EQUALS( hash, expected );
+    }
 }
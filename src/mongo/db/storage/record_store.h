@@ -161,8 +161,36 @@ namespace mongo {
                                  RecordData* out,
                                  bool skipPessimisticLocking=false ) const = 0;
 
+        /**
+         * Looks up many records at once.  Engines that can fetch nearby records together should
+         * override this, the default just calls findRecord() for each one.
+         *
+         * @param out - resized to locs.size(); out[i] is set to the contents of locs[i] if it
+         *              exists, and to an empty RecordData (data() == NULL) otherwise.
+         */
+        virtual void findRecords( OperationContext* txn,
+                                  const std::vector<RecordId>& locs,
+                                  std::vector<RecordData>* out ) const {
+            out->clear();
+            out->resize(locs.size());
+            for (size_t i = 0; i < locs.size(); ++i) {
+                findRecord(txn, locs[i], &(*out)[i]);
+            }
+        }
+
         virtual void deleteRecord( OperationContext* txn, const RecordId& dl ) = 0;
 
+        /**
+         * Like deleteRecord above, for callers that already know the size of the record (usually
+         * because they just read it).  Record stores that would otherwise have to read the record
+         * just to learn its size can then delete it blindly.
+         *
+         * @param oldSize - the size of the record as it is in this transaction's snapshot
+         */
+        virtual void deleteRecord( OperationContext* txn, const RecordId& dl, int oldSize ) {
+            deleteRecord( txn, dl );
+        }
+
         virtual StatusWith<RecordId> insertRecord( OperationContext* txn,
                                                   const char* data,
                                                   int len,
@@ -188,6 +216,24 @@ namespace mongo {
                                                   bool enforceQuota,
                                                   UpdateNotifier* notifier ) = 0;
 
+        /**
+         * Like updateRecord above, for callers that already have the record's current contents
+         * (usually because they just read it).  Record stores that would otherwise have to read
+         * the old record themselves, or that can write just the difference between the old and
+         * new records, should override this.
+         *
+         * @param oldRec - the record as it is in this transaction's snapshot
+         */
+        virtual StatusWith<RecordId> updateRecord( OperationContext* txn,
+                                                  const RecordId& oldLocation,
+                                                  const RecordData& oldRec,
+                                                  const char* data,
+                                                  int len,
+                                                  bool enforceQuota,
+                                                  UpdateNotifier* notifier ) {
+            return updateRecord( txn, oldLocation, data, len, enforceQuota, notifier );
+        }
+
         /**
          * @return Returns 'false' if this record store does not implement
          * 'updatewithDamages'. If this method returns false, 'updateWithDamages' must not be
@@ -326,6 +372,48 @@ namespace mongo {
                           "this storage engine does not support touch");
         }
 
+        /**
+         * A partitioned record store keeps its records in a sequence of partitions split by
+         * RecordId, and can drop the oldest of them much more cheaply than deleting the records.
+         */
+        virtual bool isPartitioned() const { return false; }
+
+        /**
+         * Cap the last partition at the greatest RecordId handed out so far, and start a new one
+         * for records inserted from now on, setting 'newId' to its id.
+         */
+        virtual Status addPartition( OperationContext* txn, long long* newId ) {
+            return Status(ErrorCodes::CommandNotSupported,
+                          "this record store is not partitioned");
+        }
+
+        /**
+         * Drop the partition with the given id and every record in it.  The last partition
+         * can't be dropped.
+         */
+        virtual Status dropPartition( OperationContext* txn, long long id ) {
+            return Status(ErrorCodes::CommandNotSupported,
+                          "this record store is not partitioned");
+        }
+
+        /**
+         * Set `min' and `max' to the first and last RecordId the partition with the given id can
+         * hold.
+         */
+        virtual Status getPartitionBounds( OperationContext* txn, long long id,
+                                           RecordId* min, RecordId* max ) const {
+            return Status(ErrorCodes::CommandNotSupported,
+                          "this record store is not partitioned");
+        }
+
+        /**
+         * Append the id and bounds of each partition to `output'.
+         */
+        virtual Status appendPartitionInfo( OperationContext* txn, BSONObjBuilder* output ) const {
+            return Status(ErrorCodes::CommandNotSupported,
+                          "this record store is not partitioned");
+        }
+
         /**
          * Return the RecordId of an oplog entry as close to startingPosition as possible without
          * being higher. If there are no entries <= startingPosition, return RecordId().
@@ -385,5 +473,14 @@ namespace mongo {
         virtual ~ValidateAdaptor(){}
 
         virtual Status validate( const RecordData& recordData, size_t* dataSize ) = 0;
+
+        /**
+         * Like validate(), for record stores that also pass the record's id.  Record stores that
+         * validate in parallel may call this from several threads at once.
+         */
+        virtual Status validateRecord( const RecordId& id, const RecordData& recordData,
+                                       size_t* dataSize ) {
+            return validate( recordData, dataSize );
+        }
     };
 }
@@ -90,6 +90,49 @@ namespace mongo {
         }
     }
 
+    // Insert a record and delete it, telling the record store its size.
+    TEST( RecordStoreTestHarness, DeleteRecordWithKnownSize ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<RecordStore> rs( harnessHelper->newNonCappedRecordStore() );
+
+        string data = "my record";
+        RecordId loc;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                StatusWith<RecordId> res = rs->insertRecord( opCtx.get(),
+                                                            data.c_str(),
+                                                            data.size() + 1,
+                                                            false );
+                ASSERT_OK( res.getStatus() );
+                loc = res.getValue();
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            ASSERT_EQUALS( 1, rs->numRecords( opCtx.get() ) );
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                rs->deleteRecord( opCtx.get(), loc, data.size() + 1 );
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            ASSERT_EQUALS( 0, rs->numRecords( opCtx.get() ) );
+            RecordData rd;
+            ASSERT( !rs->findRecord( opCtx.get(), loc, &rd ) );
+        }
+    }
+
     // Insert multiple records and try to delete them.
     TEST( RecordStoreTestHarness, DeleteMultipleRecords ) {
         scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
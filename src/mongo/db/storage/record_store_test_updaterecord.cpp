@@ -102,6 +102,58 @@ namespace mongo {
         }
     }
 
+    // Insert a big document and update a small part of it, passing the old record.
+    TEST( RecordStoreTestHarness, UpdateRecordWithOldRecord ) {
+        scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
+        scoped_ptr<RecordStore> rs( harnessHelper->newNonCappedRecordStore() );
+
+        const string filler(4096, 'x');
+        const BSONObj oldObj = BSON( "a" << 1 << "filler" << filler << "b" << "old" );
+        RecordId loc;
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                StatusWith<RecordId> res = rs->insertRecord( opCtx.get(),
+                                                            oldObj.objdata(),
+                                                            oldObj.objsize(),
+                                                            false );
+                ASSERT_OK( res.getStatus() );
+                loc = res.getValue();
+                uow.commit();
+            }
+        }
+
+        const BSONObj newObj = BSON( "a" << 1 << "filler" << filler << "b" << "newer" );
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                WriteUnitOfWork uow( opCtx.get() );
+                RecordData oldRec = rs->dataFor( opCtx.get(), loc );
+                StatusWith<RecordId> res = rs->updateRecord( opCtx.get(),
+                                                            loc,
+                                                            oldRec,
+                                                            newObj.objdata(),
+                                                            newObj.objsize(),
+                                                            false,
+                                                            NULL );
+                ASSERT_OK( res.getStatus() );
+                loc = res.getValue();
+                uow.commit();
+            }
+        }
+
+        {
+            scoped_ptr<OperationContext> opCtx( harnessHelper->newOperationContext() );
+            {
+                RecordData record = rs->dataFor( opCtx.get(), loc );
+                ASSERT_EQUALS( newObj.objsize(), record.size() );
+                ASSERT_EQUALS( newObj, record.toBson() );
+                ASSERT_EQUALS( 1, rs->numRecords( opCtx.get() ) );
+            }
+        }
+    }
+
     // Insert multiple records and try to update them.
     TEST( RecordStoreTestHarness, UpdateMultipleRecords ) {
         scoped_ptr<HarnessHelper> harnessHelper( newHarnessHelper() );
@@ -98,6 +98,36 @@ namespace mongo {
                               const RecordId& loc,
                               bool dupsAllowed) = 0;
 
+        /**
+         * Return true if 'this' index keeps a copy of the document with each entry, in which
+         * case callers should use insertWithDocument() and cursors can return the document
+         * without fetching it from the record store.
+         */
+        virtual bool isClustering() const { return false; }
+
+        /**
+         * Like insert(), but also stores 'doc' with the entry if 'this' index is clustering.
+         */
+        virtual Status insertWithDocument(OperationContext* txn,
+                                          const BSONObj& key,
+                                          const RecordId& loc,
+                                          const BSONObj& doc,
+                                          bool dupsAllowed) {
+            return insert(txn, key, loc, dupsAllowed);
+        }
+
+        /**
+         * Replaces the document stored with the existing entry (key, loc) of a clustering index,
+         * for updates that don't change the entry.  Unlike insertWithDocument(), this doesn't
+         * count a new entry.  Does nothing if 'this' index isn't clustering.
+         */
+        virtual Status replaceDocument(OperationContext* txn,
+                                       const BSONObj& key,
+                                       const RecordId& loc,
+                                       const BSONObj& doc) {
+            return Status::OK();
+        }
+
         /**
          * Remove the entry from the index with the specified key and RecordId.
          *
@@ -135,6 +165,47 @@ namespace mongo {
         virtual void fullValidate(OperationContext* txn, bool full, long long* numKeysOut,
                                   BSONObjBuilder* output) const = 0;
 
+        /**
+         * Sums hashEntry() over every entry into '*hashOut', so validate can check an index
+         * against its collection without looking entries up one at a time.
+         *
+         * Returns ErrorCodes::CommandNotSupported if this implementation can't.
+         */
+        virtual Status hashEntries(OperationContext* txn, uint64_t* hashOut) const {
+            return Status(ErrorCodes::CommandNotSupported, "index can't hash its entries");
+        }
+
+        /**
+         * A full fullValidate() and hashEntries() together, which implementations can do in one
+         * pass over the index.
+         *
+         * Returns what hashEntries() does; '*numKeysOut' is set either way.
+         */
+        virtual Status fullValidateAndHash(OperationContext* txn, long long* numKeysOut,
+                                           uint64_t* hashOut, BSONObjBuilder* output) const {
+            fullValidate(txn, true, numKeysOut, output);
+            return hashEntries(txn, hashOut);
+        }
+
+        /**
+         * The hash of one entry for hashEntries().  Sums of these don't depend on the order
+         * entries are visited in.
+         */
+        static uint64_t hashEntry(const BSONObj& key, const RecordId& loc) {
+            // FNV-1a over the key's bytes, then the RecordId mixed in with the splitmix64
+            // finalizer so that nearby ids don't cancel out when summed.
+            uint64_t h = 14695981039346656037ULL;
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(key.objdata());
+            for (int i = 0; i < key.objsize(); i++) {
+                h ^= p[i];
+                h *= 1099511628211ULL;
+            }
+            h ^= static_cast<uint64_t>(loc.repr());
+            h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ULL;
+            h = (h ^ (h >> 27)) * 0x94d049bb133111ebULL;
+            return h ^ (h >> 31);
+        }
+
         virtual bool appendCustomStats(OperationContext* txn, BSONObjBuilder* output, double scale)
             const = 0;
 
@@ -178,6 +249,31 @@ namespace mongo {
             return x;
         }
 
+        /**
+         * A partitioned index keeps its entries in the same partitions as its collection's
+         * partitioned record store (see RecordStore::isPartitioned()), by RecordId, so they can
+         * be dropped along with a partition.
+         */
+        virtual bool isPartitioned() const { return false; }
+
+        /**
+         * Follow the record store adding a partition: cap the last partition at 'lastMax', and
+         * start a new one with the given id.
+         */
+        virtual Status addPartition(OperationContext* txn, long long id, const RecordId& lastMax) {
+            return Status(ErrorCodes::CommandNotSupported,
+                          "this index is not partitioned");
+        }
+
+        /**
+         * Follow the record store dropping the partition with the given id, and every entry in
+         * it.
+         */
+        virtual Status dropPartition(OperationContext* txn, long long id) {
+            return Status(ErrorCodes::CommandNotSupported,
+                          "this index is not partitioned");
+        }
+
         /**
          * Navigation
          *
@@ -305,6 +401,22 @@ namespace mongo {
              */
             virtual void advance() = 0;
 
+            /**
+             * Tell 'this' cursor that the caller will stop once it passes 'key' in its direction,
+             * or once it reaches 'key' if !inclusive.  Must be called before the cursor is
+             * positioned.  An empty key means there is no end.
+             *
+             * This is only a hint, implementations may use it to avoid reading ahead past the end
+             * of the scan.  Callers must still check for the end themselves.
+             */
+            virtual void setEndPosition(const BSONObj& key, bool inclusive) { }
+
+            /**
+             * Return the document stored with the current entry of a clustering index (an owned
+             * copy), or an empty object if there isn't one.
+             */
+            virtual BSONObj getDocument() const { return BSONObj(); }
+
             //
             // Saving and restoring state
             //
@@ -147,6 +147,13 @@ namespace mongo {
          */
         virtual bool supportsDocLocking() const = 0;
 
+        /**
+         * Returns whether the engine only starts readers' snapshots while holding
+         * Lock::SnapshotGate shared when it is active, which lets a secondary apply a batch
+         * without blocking readers.
+         */
+        virtual bool supportsBatchSnapshotReads() const { return false; }
+
         /**
          * Returns if the engine supports a journalling concept.
          * This controls whether awaitCommit gets called or fsync to ensure data is on disk.
@@ -30,6 +30,9 @@
 
 #define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
 
+#include <boost/bind.hpp>
+
+#include "mongo/bson/bsonobjbuilder.h"
 #include "mongo/db/storage/tokuft/tokuft_capped_delete_range_optimizer.h"
 #include "mongo/db/storage/tokuft/tokuft_dictionary.h"
 #include "mongo/db/storage/tokuft/tokuft_errors.h"
@@ -39,39 +42,96 @@
 namespace mongo {
 
     const KeyString TokuFTCappedDeleteRangeOptimizer::kNegativeInfinity(RecordId::min());
+    const int64_t TokuFTCappedDeleteRangeOptimizer::lowWatermark;
+    const int64_t TokuFTCappedDeleteRangeOptimizer::highWatermark;
 
-    namespace {
-
-        int MAGIC = 321123;
-
+    TokuFTCappedDeleteOptimizerPool::TokuFTCappedDeleteOptimizerPool(int numWorkers)
+        : _running(true),
+          _numActive(0),
+          _numOptimizes(0),
+          _optimizedBytes(0),
+          _optimizeMicros(0),
+          _numBackpressureWaits(0),
+          _backpressureMicros(0)
+    {
+        invariant(numWorkers > 0);
+        for (int i = 0; i < numWorkers; ++i) {
+            _workers.push_back(boost::shared_ptr<boost::thread>(
+                    new boost::thread(boost::bind(&TokuFTCappedDeleteOptimizerPool::run, this))));
+        }
     }
 
-    TokuFTCappedDeleteRangeOptimizer::TokuFTCappedDeleteRangeOptimizer(const ftcxx::DB &db)
-        : _magic(MAGIC),
-          _db(db),
-          _max(),
-          _unoptimizableSize(0),
-          _optimizableSize(0),
-          _running(true),
-          _terminated(false),
-          _thread(boost::bind(&TokuFTCappedDeleteRangeOptimizer::run, this))
-    {}
+    TokuFTCappedDeleteOptimizerPool::~TokuFTCappedDeleteOptimizerPool() {
+        shutdown();
+    }
 
-    TokuFTCappedDeleteRangeOptimizer::~TokuFTCappedDeleteRangeOptimizer() {
+    void TokuFTCappedDeleteOptimizerPool::shutdown() {
         {
             boost::mutex::scoped_lock lk(_mutex);
+            if (!_running) {
+                return;
+            }
             _running = false;
-            _updateCond.notify_one();
+            _workCond.notify_all();
+            // Deleters waiting on backpressure would otherwise wait forever.
+            for (std::set<TokuFTCappedDeleteRangeOptimizer *>::const_iterator it = _optimizers.begin();
+                 it != _optimizers.end(); ++it) {
+                (*it)->_backpressureCond.notify_all();
+            }
         }
 
-        {
-            boost::mutex::scoped_lock lk(_mutex);
-            while (!_terminated) {
-                _updateCond.wait(lk);
+        for (size_t i = 0; i < _workers.size(); ++i) {
+            _workers[i]->join();
+        }
+        _workers.clear();
+    }
+
+    TokuFTCappedDeleteRangeOptimizer *TokuFTCappedDeleteOptimizerPool::_pickLocked() const {
+        TokuFTCappedDeleteRangeOptimizer *best = NULL;
+        for (std::set<TokuFTCappedDeleteRangeOptimizer *>::const_iterator it = _optimizers.begin();
+             it != _optimizers.end(); ++it) {
+            TokuFTCappedDeleteRangeOptimizer *optimizer = *it;
+            if (optimizer->_busy || optimizer->_dropping || optimizer->_max.isNull()) {
+                continue;
+            }
+            if (best == NULL || optimizer->_optimizableSize > best->_optimizableSize) {
+                best = optimizer;
             }
-            _thread.join();
         }
-        _magic = 11111;
+        return best;
+    }
+
+    void TokuFTCappedDeleteOptimizerPool::appendStats(BSONObjBuilder &b) const {
+        boost::mutex::scoped_lock lk(_mutex);
+        long long optimizable = 0;
+        long long unoptimizable = 0;
+        int numBehind = 0;
+        for (std::set<TokuFTCappedDeleteRangeOptimizer *>::const_iterator it = _optimizers.begin();
+             it != _optimizers.end(); ++it) {
+            optimizable += (*it)->_optimizableSize;
+            unoptimizable += (*it)->_unoptimizableSize;
+            if ((*it)->_optimizableSize > TokuFTCappedDeleteRangeOptimizer::lowWatermark) {
+                numBehind++;
+            }
+        }
+
+        b.append("workers", static_cast<int>(_workers.size()));
+        b.append("active", _numActive);
+        b.append("dictionaries", static_cast<int>(_optimizers.size()));
+        b.append("dictionariesBehind", numBehind);
+        b.appendNumber("optimizableBytes", optimizable);
+        b.appendNumber("unoptimizableBytes", unoptimizable);
+        b.appendNumber("count", _numOptimizes);
+        b.appendNumber("bytes", _optimizedBytes);
+        b.append("time", static_cast<double>(_optimizeMicros) / 1000000);
+        {
+            BSONObjBuilder bp(b.subobjStart("backpressure"));
+            bp.appendNumber("lowWatermark", static_cast<long long>(TokuFTCappedDeleteRangeOptimizer::lowWatermark));
+            bp.appendNumber("highWatermark", static_cast<long long>(TokuFTCappedDeleteRangeOptimizer::highWatermark));
+            bp.appendNumber("count", _numBackpressureWaits);
+            bp.append("time", static_cast<double>(_backpressureMicros) / 1000000);
+            bp.doneFast();
+        }
     }
 
     namespace {
@@ -120,79 +180,110 @@ namespace mongo {
 
     }
 
-    void TokuFTCappedDeleteRangeOptimizer::run() {
-        int64_t sizeOptimizing = 0;
-        while (_running) {
-            RecordId max;
-            {
-                boost::mutex::scoped_lock lk(_mutex);
+    void TokuFTCappedDeleteOptimizerPool::run() {
+        boost::mutex::scoped_lock lk(_mutex);
+        while (true) {
+            TokuFTCappedDeleteRangeOptimizer *optimizer = NULL;
+            while (_running && (optimizer = _pickLocked()) == NULL) {
+                _workCond.wait(lk);
+            }
+            if (!_running) {
+                break;
+            }
 
-                _optimizableSize -= sizeOptimizing;
-                _backpressureCond.notify_one();
+            const RecordId max = optimizer->_max;
+            optimizer->_max = RecordId();
+            const int64_t sizeOptimizing = optimizer->_optimizableSize;
+            optimizer->_busy = true;
+            _numActive++;
 
-                while (_max.isNull() && _running) {
-                    dassert(_optimizableSize == 0);
-                    _updateCond.wait(lk);
-                }
-                if (!_running) {
-                    break;
-                }
-
-                max = _max;
-                _max = RecordId();
-                sizeOptimizing = _optimizableSize;
+            int r;
+            Timer t;
+            {
+                lk.unlock();
+                r = optimizer->_db.hot_optimize(slice2ftslice(Slice::of(TokuFTCappedDeleteRangeOptimizer::kNegativeInfinity)),
+                                                slice2ftslice(Slice::of(KeyString(max))),
+                                                CappedDeleteRangeOptimizeCallback(*optimizer));
+                lk.lock();
             }
 
-            const int r = _db.hot_optimize(slice2ftslice(Slice::of(kNegativeInfinity)), slice2ftslice(Slice::of(KeyString(max))),
-                                           CappedDeleteRangeOptimizeCallback(*this));
-            if (r == -1 && !running()) {
-                break;
-            }
+            _numActive--;
+            _numOptimizes++;
+            _optimizedBytes += sizeOptimizing;
+            _optimizeMicros += t.micros();
+
+            const bool interrupted = (r == -1 && (!_running || optimizer->_dropping));
+            optimizer->_optimizableSize -= sizeOptimizing;
+            optimizer->_busy = false;
+            optimizer->_backpressureCond.notify_all();
+            // The optimizer may be destroyed as soon as we let go of the mutex, so don't touch it
+            // after this.
+            _doneCond.notify_all();
 
-            Status s = statusFromTokuFTError(r);
-            if (!s.isOK()) {
-                log() << "TokuFT: Capped deleter got error from hot optimize operation " << s;
+            if (!interrupted) {
+                Status s = statusFromTokuFTError(r);
+                if (!s.isOK()) {
+                    log() << "TokuFT: Capped deleter got error from hot optimize operation " << s;
+                }
             }
         }
+    }
 
-        {
-            boost::mutex::scoped_lock lk(_mutex);
-            _terminated = true;
-            _updateCond.notify_one();
+    TokuFTCappedDeleteRangeOptimizer::TokuFTCappedDeleteRangeOptimizer(TokuFTCappedDeleteOptimizerPool &pool,
+                                                                       const ftcxx::DB &db)
+        : _pool(pool),
+          _db(db),
+          _max(),
+          _unoptimizableSize(0),
+          _optimizableSize(0),
+          _busy(false),
+          _dropping(false)
+    {
+        boost::mutex::scoped_lock lk(_pool._mutex);
+        _pool._optimizers.insert(this);
+    }
+
+    TokuFTCappedDeleteRangeOptimizer::~TokuFTCappedDeleteRangeOptimizer() {
+        boost::mutex::scoped_lock lk(_pool._mutex);
+        _dropping = true;
+        while (_busy) {
+            _pool._doneCond.wait(lk);
         }
+        _pool._optimizers.erase(this);
     }
 
     bool TokuFTCappedDeleteRangeOptimizer::running() const {
-        boost::mutex::scoped_lock lk(_mutex);
-        return _running;
+        boost::mutex::scoped_lock lk(_pool._mutex);
+        return _pool._running && !_dropping;
     }
 
     void TokuFTCappedDeleteRangeOptimizer::updateMaxDeleted(const RecordId &max, int64_t sizeSaved, int64_t docsRemoved) {
-        boost::mutex::scoped_lock lk(_mutex);
+        boost::mutex::scoped_lock lk(_pool._mutex);
 
         // Now that we've deleted things higher than max, we'll assume anything that was deleted
         // earlier (unoptimizableSize) is now optimizable, and the new deletes are unoptimizable.
         _optimizableSize += _unoptimizableSize;
         _unoptimizableSize = sizeSaved;
         _max = max;
-        _updateCond.notify_one();
+        _pool._workCond.notify_one();
 
-        static const int64_t lowWatermark = 32<<20;
-        static const int64_t highWatermark = lowWatermark * 4;
         if (_optimizableSize > highWatermark) {
-            // This will wait for the optimize thread to catch up.  It should actually go to zero
-            // rather than just below lowWatermark, but we use hysteresis because it's the right
-            // thing if the implementation changes.
+            // This will wait for a worker to catch up.  It should actually go to zero rather than
+            // just below lowWatermark, but we use hysteresis because it's the right thing if the
+            // implementation changes.
             //
             // Since this is done while holding the cappedDeleteMutex, it will apply backpressure
             // gradually, once other threads insert enough to get them to start waiting behind that
             // mutex.
-            while (_optimizableSize > lowWatermark) {
+            Timer t;
+            _pool._numBackpressureWaits++;
+            while (_optimizableSize > lowWatermark && _pool._running) {
                 log() << "TokuFT: Capped delete optimizer is " << (_optimizableSize>>20)
                       << "MB behind, waiting for it to catch up somewhat.";
 
                 _backpressureCond.wait(lk);
             }
+            _pool._backpressureMicros += t.micros();
         }
     }
 
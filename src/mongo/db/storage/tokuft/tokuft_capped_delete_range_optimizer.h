@@ -30,33 +30,94 @@
 
 #pragma once
 
+#include <set>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
 #include <boost/thread/thread.hpp>
 
 #include <ftcxx/db.hpp>
 
+#include "mongo/base/disallow_copying.h"
 #include "mongo/db/record_id.h"
 #include "mongo/db/storage/key_string.h"
 #include "mongo/db/storage/kv/slice.h"
 
 namespace mongo {
 
+    class BSONObjBuilder;
+    class TokuFTCappedDeleteRangeOptimizer;
+
+    /**
+     * Engine-wide pool of worker threads that run the hot optimizes for every
+     * TokuFTCappedDeleteRangeOptimizer.
+     *
+     * With many capped collections, a thread each would mean that many hot optimizes fighting
+     * over the cachetable at once.  Instead, a fixed number of workers each take the dictionary
+     * with the most optimizable bytes that no other worker is on.
+     */
+    class TokuFTCappedDeleteOptimizerPool {
+        MONGO_DISALLOW_COPYING(TokuFTCappedDeleteOptimizerPool);
+    public:
+        explicit TokuFTCappedDeleteOptimizerPool(int numWorkers);
+
+        ~TokuFTCappedDeleteOptimizerPool();
+
+        /**
+         * Stops the workers, interrupting any hot optimize in progress.  Must be called before the
+         * environment is closed.
+         */
+        void shutdown();
+
+        void appendStats(BSONObjBuilder &b) const;
+
+        void run();
+
+    private:
+        friend class TokuFTCappedDeleteRangeOptimizer;
+
+        // The idle optimizer with pending work and the most optimizable bytes, or NULL.
+        TokuFTCappedDeleteRangeOptimizer *_pickLocked() const;
+
+        // Guards the pool and the state of every optimizer registered with it.
+        mutable boost::mutex _mutex;
+        boost::condition_variable _workCond;
+        boost::condition_variable _doneCond;
+
+        bool _running;
+        std::set<TokuFTCappedDeleteRangeOptimizer *> _optimizers;
+        std::vector<boost::shared_ptr<boost::thread> > _workers;
+
+        // Stats
+        int _numActive;
+        long long _numOptimizes;
+        long long _optimizedBytes;
+        long long _optimizeMicros;
+        long long _numBackpressureWaits;
+        long long _backpressureMicros;
+    };
+
     /**
      * Capped collections delete from the back in batches (see KVRecordStoreCapped::deleteAsNeeded),
      * and then notify the KVDictionary that a batch has been deleted and can be optimized.
-     * TokuFTCappedDeleteRangeOptimizer manages, for a specific record store, a background thread
-     * which will optimize old ranges of deleted data in the background.  We apply backpressure when
-     * the optimizer thread gets too far behind the deleted data.
+     * TokuFTCappedDeleteRangeOptimizer tracks, for a specific record store, the old ranges of
+     * deleted data that a TokuFTCappedDeleteOptimizerPool worker should optimize.  We apply
+     * backpressure when the optimizer gets too far behind the deleted data.
      */
     class TokuFTCappedDeleteRangeOptimizer {
+        MONGO_DISALLOW_COPYING(TokuFTCappedDeleteRangeOptimizer);
     public:
-        TokuFTCappedDeleteRangeOptimizer(const ftcxx::DB &db);
+        TokuFTCappedDeleteRangeOptimizer(TokuFTCappedDeleteOptimizerPool &pool, const ftcxx::DB &db);
 
+        /**
+         * Waits for a worker that is optimizing this dictionary to give up.
+         */
         ~TokuFTCappedDeleteRangeOptimizer();
 
         /**
-         * Notifies the thread that new data has been deleted beyond max, and so everything before
+         * Notifies the pool that new data has been deleted beyond max, and so everything before
          * max is eligible for optimization.  Also notes the size and number of documents deleted in
          * the current batch (which will be eligible for optimization later).
          *
@@ -66,15 +127,23 @@ namespace mongo {
          */
         void updateMaxDeleted(const RecordId &max, int64_t sizeSaved, int64_t docsRemoved);
 
-        void run();
-
         bool running() const;
 
+        // Past highWatermark optimizable bytes, deleters wait until the optimizer gets back
+        // under lowWatermark.
+        static const int64_t lowWatermark = 32<<20;
+        static const int64_t highWatermark = lowWatermark * 4;
+
     private:
+        friend class TokuFTCappedDeleteOptimizerPool;
+
         static const KeyString kNegativeInfinity;
-        int _magic;
 
+        TokuFTCappedDeleteOptimizerPool &_pool;
         const ftcxx::DB &_db;
+
+        // Everything below is guarded by the pool's mutex.
+
         RecordId _max;
 
         // The most recently deleted range is not optimizable.  Once we see more deletes, we
@@ -82,13 +151,11 @@ namespace mongo {
         int64_t _unoptimizableSize;
         int64_t _optimizableSize;
 
-        bool _running;
-        bool _terminated;
-
-        boost::thread _thread;
+        // A worker is optimizing this dictionary.
+        bool _busy;
+        // The dictionary is going away, so a worker on it should stop.
+        bool _dropping;
 
-        mutable boost::mutex _mutex;
-        boost::condition_variable _updateCond;
         boost::condition_variable _backpressureCond;
     };
 
@@ -58,8 +58,11 @@
 namespace mongo {
 
     TokuFTDictionary::TokuFTDictionary(const ftcxx::DBEnv &env, const ftcxx::DBTxn &txn, StringData ident,
-                                       const KVDictionary::Encoding &enc, const TokuFTDictionaryOptions& options)
-        : _options(options),
+                                       const KVDictionary::Encoding &enc, const TokuFTDictionaryOptions& options,
+                                       TokuFTCappedDeleteOptimizerPool *optimizerPool,
+                                       TokuFTDictionaryStatsCache *statsCache)
+        : _ident(ident.toString()),
+          _options(options),
           _db(ftcxx::DBBuilder()
               .set_readpagesize(options.readPageSize)
               .set_pagesize(options.pageSize)
@@ -67,9 +70,20 @@ namespace mongo {
               .set_fanout(options.fanout)
               .set_descriptor(slice2ftslice(enc.serialize()))
               .open(env, txn, ident.toString().c_str(), NULL,
-                    DB_BTREE /* legacy flag */, DB_CREATE, 0644))
+                    DB_BTREE /* legacy flag */, DB_CREATE, 0644)),
+          _optimizerPool(optimizerPool),
+          _statsCache(statsCache)
     {
         LOG(1) << "TokuFT: Opening dictionary \"" << ident << "\" with options " << options.toBSON();
+        if (_statsCache != NULL) {
+            _statsCache->registerDictionary(_ident, _db);
+        }
+    }
+
+    TokuFTDictionary::~TokuFTDictionary() {
+        if (_statsCache != NULL) {
+            _statsCache->unregisterDictionary(_ident, _db);
+        }
     }
 
     namespace {
@@ -99,6 +113,14 @@ namespace mongo {
                     : 0;
         }
 
+        DBT _dbtFromSlice(const Slice &s) {
+            DBT dbt;
+            memset(&dbt, 0, sizeof dbt);
+            dbt.data = const_cast<char *>(s.data());
+            dbt.size = s.size();
+            return dbt;
+        }
+
     }
 
     Status TokuFTDictionary::get(OperationContext *opCtx, const Slice &key, Slice &value, bool skipPessimisticLocking) const {
@@ -117,6 +139,76 @@ namespace mongo {
         return statusFromTokuFTError(r);
     }
 
+    namespace {
+
+        // When looking up many record store keys at once, keys whose RecordIds are at most this far
+        // apart are read with one cursor instead of with separate point queries.
+        const long long kGetManyMaxRecordIdGap = 16;
+
+    }
+
+    Status TokuFTDictionary::getMany(OperationContext *opCtx, const std::vector<Slice> &keys, GetManyCallback &cb) const {
+        const Encoding enc = encoding();
+        if (!enc.isRecordStore()) {
+            // We have no idea how far apart index keys are.
+            return KVDictionary::getMany(opCtx, keys, cb);
+        }
+
+        typedef ftcxx::BufferedCursor<TokuFTDictionary::Encoding, ftcxx::DB::NullFilter> RunCursor;
+
+        size_t runStart = 0;
+        while (runStart < keys.size()) {
+            // Find the run of keys starting at runStart that are close enough together to be worth
+            // reading with a single cursor.
+            size_t runEnd = runStart + 1;
+            RecordId prevId = enc.KVDictionary::Encoding::extractRecordId(keys[runStart]);
+            for (; runEnd < keys.size(); ++runEnd) {
+                const RecordId id = enc.KVDictionary::Encoding::extractRecordId(keys[runEnd]);
+                if (id.repr() - prevId.repr() > kGetManyMaxRecordIdGap) {
+                    break;
+                }
+                prevId = id;
+            }
+
+            if (runEnd - runStart == 1) {
+                Slice value;
+                Status s = get(opCtx, keys[runStart], value);
+                if (s.isOK()) {
+                    cb.found(keys[runStart], value);
+                } else if (s.code() != ErrorCodes::NoSuchKey) {
+                    return s;
+                }
+            } else {
+                try {
+                    ftcxx::Slice foundKey;
+                    ftcxx::Slice foundVal;
+                    size_t i = runStart;
+                    for (RunCursor cur(_db.buffered_cursor(_getDBTxn(opCtx),
+                                                           slice2ftslice(keys[runStart]),
+                                                           slice2ftslice(keys[runEnd - 1]),
+                                                           encoding(), ftcxx::DB::NullFilter()));
+                         i < runEnd && cur.next(foundKey, foundVal); ) {
+                        const Slice key = ftslice2slice(foundKey);
+                        // Skip over the requested keys that don't exist.
+                        while (i < runEnd && KVDictionary::Encoding::cmp(keys[i], key) < 0) {
+                            ++i;
+                        }
+                        if (i < runEnd && KVDictionary::Encoding::cmp(keys[i], key) == 0) {
+                            cb.found(keys[i], ftslice2slice(foundVal).owned());
+                            ++i;
+                        }
+                    }
+                } catch (ftcxx::ft_exception &e) {
+                    return statusFromTokuFTException(e);
+                }
+            }
+
+            runStart = runEnd;
+        }
+
+        return Status::OK();
+    }
+
     class DupKeyFilter {
         const TokuFTDictionary::Encoding &_enc;
         RecordId _id;
@@ -167,15 +259,129 @@ namespace mongo {
     }
 
     Status TokuFTDictionary::remove(OperationContext *opCtx, const Slice &key) {
-        int r = _db.del(_getDBTxn(opCtx), slice2ftslice(key), _getWriteFlags(opCtx));
+        // DB_DELETE_ANY makes this a blind delete, otherwise TokuFT would first look the key up just
+        // to report DB_NOTFOUND.  We still get the row lock.
+        int r = _db.del(_getDBTxn(opCtx), slice2ftslice(key), DB_DELETE_ANY | _getWriteFlags(opCtx));
+        return statusFromTokuFTError(r);
+    }
+
+    Status TokuFTDictionary::removeRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                         int64_t *numRemoved, int64_t *sizeRemoved) {
+        typedef ftcxx::BufferedCursor<TokuFTDictionary::Encoding, ftcxx::DB::NullFilter> RangeCursor;
+
+        const ftcxx::DBTxn &txn = _getDBTxn(opCtx);
+        int64_t n = 0;
+        int64_t size = 0;
+        try {
+            // The cursor write locks the whole range up front (DB_RMW + prelock), so each delete
+            // below can skip taking its own row lock (DB_PRELOCKED_WRITE) and doesn't need to look
+            // the key up first (DB_DELETE_ANY), which is most of the cost of a regular remove().
+            ftcxx::Slice key;
+            ftcxx::Slice val;
+            for (RangeCursor cur(_db.buffered_cursor(txn, slice2ftslice(left), slice2ftslice(right),
+                                                     encoding(), ftcxx::DB::NullFilter(),
+                                                     DB_RMW, true, true, true));
+                 cur.next(key, val); ) {
+                const int r = _db.del(txn, key, DB_DELETE_ANY | DB_PRELOCKED_WRITE);
+                if (r != 0) {
+                    return statusFromTokuFTError(r);
+                }
+                ++n;
+                size += val.size();
+            }
+        } catch (ftcxx::ft_exception &e) {
+            return statusFromTokuFTException(e);
+        }
+
+        if (numRemoved != NULL) {
+            *numRemoved = n;
+        }
+        if (sizeRemoved != NULL) {
+            *sizeRemoved = size;
+        }
+        return Status::OK();
+    }
+
+    KVDictionaryBuilder *TokuFTDictionary::getBuilder(OperationContext *opCtx) {
+        DB *db = _db.db();
+        DB_LOADER *loader;
+        uint32_t putFlags = 0;
+        uint32_t dbtFlags = 0;
+        const int r = db->dbenv->create_loader(db->dbenv, _getDBTxn(opCtx).txn(), &loader,
+                                               db, 1, &db, &putFlags, &dbtFlags,
+                                               LOADER_COMPRESS_INTERMEDIATES);
+        // Will throw WriteConflictException if needed
+        Status s = statusFromTokuFTError(r);
+        if (!s.isOK()) {
+            LOG(1) << "TokuFT: couldn't create a loader for \"" << db->get_dname(db)
+                   << "\", falling back to regular inserts: " << s;
+            return KVDictionary::getBuilder(opCtx);
+        }
+        return new Builder(loader, opCtx);
+    }
+
+    TokuFTDictionary::Builder::Builder(DB_LOADER *loader, OperationContext *opCtx)
+        : _loader(loader),
+          _opCtx(opCtx),
+          _mayInterrupt(false),
+          _closed(false)
+    {
+        int r = _loader->set_poll_function(_loader, &Builder::pollFunction, this);
+        invariant(r == 0);
+        r = _loader->set_error_callback(_loader, &Builder::errorCallback, this);
+        invariant(r == 0);
+    }
+
+    TokuFTDictionary::Builder::~Builder() {
+        if (!_closed) {
+            // The build was abandoned, nothing we've put so far should end up in the dictionary.
+            const int r = _loader->abort(_loader);
+            if (r != 0) {
+                warning() << "TokuFT: error aborting loader: " << r;
+            }
+        }
+    }
+
+    int TokuFTDictionary::Builder::pollFunction(void *extra, float progress) {
+        Builder *builder = static_cast<Builder *>(extra);
+        if (builder->_mayInterrupt && !builder->_opCtx->checkForInterruptNoAssert().isOK()) {
+            return -1;
+        }
+        return 0;
+    }
+
+    void TokuFTDictionary::Builder::errorCallback(DB *db, int i, int err, DBT *key, DBT *val, void *extra) {
+        warning() << "TokuFT: loader for \"" << db->get_dname(db) << "\" got error " << err;
+    }
+
+    Status TokuFTDictionary::Builder::insert(const Slice &key, const Slice &value) {
+        invariant(!_closed);
+        DBT keyDbt = _dbtFromSlice(key);
+        DBT valDbt = _dbtFromSlice(value);
+        return statusFromTokuFTError(_loader->put(_loader, &keyDbt, &valDbt));
+    }
+
+    Status TokuFTDictionary::Builder::commit(bool mayInterrupt) {
+        invariant(!_closed);
+        _mayInterrupt = mayInterrupt;
+        // Closing the loader is where all the work happens: the rows get sorted and written out to
+        // a new file, which replaces the dictionary's file when the transaction commits.
+        const int r = _loader->close(_loader);
+        _closed = true;
+        if (mayInterrupt) {
+            _opCtx->checkForInterrupt();
+        }
         return statusFromTokuFTError(r);
     }
 
     void TokuFTDictionary::justDeletedCappedRange(OperationContext *opCtx, const Slice &left, const Slice &right,
                                                   int64_t sizeSaved, int64_t docsRemoved) {
+        if (_optimizerPool == NULL) {
+            return;
+        }
         if (!_rangeOptimizer) {
             // We're in the cappedDeleteMutex so this is safe.
-            _rangeOptimizer.reset(new TokuFTCappedDeleteRangeOptimizer(_db));
+            _rangeOptimizer.reset(new TokuFTCappedDeleteRangeOptimizer(*_optimizerPool, _db));
         }
 
         const Encoding &enc = encoding();
@@ -210,15 +416,83 @@ namespace mongo {
         }
     }
 
+    KVDictionary::Cursor *TokuFTDictionary::getRangeCursor(OperationContext *opCtx, const Slice &key,
+                                                           const Slice &endKey, bool endKeyInclusive,
+                                                           const int direction) const {
+        try {
+            return new Cursor(*this, opCtx, key, endKey, endKeyInclusive, direction);
+        } catch (ftcxx::ft_exception &e) {
+            // Will throw WriteConflictException if needed, discard status
+            statusFromTokuFTException(e);
+            // otherwise rethrow
+            throw;
+        }
+    }
+
     KVDictionary::Stats TokuFTDictionary::getStats() const {
+        if (_statsCache != NULL) {
+            return _statsCache->get(_ident, _db);
+        }
+        return fetchStats(_db);
+    }
+
+    KVDictionary::Stats TokuFTDictionary::fetchStats(const ftcxx::DB &db) {
         KVDictionary::Stats kvStats;
-        ftcxx::Stats stats = _db.get_stats();
+        ftcxx::Stats stats = db.get_stats();
         kvStats.dataSize = stats.data_size;
         kvStats.storageSize = stats.file_size;
         kvStats.numKeys = stats.num_keys;
         return kvStats;
     }
 
+    namespace {
+
+        void _getKeyAfterBytesCallback(const DBT *endKey, uint64_t actuallySkipped, void *extra) {
+            Slice *key = static_cast<Slice *>(extra);
+            if (endKey != NULL) {
+                *key = Slice(static_cast<const char *>(endKey->data), endKey->size).owned();
+            }
+        }
+
+    }
+
+    Status TokuFTDictionary::getSplitKeys(OperationContext *opCtx, size_t numRanges, std::vector<Slice> &splitKeys) const {
+        if (numRanges < 2) {
+            return Status::OK();
+        }
+        const uint64_t rangeSize = getStats().dataSize / numRanges;
+        if (rangeSize == 0) {
+            return Status::OK();
+        }
+
+        // get_key_after_bytes only walks the tree's pivots and subtree estimates, so this
+        // doesn't read the data.
+        const ftcxx::DBTxn &txn = _getDBTxn(opCtx);
+        Slice start;
+        while (splitKeys.size() < numRanges - 1) {
+            const DBT startDbt = _dbtFromSlice(start);
+            Slice end;
+            const int r = _db.db()->get_key_after_bytes(_db.db(), txn.txn(),
+                                                        splitKeys.empty() ? NULL : &startDbt,
+                                                        rangeSize, _getKeyAfterBytesCallback,
+                                                        &end, 0);
+            if (r == DB_NOTFOUND) {
+                break;
+            }
+            if (r != 0) {
+                return statusFromTokuFTError(r);
+            }
+            if (end.size() == 0 ||
+                (!splitKeys.empty() && KVDictionary::Encoding::cmp(end, splitKeys.back()) <= 0)) {
+                // Ran off the end of the dictionary.
+                break;
+            }
+            splitKeys.push_back(end);
+            start = end;
+        }
+        return Status::OK();
+    }
+
     bool TokuFTDictionary::appendCustomStats(OperationContext *opCtx, BSONObjBuilder* result, double scale ) const {
         BSONObjBuilder b(result->subobjStart("tokuft"));
         KVDictionary::Stats stats = getStats();
@@ -267,7 +541,7 @@ namespace mongo {
     TokuFTDictionary::Cursor::Cursor(const TokuFTDictionary &dict, OperationContext *txn, const Slice &key, const int direction)
         : _cur(dict.db().buffered_cursor(_getDBTxn(txn), slice2ftslice(key),
                                          dict.encoding(), ftcxx::DB::NullFilter(), 0, (direction == 1))),
-          _currKey(), _currVal(), _ok(false)
+          _currKey(), _currVal(), _ok(false), _snapshotId(), _direction(direction)
     {
         advance(txn);
     }
@@ -275,7 +549,22 @@ namespace mongo {
     TokuFTDictionary::Cursor::Cursor(const TokuFTDictionary &dict, OperationContext *txn, const int direction)
         : _cur(dict.db().buffered_cursor(_getDBTxn(txn),
                                          dict.encoding(), ftcxx::DB::NullFilter(), 0, (direction == 1))),
-          _currKey(), _currVal(), _ok(false)
+          _currKey(), _currVal(), _ok(false), _snapshotId(), _direction(direction)
+    {
+        advance(txn);
+    }
+
+    // The bounds of an ftcxx cursor are always [left, right] in key order, and the cursor starts
+    // from whichever side its direction says.  Bounding both prefetching and the range locks taken
+    // under serializable transactions to the scan keeps us from conflicting with writers past it.
+    TokuFTDictionary::Cursor::Cursor(const TokuFTDictionary &dict, OperationContext *txn, const Slice &key,
+                                     const Slice &endKey, bool endKeyInclusive, const int direction)
+        : _cur(dict.db().buffered_cursor(_getDBTxn(txn),
+                                         slice2ftslice(direction == 1 ? key : endKey),
+                                         slice2ftslice(direction == 1 ? endKey : key),
+                                         dict.encoding(), ftcxx::DB::NullFilter(), 0, (direction == 1),
+                                         !endKeyInclusive)),
+          _currKey(), _currVal(), _ok(false), _snapshotId(), _direction(direction)
     {
         advance(txn);
     }
@@ -284,7 +573,42 @@ namespace mongo {
         return _ok;
     }
 
+    namespace {
+
+        // How many rows _seekNearby may step over before giving up and seeking.
+        const int kSeekNearbyMaxSteps = 16;
+
+    }
+
+    bool TokuFTDictionary::Cursor::_seekNearby(OperationContext *opCtx, const Slice &key) {
+        if (!_ok || opCtx->recoveryUnit()->getSnapshotId() != _snapshotId) {
+            return false;
+        }
+
+        int c = KVDictionary::Encoding::cmp(_currKey, key) * _direction;
+        if (c > 0) {
+            // The key is behind us.
+            return false;
+        }
+        for (int steps = 0; c < 0; ++steps) {
+            if (steps == kSeekNearbyMaxSteps) {
+                return false;
+            }
+            advance(opCtx);
+            if (!_ok) {
+                // Nothing at or past the key.
+                return true;
+            }
+            c = KVDictionary::Encoding::cmp(_currKey, key) * _direction;
+        }
+        return true;
+    }
+
     void TokuFTDictionary::Cursor::seek(OperationContext *opCtx, const Slice &key) {
+        if (_seekNearby(opCtx, key)) {
+            return;
+        }
+
         _cur.set_txn(_getDBTxn(opCtx));
         try {
             _cur.seek(slice2ftslice(key));
@@ -299,6 +623,7 @@ namespace mongo {
 
     void TokuFTDictionary::Cursor::advance(OperationContext *opCtx) {
         _cur.set_txn(_getDBTxn(opCtx));
+        _snapshotId = opCtx->recoveryUnit()->getSnapshotId();
         ftcxx::Slice key, val;
         try {
             _ok = _cur.next(key, val);
@@ -324,4 +649,19 @@ namespace mongo {
         return _currVal;
     }
 
+    bool TokuFTDictionary::Cursor::reattach(OperationContext *opCtx) {
+        invariant(ok());
+        _cur.set_txn(_getDBTxn(opCtx));
+        if (opCtx->recoveryUnit()->getSnapshotId() == _snapshotId) {
+            // Nothing we read can have changed, so the buffered rows are still good.
+            return true;
+        }
+
+        // Rows we buffered may have changed since, so they have to be read again, but we can
+        // still reposition this cursor instead of making a new one.
+        const Slice key = _currKey.owned();
+        seek(opCtx, key);
+        return true;
+    }
+
 } // namespace mongo
@@ -39,8 +39,10 @@
 #include "mongo/db/storage/kv/dictionary/kv_dictionary_update.h"
 #include "mongo/db/storage/kv/slice.h"
 #include "mongo/db/storage/record_data.h"
+#include "mongo/db/storage/snapshot.h"
 #include "mongo/db/storage/tokuft/tokuft_capped_delete_range_optimizer.h"
 #include "mongo/db/storage/tokuft/tokuft_dictionary_options.h"
+#include "mongo/db/storage/tokuft/tokuft_dictionary_stats_cache.h"
 
 #include <ftcxx/cursor.hpp>
 #include <ftcxx/db.hpp>
@@ -69,8 +71,18 @@ namespace mongo {
     // and SortedDataInterface implementations in src/mongo/db/storage/kv.
     class TokuFTDictionary : public KVDictionary {
     public:
+        /**
+         * 'optimizerPool' runs hot optimizes over ranges removed by capped deletes.  If it is NULL,
+         * capped deletes are left for the garbage collector.
+         *
+         * If 'statsCache' isn't NULL, getStats() answers from it.
+         */
         TokuFTDictionary(const ftcxx::DBEnv &env, const ftcxx::DBTxn &txn, StringData ident,
-                         const KVDictionary::Encoding &enc, const TokuFTDictionaryOptions& options);
+                         const KVDictionary::Encoding &enc, const TokuFTDictionaryOptions& options,
+                         TokuFTCappedDeleteOptimizerPool *optimizerPool = NULL,
+                         TokuFTDictionaryStatsCache *statsCache = NULL);
+
+        virtual ~TokuFTDictionary();
 
         class Encoding : public KVDictionary::Encoding {
         public:
@@ -105,6 +117,9 @@ namespace mongo {
 
             Cursor(const TokuFTDictionary &dict, OperationContext *txn, const int direction = 1);
 
+            Cursor(const TokuFTDictionary &dict, OperationContext *txn, const Slice &key,
+                   const Slice &endKey, bool endKeyInclusive, const int direction = 1);
+
             virtual bool ok() const;
 
             virtual void seek(OperationContext *opCtx, const Slice &key);
@@ -115,16 +130,54 @@ namespace mongo {
 
             virtual Slice currVal() const;
 
+            virtual bool reattach(OperationContext *opCtx);
+
         private:
+            /**
+             * Tries to reach 'key' by advancing a few rows, which usually stay within the rows
+             * already buffered.  Returns false if the caller has to seek.
+             */
+            bool _seekNearby(OperationContext *opCtx, const Slice &key);
+
             typedef ftcxx::BufferedCursor<TokuFTDictionary::Encoding, ftcxx::DB::NullFilter> FTCursor;
             FTCursor _cur;
             Slice _currKey;
             Slice _currVal;
             bool _ok;
+            // The snapshot the buffered rows were read in.
+            SnapshotId _snapshotId;
+            const int _direction;
+        };
+
+        /**
+         * Bulk loads a dictionary with the fractal tree loader, which sorts and writes the leaf
+         * nodes directly instead of pushing messages down from the root.
+         */
+        class Builder : public KVDictionaryBuilder {
+        public:
+            Builder(DB_LOADER *loader, OperationContext *opCtx);
+
+            virtual ~Builder();
+
+            virtual Status insert(const Slice &key, const Slice &value);
+
+            virtual Status commit(bool mayInterrupt);
+
+        private:
+            static int pollFunction(void *extra, float progress);
+
+            static void errorCallback(DB *db, int i, int err, DBT *key, DBT *val, void *extra);
+
+            DB_LOADER *_loader;
+            OperationContext *_opCtx;
+            bool _mayInterrupt;
+            bool _closed;
         };
 
         virtual Status get(OperationContext *opCtx, const Slice &key, Slice &value, bool skipPessimisticLocking=false) const;
 
+        virtual Status getMany(OperationContext *opCtx, const std::vector<Slice> &keys, GetManyCallback &cb) const;
+
         virtual Status dupKeyCheck(OperationContext *opCtx, const Slice &lookupLeft, const Slice &lookupRight, const RecordId &id);
         virtual bool supportsDupKeyCheck() const {
             return true;
@@ -143,6 +196,11 @@ namespace mongo {
 
         virtual Status remove(OperationContext *opCtx, const Slice &key);
 
+        virtual Status removeRange(OperationContext *opCtx, const Slice &left, const Slice &right,
+                                   int64_t *numRemoved, int64_t *sizeRemoved);
+
+        virtual KVDictionaryBuilder *getBuilder(OperationContext *opCtx);
+
         virtual void justDeletedCappedRange(OperationContext *opCtx, const Slice &left, const Slice &right,
                                             int64_t sizeSaved, int64_t docsRemoved);
 
@@ -150,9 +208,20 @@ namespace mongo {
 
         virtual KVDictionary::Cursor *getCursor(OperationContext *opCtx, const int direction = 1) const;
 
+        virtual KVDictionary::Cursor *getRangeCursor(OperationContext *opCtx, const Slice &key,
+                                                     const Slice &endKey, bool endKeyInclusive,
+                                                     const int direction = 1) const;
+
         virtual const char *name() const { return "tokuft"; }
 
         virtual KVDictionary::Stats getStats() const;
+
+        /**
+         * Reads the current stats of `db' from ftcxx, bypassing any cache.
+         */
+        static KVDictionary::Stats fetchStats(const ftcxx::DB &db);
+
+        virtual Status getSplitKeys(OperationContext *opCtx, size_t numRanges, std::vector<Slice> &splitKeys) const;
     
         virtual bool useExactStats() const { return true; }
 
@@ -171,8 +240,11 @@ namespace mongo {
             return TokuFTDictionary::Encoding(_db.descriptor());
         }
 
+        const std::string _ident;
         TokuFTDictionaryOptions _options;
         ftcxx::DB _db;
+        TokuFTCappedDeleteOptimizerPool *_optimizerPool;
+        TokuFTDictionaryStatsCache *_statsCache;
         boost::scoped_ptr<TokuFTCappedDeleteRangeOptimizer> _rangeOptimizer;
     };
 
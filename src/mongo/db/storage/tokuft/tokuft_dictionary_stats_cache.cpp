@@ -0,0 +1,212 @@
+// tokuft_dictionary_stats_cache.cpp
+
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include <vector>
+
+#include <boost/bind.hpp>
+
+#include "mongo/bson/bsonobjbuilder.h"
+#include "mongo/db/storage/tokuft/tokuft_dictionary.h"
+#include "mongo/db/storage/tokuft/tokuft_dictionary_stats_cache.h"
+#include "mongo/util/assert_util.h"
+#include "mongo/util/log.h"
+#include "mongo/util/time_support.h"
+
+namespace mongo {
+
+    TokuFTDictionaryStatsCache::TokuFTDictionaryStatsCache(int refreshPeriodMillis, int maxStalenessMillis)
+        : _refreshPeriodMillis(refreshPeriodMillis),
+          _maxStalenessMillis(maxStalenessMillis),
+          _running(true),
+          _totalDataSize(0),
+          _totalStorageSize(0),
+          _totalNumKeys(0),
+          _numHits(0),
+          _numMisses(0),
+          _numRefreshes(0)
+    {
+        invariant(_refreshPeriodMillis > 0);
+        invariant(_maxStalenessMillis >= _refreshPeriodMillis);
+        _thread.reset(new boost::thread(boost::bind(&TokuFTDictionaryStatsCache::run, this)));
+    }
+
+    TokuFTDictionaryStatsCache::~TokuFTDictionaryStatsCache() {
+        shutdown();
+    }
+
+    void TokuFTDictionaryStatsCache::shutdown() {
+        {
+            boost::mutex::scoped_lock lk(_mutex);
+            if (!_running) {
+                return;
+            }
+            _running = false;
+            _runCond.notify_all();
+        }
+        _thread->join();
+    }
+
+    void TokuFTDictionaryStatsCache::registerDictionary(const std::string &ident, const ftcxx::DB &db) {
+        boost::mutex::scoped_lock lk(_mutex);
+        _entries[ident].db = &db;
+    }
+
+    void TokuFTDictionaryStatsCache::unregisterDictionary(const std::string &ident, const ftcxx::DB &db) {
+        boost::mutex::scoped_lock lk(_mutex);
+        EntryMap::iterator it = _entries.find(ident);
+        if (it == _entries.end()) {
+            return;
+        }
+        Entry &entry = it->second;
+        while (entry.refreshing == &db) {
+            _refreshedCond.wait(lk);
+        }
+        // A newer handle for the same dictionary may have registered since.
+        if (entry.db == &db) {
+            entry.db = NULL;
+        }
+    }
+
+    void TokuFTDictionaryStatsCache::dropDictionary(const std::string &ident) {
+        boost::mutex::scoped_lock lk(_mutex);
+        EntryMap::iterator it = _entries.find(ident);
+        if (it == _entries.end() || it->second.db != NULL) {
+            // TokuFT can't drop an open dictionary, so the drop will fail.
+            return;
+        }
+        _storeLocked(it->second, KVDictionary::Stats(), 0);
+        _entries.erase(it);
+    }
+
+    KVDictionary::Stats TokuFTDictionaryStatsCache::get(const std::string &ident, const ftcxx::DB &db) {
+        {
+            boost::mutex::scoped_lock lk(_mutex);
+            EntryMap::const_iterator it = _entries.find(ident);
+            if (it != _entries.end() && it->second.refreshedMillis != 0 &&
+                static_cast<long long>(curTimeMillis64()) - it->second.refreshedMillis <= _maxStalenessMillis) {
+                _numHits++;
+                it->second.readSinceRefresh = true;
+                return it->second.stats;
+            }
+        }
+
+        const KVDictionary::Stats stats = TokuFTDictionary::fetchStats(db);
+
+        boost::mutex::scoped_lock lk(_mutex);
+        _storeLocked(_entries[ident], stats, curTimeMillis64());
+        _numMisses++;
+        return stats;
+    }
+
+    bool TokuFTDictionaryStatsCache::getCached(const std::string &ident, KVDictionary::Stats *stats) const {
+        boost::mutex::scoped_lock lk(_mutex);
+        EntryMap::const_iterator it = _entries.find(ident);
+        if (it == _entries.end() || it->second.refreshedMillis == 0) {
+            return false;
+        }
+        _numHits++;
+        it->second.readSinceRefresh = true;
+        *stats = it->second.stats;
+        return true;
+    }
+
+    void TokuFTDictionaryStatsCache::_storeLocked(Entry &entry, const KVDictionary::Stats &stats, long long now) {
+        _totalDataSize += static_cast<long long>(stats.dataSize) - static_cast<long long>(entry.stats.dataSize);
+        _totalStorageSize += static_cast<long long>(stats.storageSize) - static_cast<long long>(entry.stats.storageSize);
+        _totalNumKeys += static_cast<long long>(stats.numKeys) - static_cast<long long>(entry.stats.numKeys);
+        entry.stats = stats;
+        entry.refreshedMillis = now;
+        entry.readSinceRefresh = false;
+    }
+
+    void TokuFTDictionaryStatsCache::appendStats(BSONObjBuilder &b) const {
+        boost::mutex::scoped_lock lk(_mutex);
+        b.appendNumber("dictionaries", static_cast<long long>(_entries.size()));
+        b.appendNumber("dataSize", _totalDataSize);
+        b.appendNumber("storageSize", _totalStorageSize);
+        b.appendNumber("numKeys", _totalNumKeys);
+        b.appendNumber("refreshPeriodMillis", _refreshPeriodMillis);
+        b.appendNumber("maxStalenessMillis", _maxStalenessMillis);
+        b.appendNumber("hits", _numHits);
+        b.appendNumber("misses", _numMisses);
+        b.appendNumber("refreshes", _numRefreshes);
+    }
+
+    void TokuFTDictionaryStatsCache::run() {
+        boost::mutex::scoped_lock lk(_mutex);
+        while (_running) {
+            _runCond.timed_wait(lk, boost::posix_time::milliseconds(_refreshPeriodMillis));
+
+            std::vector<std::string> due;
+            const long long now = curTimeMillis64();
+            for (EntryMap::const_iterator it = _entries.begin(); it != _entries.end(); ++it) {
+                if (it->second.db != NULL && it->second.readSinceRefresh &&
+                    now - it->second.refreshedMillis >= _refreshPeriodMillis) {
+                    due.push_back(it->first);
+                }
+            }
+
+            for (std::vector<std::string>::const_iterator it = due.begin(); _running && it != due.end(); ++it) {
+                EntryMap::iterator entryIt = _entries.find(*it);
+                if (entryIt == _entries.end() || entryIt->second.db == NULL) {
+                    continue;
+                }
+                // While we're refreshing, unregisterDictionary() waits, so the DB stays open and
+                // the entry can't be dropped.
+                Entry &entry = entryIt->second;
+                const ftcxx::DB *db = entry.db;
+                entry.refreshing = db;
+
+                KVDictionary::Stats stats;
+                bool ok = true;
+                {
+                    lk.unlock();
+                    try {
+                        stats = TokuFTDictionary::fetchStats(*db);
+                    } catch (const std::exception &e) {
+                        LOG(1) << "TokuFT: couldn't refresh stats for dictionary " << *it << ": " << e.what();
+                        ok = false;
+                    }
+                    lk.lock();
+                }
+
+                entry.refreshing = NULL;
+                if (ok) {
+                    _storeLocked(entry, stats, curTimeMillis64());
+                    _numRefreshes++;
+                }
+                _refreshedCond.notify_all();
+            }
+        }
+    }
+
+}
@@ -0,0 +1,141 @@
+// tokuft_dictionary_stats_cache.h
+
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <map>
+#include <string>
+
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <ftcxx/db.hpp>
+
+#include "mongo/base/disallow_copying.h"
+#include "mongo/db/storage/kv/dictionary/kv_dictionary.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /**
+     * Engine-wide cache of ftcxx stats for TokuFT dictionaries, so that collStats, dbStats and
+     * listDatabases don't call DB::get_stats() for every dictionary on every request.
+     *
+     * A background thread refreshes, each `refreshPeriodMillis', the stats of the open
+     * dictionaries that were read since their last refresh, so idle dictionaries cost nothing.  A
+     * reader that finds stats older than `maxStalenessMillis' (because the dictionary was just
+     * opened, or wasn't read for a while) refreshes them itself.  Stats of
+     * closed dictionaries are kept until they're dropped, so sizes can be reported without
+     * reopening them, and the cache keeps totals over every dictionary it knows about.
+     */
+    class TokuFTDictionaryStatsCache {
+        MONGO_DISALLOW_COPYING(TokuFTDictionaryStatsCache);
+    public:
+        TokuFTDictionaryStatsCache(int refreshPeriodMillis, int maxStalenessMillis);
+
+        ~TokuFTDictionaryStatsCache();
+
+        /**
+         * Stops the refresh thread.  Must be called before the environment is closed.
+         */
+        void shutdown();
+
+        /**
+         * Called by a TokuFTDictionary when it opens `db' for `ident', and when it closes it.
+         * Unregistering waits for a background refresh of `db' to finish.
+         */
+        void registerDictionary(const std::string &ident, const ftcxx::DB &db);
+        void unregisterDictionary(const std::string &ident, const ftcxx::DB &db);
+
+        /**
+         * Forgets a dictionary that was dropped.
+         */
+        void dropDictionary(const std::string &ident);
+
+        /**
+         * Return: stats for `db' no older than the staleness bound
+         */
+        KVDictionary::Stats get(const std::string &ident, const ftcxx::DB &db);
+
+        /**
+         * Return: true if there are cached stats (of any age) for `ident', in `stats'
+         */
+        bool getCached(const std::string &ident, KVDictionary::Stats *stats) const;
+
+        void appendStats(BSONObjBuilder &b) const;
+
+        void run();
+
+    private:
+        struct Entry {
+            // The open dictionary, if any.
+            const ftcxx::DB *db;
+            // The dictionary the refresh thread is reading stats from right now, if any.
+            const ftcxx::DB *refreshing;
+            KVDictionary::Stats stats;
+            // 0 until stats are first read.
+            long long refreshedMillis;
+            // Whether the stats were read since they were refreshed, so the refresh thread
+            // should refresh them again.
+            mutable bool readSinceRefresh;
+
+            Entry() : db(NULL), refreshing(NULL), refreshedMillis(0), readSinceRefresh(false) {}
+        };
+
+        typedef std::map<std::string, Entry> EntryMap;
+
+        // Replaces `entry's stats, keeping the totals up to date.
+        void _storeLocked(Entry &entry, const KVDictionary::Stats &stats, long long now);
+
+        const long long _refreshPeriodMillis;
+        const long long _maxStalenessMillis;
+
+        mutable boost::mutex _mutex;
+        boost::condition_variable _runCond;
+        boost::condition_variable _refreshedCond;
+        bool _running;
+        EntryMap _entries;
+        boost::scoped_ptr<boost::thread> _thread;
+
+        // Sums over every entry's stats.
+        long long _totalDataSize;
+        long long _totalStorageSize;
+        long long _totalNumKeys;
+
+        // Stats
+        mutable long long _numHits;
+        long long _numMisses;
+        long long _numRefreshes;
+    };
+
+}
@@ -183,6 +183,12 @@ namespace mongo {
                 break;
             }
 
+            case DISK_VERSION_6: {
+                // No-op, just serialize the version below.  Older versions can't read the new
+                // update message type, so they must not open data written by this version.
+                break;
+            }
+
         }
 
         BSONObj oldVersionObj;
@@ -37,11 +37,15 @@
 #include "mongo/db/operation_context_noop.h"
 #include "mongo/db/storage/key_string.h"
 #include "mongo/db/storage/kv/dictionary/kv_dictionary_update.h"
+#include "mongo/db/storage/kv/dictionary/kv_lazy_dictionary.h"
+#include "mongo/db/storage/tokuft/tokuft_capped_delete_range_optimizer.h"
 #include "mongo/db/storage/tokuft/tokuft_dictionary.h"
+#include "mongo/db/storage/tokuft/tokuft_dictionary_stats_cache.h"
 #include "mongo/db/storage/tokuft/tokuft_disk_format.h"
 #include "mongo/db/storage/tokuft/tokuft_engine.h"
 #include "mongo/db/storage/tokuft/tokuft_errors.h"
 #include "mongo/db/storage/tokuft/tokuft_global_options.h"
+#include "mongo/db/storage/tokuft/tokuft_group_commit.h"
 #include "mongo/db/storage/tokuft/tokuft_recovery_unit.h"
 #include "mongo/util/log.h"
 #include "mongo/util/mongoutils/str.h"
@@ -237,6 +241,10 @@ namespace mongo {
 
     TokuFTEngine::TokuFTEngine(const std::string& path)
         : _env(nullptr),
+          _groupCommit(nullptr),
+          _cappedDeleteOptimizerPool(nullptr),
+          _statsCache(nullptr),
+          _handleCache(new KVDictionaryHandleCache(tokuftGlobalOptions.engineOptions.maxOpenDictionaries)),
           _metadataDict(nullptr),
           _internalMetadataDict(nullptr)
     {
@@ -277,6 +285,12 @@ namespace mongo {
                .set_update(&ftcxx::wrapped_updater<tokuft_update>)
                .open(path.c_str(), env_flags, env_mode);
 
+        _groupCommit.reset(new TokuFTGroupCommit(_env));
+        _cappedDeleteOptimizerPool.reset(
+            new TokuFTCappedDeleteOptimizerPool(engineOptions.cappedDeleteOptimizerThreads));
+        _statsCache.reset(new TokuFTDictionaryStatsCache(engineOptions.statsCacheRefreshPeriod,
+                                                         engineOptions.statsCacheMaxStaleness));
+
         ftcxx::DBTxn txn(_env);
         _metadataDict.reset(
             new TokuFTDictionary(_env, txn, "tokuft.metadata", KVDictionary::Encoding(),
@@ -298,6 +312,11 @@ namespace mongo {
 
         _internalMetadataDict.reset();
         _metadataDict.reset();
+        // Any capped collections still open hold optimizers registered with the pool, stop the
+        // workers before the environment goes away underneath them.
+        _cappedDeleteOptimizerPool->shutdown();
+        _statsCache->shutdown();
+        _groupCommit.reset();
         _env.close();
     }
 
@@ -308,14 +327,57 @@ namespace mongo {
             return ru->txn(opCtx);
         }
 
+        class TokuFTDictionaryOpener : public KVLazyDictionary::Opener {
+            const ftcxx::DBEnv &_env;
+            const std::string _ident;
+            const KVDictionary::Encoding _enc;
+            const TokuFTDictionaryOptions _options;
+            TokuFTCappedDeleteOptimizerPool *_optimizerPool;
+            TokuFTDictionaryStatsCache *_statsCache;
+
+        public:
+            TokuFTDictionaryOpener(const ftcxx::DBEnv &env, StringData ident, const KVDictionary::Encoding &enc,
+                                   const TokuFTDictionaryOptions &options,
+                                   TokuFTCappedDeleteOptimizerPool *optimizerPool,
+                                   TokuFTDictionaryStatsCache *statsCache)
+                : _env(env),
+                  _ident(ident.toString()),
+                  _enc(enc),
+                  _options(options),
+                  _optimizerPool(optimizerPool),
+                  _statsCache(statsCache)
+            {}
+
+            virtual bool cachedStats(KVDictionary::Stats *stats) const {
+                return _statsCache->getCached(_ident, stats);
+            }
+
+            virtual KVDictionary *open(OperationContext *opCtx) const {
+                if (opCtx != NULL) {
+                    const ftcxx::DBTxn &txn = _getDBTxn(opCtx);
+                    if (!txn.is_read_only()) {
+                        // The writer may have created this dictionary in the same transaction, in
+                        // which case no other transaction can open it yet.
+                        return new TokuFTDictionary(_env, txn, _ident, _enc, _options, _optimizerPool, _statsCache);
+                    }
+                }
+
+                // Readers have read-only snapshot transactions, open it in one of our own.
+                ftcxx::DBTxn txn(_env);
+                std::auto_ptr<KVDictionary> db(new TokuFTDictionary(_env, txn, _ident, _enc, _options, _optimizerPool, _statsCache));
+                txn.commit();
+                return db.release();
+            }
+        };
+
     }
 
     RecoveryUnit *TokuFTEngine::newRecoveryUnit() {
-        return new TokuFTRecoveryUnit(_env);
+        return new TokuFTRecoveryUnit(_env, _groupCommit.get());
     }
 
     void TokuFTEngine::_checkAndUpgradeDiskFormatVersion() {
-        OperationContextNoop opCtx(new TokuFTRecoveryUnit(_env));
+        OperationContextNoop opCtx(new TokuFTRecoveryUnit(_env, _groupCommit.get()));
         WriteUnitOfWork wuow(&opCtx);
 
         TokuFTDiskFormatVersion diskFormatVersion(_internalMetadataDict.get());
@@ -357,7 +419,13 @@ namespace mongo {
                                                 const BSONObj& options,
                                                 bool mayCreate) {
         // TODO: mayCreate
-        return new TokuFTDictionary(_env, _getDBTxn(opCtx), ident, enc, _createOptions(options, enc.isRecordStore()));
+        // The dictionary isn't opened until it's used, and may be closed again if it goes idle,
+        // so that collections that are never touched don't cost an open handle.
+        return new KVLazyDictionary(*_handleCache, ident.toString(),
+                                    new TokuFTDictionaryOpener(_env, ident, enc,
+                                                               _createOptions(options, enc.isRecordStore()),
+                                                               _cappedDeleteOptimizerPool.get(),
+                                                               _statsCache.get()));
     }
 
     Status TokuFTEngine::dropKVDictionary(OperationContext* opCtx,
@@ -372,9 +440,20 @@ namespace mongo {
                                         << ident);
         }
         invariant(r == 0);
+        _statsCache->dropDictionary(identStr);
         return Status::OK();
     }
 
+    int64_t TokuFTEngine::getIdentSize(OperationContext* opCtx,
+                                       StringData ident) {
+        KVDictionary::Stats stats;
+        if (_statsCache->getCached(ident.toString(), &stats)) {
+            return stats.storageSize;
+        }
+        // Not opened since startup, so we don't know.
+        return 1;
+    }
+
     int TokuFTEngine::flushAllFiles(bool sync) {
         LOG(1) << "TokuFT: running checkpoint on-demand";
         Status s = statusFromTokuFTError(_env.env()->txn_checkpoint(_env.env(), 0, 0, 0));
@@ -406,7 +485,7 @@ namespace mongo {
         return false;
     }
 
-    std::vector<std::string> TokuFTEngine::getAllIdents(OperationContext *opCtx) const {
+    std::vector<std::string> TokuFTEngine::getAllKVDictionaryIdents(OperationContext *opCtx) const {
         std::vector<std::string> idents;
 
         ftcxx::Slice key;
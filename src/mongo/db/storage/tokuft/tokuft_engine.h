@@ -38,7 +38,11 @@
 
 namespace mongo {
 
+    class KVDictionaryHandleCache;
+    class TokuFTCappedDeleteOptimizerPool;
     class TokuFTDictionaryOptions;
+    class TokuFTDictionaryStatsCache;
+    class TokuFTGroupCommit;
 
     class TokuFTEngine : public KVEngineImpl {
         MONGO_DISALLOW_COPYING(TokuFTEngine);
@@ -63,10 +67,11 @@ namespace mongo {
         virtual Status dropKVDictionary(OperationContext* opCtx,
                                         StringData ident);
 
+        /**
+         * Answered from the stats cache, never by opening the dictionary.
+         */
         virtual int64_t getIdentSize(OperationContext* opCtx,
-                                     StringData ident) {
-            return 1;
-        }
+                                     StringData ident);
 
         virtual Status repairIdent(OperationContext* opCtx,
                                    StringData ident) {
@@ -82,6 +87,11 @@ namespace mongo {
          */
         virtual bool supportsDocLocking() const { return true; }
 
+        /**
+         * Read-only transactions are started under Lock::SnapshotGate, while it is active.
+         */
+        virtual bool supportsBatchSnapshotReads() const { return true; }
+
         virtual bool supportsDirectoryPerDB() const { return false; }
 
         // ------------------------------------------------------------------ //
@@ -96,7 +106,7 @@ namespace mongo {
 
         bool hasIdent(OperationContext* opCtx, StringData ident) const;
 
-        std::vector<std::string> getAllIdents(OperationContext *opCtx) const;
+        std::vector<std::string> getAllKVDictionaryIdents(OperationContext *opCtx) const;
 
         ftcxx::DBEnv& env() { return _env; }
 
@@ -104,12 +114,34 @@ namespace mongo {
             return _internalMetadataDict.get();
         }
 
+        const TokuFTGroupCommit* groupCommit() const {
+            return _groupCommit.get();
+        }
+
+        const TokuFTCappedDeleteOptimizerPool* cappedDeleteOptimizerPool() const {
+            return _cappedDeleteOptimizerPool.get();
+        }
+
+        const KVDictionaryHandleCache* handleCache() const {
+            return _handleCache.get();
+        }
+
+        const TokuFTDictionaryStatsCache* statsCache() const {
+            return _statsCache.get();
+        }
+
     private:
         static TokuFTDictionaryOptions _createOptions(const BSONObj& options, bool isRecordStore);
 
         void _checkAndUpgradeDiskFormatVersion();
 
         ftcxx::DBEnv _env;
+        boost::scoped_ptr<TokuFTGroupCommit> _groupCommit;
+        boost::scoped_ptr<TokuFTCappedDeleteOptimizerPool> _cappedDeleteOptimizerPool;
+        // Must outlive every dictionary we hand out.
+        boost::scoped_ptr<TokuFTDictionaryStatsCache> _statsCache;
+        // Must outlive every dictionary we hand out.
+        boost::scoped_ptr<KVDictionaryHandleCache> _handleCache;
         boost::scoped_ptr<KVDictionary> _metadataDict;
         boost::scoped_ptr<KVDictionary> _internalMetadataDict;
     };
@@ -49,7 +49,11 @@ namespace mongo {
           locktreeMaxMemory(0),  // let this be the ft default, computed from cacheSize
           directoryForIndexes(false),
           compressBuffersBeforeEviction(false),
-          numCachetableBucketMutexes(1<<20)
+          numCachetableBucketMutexes(1<<20),
+          cappedDeleteOptimizerThreads(2),
+          maxOpenDictionaries(0),  // no limit
+          statsCacheRefreshPeriod(1000),
+          statsCacheMaxStaleness(5000)
     {}
 
     Status TokuFTEngineOptions::add(moe::OptionSection* options) {
@@ -78,6 +82,14 @@ namespace mongo {
                 "tokuftEngineCompressBuffersBeforeEviction", moe::Bool, "TokuFT engine compress buffers before eviction");
         tokuftOptions.addOptionChaining("storage.tokuft.engineOptions.numCachetableBucketMutexes",
                 "tokuftEngineNumCachetableBucketMutexes", moe::Int, "TokuFT engine num cachetable bucket mutexes");
+        tokuftOptions.addOptionChaining("storage.tokuft.engineOptions.cappedDeleteOptimizerThreads",
+                "tokuftEngineCappedDeleteOptimizerThreads", moe::Int, "TokuFT engine threads shared by capped collections to optimize deleted ranges");
+        tokuftOptions.addOptionChaining("storage.tokuft.engineOptions.maxOpenDictionaries",
+                "tokuftEngineMaxOpenDictionaries", moe::Int, "TokuFT engine max collection and index dictionaries kept open, 0 for no limit");
+        tokuftOptions.addOptionChaining("storage.tokuft.engineOptions.statsCacheRefreshPeriod",
+                "tokuftEngineStatsCacheRefreshPeriod", moe::Int, "TokuFT engine period for refreshing cached stats of recently read dictionaries in the background (ms)");
+        tokuftOptions.addOptionChaining("storage.tokuft.engineOptions.statsCacheMaxStaleness",
+                "tokuftEngineStatsCacheMaxStaleness", moe::Int, "TokuFT engine max age of cached dictionary stats before a reader refreshes them (ms)");
 
         return options->addSection(tokuftOptions);
     }
@@ -167,6 +179,42 @@ namespace mongo {
         if (params.count("storage.tokuft.engineOptions.numCachetableBucketMutexes")) {
             numCachetableBucketMutexes = params["storage.tokuft.engineOptions.numCachetableBucketMutexes"].as<int>();
         }
+        if (params.count("storage.tokuft.engineOptions.cappedDeleteOptimizerThreads")) {
+            cappedDeleteOptimizerThreads = params["storage.tokuft.engineOptions.cappedDeleteOptimizerThreads"].as<int>();
+            if (cappedDeleteOptimizerThreads < 1 || cappedDeleteOptimizerThreads > 64) {
+                StringBuilder sb;
+                sb << "storage.tokuft.engineOptions.cappedDeleteOptimizerThreads must be between 1 and 64, but attempted to set to: "
+                   << cappedDeleteOptimizerThreads;
+                return Status(ErrorCodes::BadValue, sb.str());
+            }
+        }
+        if (params.count("storage.tokuft.engineOptions.maxOpenDictionaries")) {
+            maxOpenDictionaries = params["storage.tokuft.engineOptions.maxOpenDictionaries"].as<int>();
+            if (maxOpenDictionaries < 0) {
+                StringBuilder sb;
+                sb << "storage.tokuft.engineOptions.maxOpenDictionaries must be >= 0, but attempted to set to: "
+                   << maxOpenDictionaries;
+                return Status(ErrorCodes::BadValue, sb.str());
+            }
+        }
+        if (params.count("storage.tokuft.engineOptions.statsCacheRefreshPeriod")) {
+            statsCacheRefreshPeriod = params["storage.tokuft.engineOptions.statsCacheRefreshPeriod"].as<int>();
+            if (statsCacheRefreshPeriod < 1) {
+                StringBuilder sb;
+                sb << "storage.tokuft.engineOptions.statsCacheRefreshPeriod must be >= 1, but attempted to set to: "
+                   << statsCacheRefreshPeriod;
+                return Status(ErrorCodes::BadValue, sb.str());
+            }
+        }
+        if (params.count("storage.tokuft.engineOptions.statsCacheMaxStaleness")) {
+            statsCacheMaxStaleness = params["storage.tokuft.engineOptions.statsCacheMaxStaleness"].as<int>();
+        }
+        if (statsCacheMaxStaleness < statsCacheRefreshPeriod) {
+            StringBuilder sb;
+            sb << "storage.tokuft.engineOptions.statsCacheMaxStaleness must be >= statsCacheRefreshPeriod ("
+               << statsCacheRefreshPeriod << "), but attempted to set to: " << statsCacheMaxStaleness;
+            return Status(ErrorCodes::BadValue, sb.str());
+        }
 
         return Status::OK();
     }
@@ -58,6 +58,10 @@ namespace mongo {
         // advanced
         bool compressBuffersBeforeEviction;
         int numCachetableBucketMutexes;
+        int cappedDeleteOptimizerThreads;
+        int maxOpenDictionaries;
+        int statsCacheRefreshPeriod;
+        int statsCacheMaxStaleness;
     };
 
 }
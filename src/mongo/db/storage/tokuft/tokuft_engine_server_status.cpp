@@ -45,10 +45,14 @@
 #include "mongo/base/string_data.h"
 #include "mongo/db/jsobj.h"
 #include "mongo/db/commands/server_status.h"
+#include "mongo/db/storage/kv/dictionary/kv_lazy_dictionary.h"
+#include "mongo/db/storage/tokuft/tokuft_capped_delete_range_optimizer.h"
+#include "mongo/db/storage/tokuft/tokuft_dictionary_stats_cache.h"
 #include "mongo/db/storage/tokuft/tokuft_disk_format.h"
 #include "mongo/db/storage/tokuft/tokuft_engine.h"
 #include "mongo/db/storage/tokuft/tokuft_engine_global_accessor.h"
 #include "mongo/db/storage/tokuft/tokuft_global_options.h"
+#include "mongo/db/storage/tokuft/tokuft_group_commit.h"
 #include "mongo/util/log.h"
 #include "mongo/util/mongoutils/str.h"
 
@@ -278,6 +282,22 @@ namespace mongo {
                 status["LOGGER_NUM_WRITES"].append(result, "count");
                 status["LOGGER_TOKUTIME_WRITES"].append(result, "time");
                 status["LOGGER_BYTES_WRITTEN"].append(result, "bytes", scale);
+                {
+                    NestedBuilder _n2(result, "groupCommit");
+                    tokuftGlobalEngine()->groupCommit()->appendStats(result.b());
+                }
+            }
+            {
+                NestedBuilder _n1(result, "dictionaryHandles");
+                tokuftGlobalEngine()->handleCache()->appendStats(result.b());
+            }
+            {
+                NestedBuilder _n1(result, "dictionaryStats");
+                tokuftGlobalEngine()->statsCache()->appendStats(result.b());
+            }
+            {
+                NestedBuilder _n1(result, "cappedDeleteOptimizer");
+                tokuftGlobalEngine()->cappedDeleteOptimizerPool()->appendStats(result.b());
             }
             {
                 NestedBuilder _n1(result, "cachetable");
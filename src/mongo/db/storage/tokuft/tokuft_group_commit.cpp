@@ -0,0 +1,145 @@
+// tokuft_group_commit.cpp
+
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *    Copyright (C) 2014 Tokutek Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
+
+#include <boost/bind.hpp>
+
+#include "mongo/db/jsobj.h"
+#include "mongo/db/storage/tokuft/tokuft_errors.h"
+#include "mongo/db/storage/tokuft/tokuft_group_commit.h"
+#include "mongo/util/log.h"
+#include "mongo/util/timer.h"
+
+namespace mongo {
+
+    TokuFTGroupCommit::TokuFTGroupCommit(const ftcxx::DBEnv &env)
+        : _env(env),
+          _running(true),
+          _nextFlush(1),
+          _lastFlushed(0),
+          _lastFlushOK(true),
+          _pending(0),
+          _numFlushes(0),
+          _numCommits(0),
+          _maxBatchSize(0),
+          _flushMicros(0),
+          _thread(boost::bind(&TokuFTGroupCommit::run, this))
+    {}
+
+    TokuFTGroupCommit::~TokuFTGroupCommit() {
+        shutdown();
+    }
+
+    void TokuFTGroupCommit::shutdown() {
+        {
+            boost::mutex::scoped_lock lk(_mutex);
+            if (!_running) {
+                return;
+            }
+            _running = false;
+            _requestCond.notify_one();
+            _flushedCond.notify_all();
+        }
+        _thread.join();
+    }
+
+    bool TokuFTGroupCommit::_flushLog() const {
+        const int r = _env.env()->log_flush(_env.env(), NULL);
+        if (r != 0) {
+            log() << "TokuFT: Group commit got error from log flush " << statusFromTokuFTError(r);
+        }
+        return r == 0;
+    }
+
+    void TokuFTGroupCommit::run() {
+        boost::mutex::scoped_lock lk(_mutex);
+        while (true) {
+            while (_running && _pending == 0) {
+                _requestCond.wait(lk);
+            }
+            if (!_running) {
+                break;
+            }
+
+            const unsigned long long flush = _nextFlush++;
+            const unsigned long long batchSize = _pending;
+            _pending = 0;
+
+            lk.unlock();
+            Timer t;
+            const bool ok = _flushLog();
+            const long long micros = t.micros();
+            lk.lock();
+
+            _lastFlushed = flush;
+            _lastFlushOK = ok;
+            _numFlushes++;
+            _numCommits += batchSize;
+            _maxBatchSize = std::max(_maxBatchSize, batchSize);
+            _flushMicros += micros;
+            _flushedCond.notify_all();
+        }
+    }
+
+    bool TokuFTGroupCommit::awaitCommit() {
+        {
+            boost::mutex::scoped_lock lk(_mutex);
+            if (_running) {
+                // The caller's transaction is already committed, so any flush that starts from
+                // now on covers it.
+                const unsigned long long needed = _nextFlush;
+                if (_pending++ == 0) {
+                    _requestCond.notify_one();
+                }
+                while (_running && _lastFlushed < needed) {
+                    _flushedCond.wait(lk);
+                }
+                if (_lastFlushed >= needed) {
+                    // Any later flush also covers us, so its result is as good as ours.
+                    return _lastFlushOK;
+                }
+            }
+        }
+
+        // Shutting down, nobody is left to flush for us.
+        return _flushLog();
+    }
+
+    void TokuFTGroupCommit::appendStats(BSONObjBuilder &b) const {
+        boost::mutex::scoped_lock lk(_mutex);
+        b.appendNumber("count", static_cast<long long>(_numFlushes));
+        b.appendNumber("commits", static_cast<long long>(_numCommits));
+        b.appendNumber("maxBatchSize", static_cast<long long>(_maxBatchSize));
+        b.append("time", static_cast<double>(_flushMicros) / 1000000);
+    }
+
+} // namespace mongo
@@ -0,0 +1,106 @@
+// tokuft_group_commit.h
+
+/**
+ *    Copyright (C) 2014 MongoDB Inc.
+ *    Copyright (C) 2014 Tokutek Inc.
+ *
+ *    This program is free software: you can redistribute it and/or  modify
+ *    it under the terms of the GNU Affero General Public License, version 3,
+ *    as published by the Free Software Foundation.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU Affero General Public License for more details.
+ *
+ *    You should have received a copy of the GNU Affero General Public License
+ *    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *    As a special exception, the copyright holders give permission to link the
+ *    code of portions of this program with the OpenSSL library under certain
+ *    conditions as described in each individual source file and distribute
+ *    linked combinations including the program with the OpenSSL library. You
+ *    must comply with the GNU Affero General Public License in all respects for
+ *    all of the code used other than as permitted herein. If you modify file(s)
+ *    with this exception, you may extend this exception to your version of the
+ *    file(s), but you are not obligated to do so. If you do not wish to do so,
+ *    delete this exception statement from your version. If you delete this
+ *    exception statement from all source files in the program, then also delete
+ *    it in the license file.
+ */
+
+#pragma once
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <ftcxx/db_env.hpp>
+
+#include "mongo/base/disallow_copying.h"
+
+namespace mongo {
+
+    class BSONObjBuilder;
+
+    /**
+     * Makes committed transactions durable for TokuFTRecoveryUnit::awaitCommit (j:true writes).
+     *
+     * Instead of each caller syncing the log itself, callers register with a background flusher
+     * thread and wait.  The flusher issues one log_flush for everyone who registered before it
+     * started, so with many concurrent j:true writers, each fsync covers a whole batch of them.
+     */
+    class TokuFTGroupCommit {
+        MONGO_DISALLOW_COPYING(TokuFTGroupCommit);
+    public:
+        TokuFTGroupCommit(const ftcxx::DBEnv &env);
+
+        ~TokuFTGroupCommit();
+
+        /**
+         * Blocks until everything committed to the environment before this call is durable.
+         * Returns false if the log flush failed.
+         */
+        bool awaitCommit();
+
+        /**
+         * Stops the flusher thread.  Must be called before the environment is closed.  Waiters
+         * that arrive afterwards flush the log themselves.
+         */
+        void shutdown();
+
+        void appendStats(BSONObjBuilder &b) const;
+
+        void run();
+
+    private:
+        bool _flushLog() const;
+
+        const ftcxx::DBEnv &_env;
+
+        mutable boost::mutex _mutex;
+        // Signalled when a waiter registers, or on shutdown.
+        boost::condition_variable _requestCond;
+        // Signalled when a flush completes, or on shutdown.
+        boost::condition_variable _flushedCond;
+
+        bool _running;
+
+        // Flushes are numbered.  A waiter needs flush number _nextFlush (the first one to start
+        // after it registered) to complete.
+        unsigned long long _nextFlush;
+        unsigned long long _lastFlushed;
+        bool _lastFlushOK;
+        // Waiters registered since the last flush started.
+        unsigned long long _pending;
+
+        // Stats
+        unsigned long long _numFlushes;
+        unsigned long long _numCommits;
+        unsigned long long _maxBatchSize;
+        unsigned long long _flushMicros;
+
+        boost::thread _thread;
+    };
+
+} // namespace mongo
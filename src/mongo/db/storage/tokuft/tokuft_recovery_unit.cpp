@@ -29,11 +29,13 @@
 
 #define MONGO_LOG_DEFAULT_COMPONENT ::mongo::logger::LogComponent::kStorage
 
+#include "mongo/db/concurrency/d_concurrency.h"
 #include "mongo/db/concurrency/locker_noop.h"
 #include "mongo/db/operation_context.h"
 #include "mongo/db/repl/member_state.h"
 #include "mongo/db/repl/replication_coordinator.h"
 #include "mongo/db/repl/replication_coordinator_global.h"
+#include "mongo/db/storage/tokuft/tokuft_group_commit.h"
 #include "mongo/db/storage/tokuft/tokuft_recovery_unit.h"
 #include "mongo/db/storage/tokuft/tokuft_global_options.h"
 #include "mongo/util/log.h"
@@ -43,9 +45,23 @@
 
 namespace mongo {
 
-    TokuFTRecoveryUnit::TokuFTRecoveryUnit(const ftcxx::DBEnv &env) :
+    TokuFTRecoveryUnit::TokuFTRecoveryUnit(const ftcxx::DBEnv &env, TokuFTGroupCommit *groupCommit) :
         // We use depth to track transaction nesting
-        _env(env), _txn(), _depth(0), _rollbackWritesDisabled(false), _knowsAboutReplicationState(false) {
+        _env(env), _groupCommit(groupCommit), _txn(), _sharedFrom(NULL), _depth(0), _rollbackWritesDisabled(false), _knowsAboutReplicationState(false) {
+    }
+
+    TokuFTRecoveryUnit::TokuFTRecoveryUnit(const TokuFTRecoveryUnit *sharedFrom) :
+        _env(sharedFrom->_env), _groupCommit(sharedFrom->_groupCommit), _txn(), _sharedFrom(sharedFrom), _depth(0), _rollbackWritesDisabled(false), _knowsAboutReplicationState(false) {
+    }
+
+    KVRecoveryUnit *TokuFTRecoveryUnit::newSharedSnapshotRecoveryUnit(OperationContext *opCtx) {
+        invariant(_sharedFrom == NULL);
+        // Only a read-only snapshot can be read from several threads at once, a serializable txn
+        // takes locks and may write.
+        if (!txn(opCtx).is_read_only()) {
+            return NULL;
+        }
+        return new TokuFTRecoveryUnit(this);
     }
 
     TokuFTRecoveryUnit::~TokuFTRecoveryUnit() {
@@ -54,6 +70,7 @@ namespace mongo {
     }
 
     void TokuFTRecoveryUnit::beginUnitOfWork(OperationContext *opCtx) {
+        invariant(_sharedFrom == NULL);
         _depth++;
         // Make sure we create a txn here so that we have a snapshot for getSnapshotId() later.
         txn(opCtx);
@@ -87,6 +104,7 @@ namespace mongo {
     }
 
     void TokuFTRecoveryUnit::commitAndRestart() {
+        invariant(_sharedFrom == NULL);
         invariant(_depth == 0);
         invariant(_changes.size() == 0);
 
@@ -126,7 +144,11 @@ namespace mongo {
         // cannot be guaranteed durable even after a sync to the log.
         invariant(!hasSnapshot());
 
-        // Once the log is synced, the transaction is fully durable.
+        // Once the log is synced, the transaction is fully durable.  Share the sync with any other
+        // threads waiting for the same thing.
+        if (_groupCommit != NULL) {
+            return _groupCommit->awaitCommit();
+        }
         const int r = _env.env()->log_flush(_env.env(), NULL);
         return r == 0;
     }
@@ -145,14 +167,14 @@ namespace mongo {
     }
 
     bool TokuFTRecoveryUnit::hasSnapshot() const {
-        return _txn.txn() != NULL;
+        return _activeTxn().txn() != NULL;
     }
 
     SnapshotId TokuFTRecoveryUnit::getSnapshotId() const {
         if (!hasSnapshot()) {
             return SnapshotId();
         }
-        return SnapshotId(_txn.id());
+        return SnapshotId(_activeTxn().id());
     }
 
     bool TokuFTRecoveryUnit::_opCtxIsWriting(OperationContext *opCtx) {
@@ -169,19 +191,25 @@ namespace mongo {
     }
 
     const ftcxx::DBTxn &TokuFTRecoveryUnit::txn(OperationContext *opCtx) {
+        if (_sharedFrom != NULL) {
+            // Read-only, whatever opCtx's locker says (see newSharedSnapshotRecoveryUnit).
+            return _sharedFrom->_txn;
+        }
         if (_txn.is_read_only() && _opCtxIsWriting(opCtx)) {
             _txn = ftcxx::DBTxn();
         }
         if (!hasSnapshot()) {
             // No txn exists yet, create one on-demand.
             // If locked for write, get a serializable txn, otherwise get a read-only one.
-            int flags;
             if (_opCtxIsWriting(opCtx)) {
-                flags = DB_SERIALIZABLE;
+                _txn = ftcxx::DBTxn(_env, DB_SERIALIZABLE);
+            } else if (Lock::SnapshotGate::isActive()) {
+                // Don't start a snapshot while a replication batch is being committed.
+                Lock::SnapshotGate gate(false);
+                _txn = ftcxx::DBTxn(_env, DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
             } else {
-                flags = DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY;
+                _txn = ftcxx::DBTxn(_env, DB_TXN_SNAPSHOT | DB_TXN_READ_ONLY);
             }
-            _txn = ftcxx::DBTxn(_env, flags);
         }
         return _txn;
     }
@@ -40,12 +40,16 @@
 namespace mongo {
 
     class OperationContext;
+    class TokuFTGroupCommit;
     class TokuFTStorageEngine;
 
     class TokuFTRecoveryUnit : public KVRecoveryUnit {
         MONGO_DISALLOW_COPYING(TokuFTRecoveryUnit);
     public:
-        TokuFTRecoveryUnit(const ftcxx::DBEnv &env);
+        /**
+         * 'groupCommit' may be NULL, in which case awaitCommit flushes the log itself.
+         */
+        TokuFTRecoveryUnit(const ftcxx::DBEnv &env, TokuFTGroupCommit *groupCommit);
 
         virtual ~TokuFTRecoveryUnit();
 
@@ -72,9 +76,11 @@ namespace mongo {
         }
 
         KVRecoveryUnit* newRecoveryUnit() const {
-            return new TokuFTRecoveryUnit(_env);
+            return new TokuFTRecoveryUnit(_env, _groupCommit);
         }
 
+        KVRecoveryUnit* newSharedSnapshotRecoveryUnit(OperationContext *opCtx);
+
         bool hasSnapshot() const;
 
         SnapshotId getSnapshotId() const;
@@ -83,8 +89,19 @@ namespace mongo {
         typedef boost::shared_ptr<Change> ChangePtr;
         typedef std::vector<ChangePtr> Changes;
 
+        // For newSharedSnapshotRecoveryUnit.
+        explicit TokuFTRecoveryUnit(const TokuFTRecoveryUnit *sharedFrom);
+
+        // The transaction this recovery unit reads with, its own or the one it shares.
+        const ftcxx::DBTxn &_activeTxn() const {
+            return _sharedFrom != NULL ? _sharedFrom->_txn : _txn;
+        }
+
         const ftcxx::DBEnv &_env;
+        TokuFTGroupCommit *_groupCommit;
         ftcxx::DBTxn _txn;
+        // If not NULL, this is a read-only recovery unit using _sharedFrom's snapshot.
+        const TokuFTRecoveryUnit *_sharedFrom;
 
         int _depth;
         Changes _changes;
@@ -101,7 +118,7 @@ namespace mongo {
         // -- TokuFT Specific
 
         DB_TXN *db_txn() const {
-            return _txn.txn();
+            return _activeTxn().txn();
         }
 
         const ftcxx::DBTxn &txn(OperationContext *opCtx);
@@ -52,9 +52,12 @@
 #include "mongo/db/json.h"
 #include "mongo/db/lasterror.h"
 #include "mongo/db/operation_context_impl.h"
+#include "mongo/db/operation_context_noop.h"
 #include "mongo/db/storage/mmap_v1/durable_mapped_file.h"
 #include "mongo/db/storage/mmap_v1/dur_stats.h"
 #include "mongo/db/storage/mmap_v1/btree/key.h"
+#include "mongo/db/storage/kv/dictionary/visible_id_tracker.h"
+#include "mongo/db/storage/recovery_unit_noop.h"
 #include "mongo/db/storage_options.h"
 #include "mongo/dbtests/dbtests.h"
 #include "mongo/dbtests/framework_options.h"
@@ -1411,6 +1414,79 @@ namespace PerfTests {
         string name() { return "move-not-ok-status"; }
     };
 
+    /**
+     * What a capped collection's CappedIdTracker sees: each writer adds an uncommitted id,
+     * checks visibility the way a new forward iterator would, and commits.  Runs with 1 to 64
+     * writer threads to show how the tracker scales.
+     */
+    class CappedIdTrackerSpeed : public B {
+        // Holds on to changes until commit, like a real storage engine's recovery unit.
+        class DeferredRecoveryUnit : public RecoveryUnitNoop {
+        public:
+            virtual void registerChange(Change* change) {
+                _changes.push_back(boost::shared_ptr<Change>(change));
+            }
+            virtual void commitUnitOfWork() {
+                for (size_t i = 0; i < _changes.size(); i++) {
+                    _changes[i]->commit();
+                }
+                _changes.clear();
+            }
+        private:
+            std::vector<boost::shared_ptr<Change> > _changes;
+        };
+
+        AtomicInt64 _nextId;
+        AtomicUInt32 _stop;
+
+        void writer(CappedIdTracker* tracker, unsigned long long* counter) {
+            OperationContextNoop txn(new DeferredRecoveryUnit());
+            const unsigned int Batch = batchSize();
+            while (!_stop.load()) {
+                for (unsigned int i = 0; i < Batch; i++) {
+                    WriteUnitOfWork wunit(&txn);
+                    const RecordId id(_nextId.fetchAndAdd(1));
+                    tracker->addUncommittedId(&txn, id);
+                    dontOptimizeOutHopefully += tracker->canReadId(id);
+                    wunit.commit();
+                }
+                *counter += Batch;
+            }
+        }
+
+    public:
+        string name() { return "capped-id-tracker"; }
+        virtual bool showDurStats() { return false; }
+        virtual int howLongMillis() { return 1000; }
+        void timed() {}
+
+        void run() {
+            for (int nThreads = 1; nThreads <= 64; nThreads *= 2) {
+                CappedIdTracker tracker(1);
+                _nextId.store(1);
+                _stop.store(0);
+
+                std::vector<unsigned long long> counters(nThreads, 0);
+                std::vector<boost::shared_ptr<boost::thread> > threads;
+                mongo::Timer t;
+                for (int i = 0; i < nThreads; i++) {
+                    threads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(
+                            stdx::bind(&CappedIdTrackerSpeed::writer, this, &tracker,
+                                       &counters[i]))));
+                }
+                sleepmillis(howLong());
+                _stop.store(1);
+
+                unsigned long long n = 0;
+                for (int i = 0; i < nThreads; i++) {
+                    threads[i]->join();
+                    n += counters[i];
+                }
+                say(n, t.micros(), str::stream() << name() << "-" << nThreads);
+            }
+        }
+    };
+
     class All : public Suite {
     public:
         All() : Suite( "perf" ) { }
@@ -1478,6 +1554,7 @@ namespace PerfTests {
                 add< simplemutexspeed >();
                 add< boostmutexspeed >();
                 add< boosttimed_mutexspeed >();
+                add< CappedIdTrackerSpeed >();
                 add< stdmutexspeed >();
                 add< stdtimed_mutexspeed >();
                 add< spinlockspeed >();
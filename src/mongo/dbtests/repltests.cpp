@@ -33,6 +33,9 @@
 
 #include "mongo/platform/basic.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
 #include "mongo/bson/mutable/document.h"
 #include "mongo/bson/mutable/mutable_bson_test_utils.h"
 #include "mongo/db/db.h"
@@ -43,6 +46,7 @@
 #include "mongo/db/repl/replication_coordinator_global.h"
 #include "mongo/db/repl/replication_coordinator_mock.h"
 #include "mongo/db/repl/sync.h"
+#include "mongo/db/repl/sync_tail.h"
 #include "mongo/db/ops/update.h"
 #include "mongo/db/catalog/collection.h"
 #include "mongo/db/operation_context_impl.h"
@@ -1444,6 +1448,189 @@ namespace ReplTests {
         }
     };
 
+    namespace SyncTailTests {
+
+        BSONObj insertOp( const char* ns, int id ) {
+            return BSON( "op" << "i" << "ns" << ns << "o" << BSON( "_id" << id ) );
+        }
+
+        std::vector<BSONObj> insertOps( const char* ns, int n ) {
+            std::vector<BSONObj> ops;
+            for ( int i = 0; i < n; i++ ) {
+                ops.push_back( insertOp( ns, i ) );
+            }
+            return ops;
+        }
+
+        // Calls DeferredCommit::writerDone on a thread of its own, as a writer would.
+        class DeferredWriter {
+        public:
+            DeferredWriter( SyncTail::DeferredCommit* deferredCommit, bool ok )
+                : _deferredCommit( deferredCommit ),
+                  _ok( ok ),
+                  _commit( false ),
+                  _thread( boost::bind( &DeferredWriter::_run, this ) ) {
+            }
+
+            // Returns whether the writer was told to commit.
+            bool join() {
+                _thread.join();
+                return _commit;
+            }
+
+        private:
+            void _run() {
+                _commit = _deferredCommit->writerDone( _ok );
+            }
+
+            SyncTail::DeferredCommit* _deferredCommit;
+            bool _ok;
+            bool _commit;
+            boost::thread _thread;
+        };
+
+        class DeferredCommitCommits {
+        public:
+            void run() {
+                SyncTail::DeferredCommit deferredCommit( 2 );
+                DeferredWriter a( &deferredCommit, true );
+                DeferredWriter b( &deferredCommit, true );
+                ASSERT( deferredCommit.waitForWriters( 60 * 1000 ) );
+                ASSERT( !deferredCommit.aborted() );
+                deferredCommit.release( true );
+                ASSERT( a.join() );
+                ASSERT( b.join() );
+                ASSERT( !deferredCommit.aborted() );
+            }
+        };
+
+        class DeferredCommitRollsBack {
+        public:
+            void run() {
+                SyncTail::DeferredCommit deferredCommit( 2 );
+                DeferredWriter a( &deferredCommit, true );
+                DeferredWriter b( &deferredCommit, false );
+                // Both writers are done, but one failed.
+                ASSERT( !deferredCommit.waitForWriters( 60 * 1000 ) );
+                deferredCommit.release( false );
+                ASSERT( deferredCommit.aborted() );
+                ASSERT( !a.join() );
+                ASSERT( !b.join() );
+            }
+        };
+
+        class DeferredCommitTimesOut {
+        public:
+            void run() {
+                SyncTail::DeferredCommit deferredCommit( 2 );
+                DeferredWriter a( &deferredCommit, true );
+                // The second writer never finishes.
+                ASSERT( !deferredCommit.waitForWriters( 10 ) );
+                ASSERT( !deferredCommit.aborted() );
+                deferredCommit.release( false );
+                ASSERT( deferredCommit.aborted() );
+                ASSERT( !a.join() );
+            }
+        };
+
+        class WriterQueueLargestFirst {
+        public:
+            void run() {
+                std::vector< std::vector<BSONObj> > buckets( 5 );
+                buckets[0] = insertOps( "unittests.a", 1 );
+                buckets[2] = insertOps( "unittests.b", 3 );
+                buckets[3] = insertOps( "unittests.c", 1 );
+                buckets[4] = insertOps( "unittests.d", 2 );
+
+                // Empty buckets are skipped, and buckets of the same size keep their order.
+                SyncTail::WriterQueue queue( buckets );
+                ASSERT_EQUALS( queue.size(), 4U );
+                ASSERT( queue.next( 0 ) == &buckets[2] );
+                ASSERT( queue.next( 0 ) == &buckets[4] );
+                ASSERT( queue.next( 0 ) == &buckets[0] );
+                ASSERT( queue.next( 0 ) == &buckets[3] );
+                ASSERT( queue.next( 0 ) == NULL );
+                ASSERT( queue.next( 0 ) == NULL );
+            }
+        };
+
+        class WriterQueueKeepsBucketOrder {
+        public:
+            void run() {
+                std::vector< std::vector<BSONObj> > buckets( 2 );
+                buckets[0] = insertOps( "unittests.a", 2 );
+                buckets[1] = insertOps( "unittests.b", 3 );
+
+                SyncTail::WriterQueue queue( buckets );
+                for ( const std::vector<BSONObj>* bucket = queue.next( 0 );
+                      bucket != NULL;
+                      bucket = queue.next( 0 ) ) {
+                    // Each bucket is handed out whole, with its ops in order.
+                    const std::vector<BSONObj>& original = bucket == &buckets[0] ? buckets[0]
+                                                                                 : buckets[1];
+                    ASSERT_EQUALS( bucket->size(), original.size() );
+                    for ( size_t i = 0; i < bucket->size(); i++ ) {
+                        ASSERT_EQUALS( (*bucket)[i]["o"]["_id"].numberInt(), static_cast<int>( i ) );
+                    }
+                }
+            }
+        };
+
+        class EndOfGroupOpLimit {
+        public:
+            void run() {
+                const std::vector<BSONObj> ops = insertOps( "unittests.a", 10 );
+                ASSERT( endOfGroup( ops.begin(), ops.end(), 4, 1024 * 1024 ) == ops.begin() + 4 );
+                ASSERT( endOfGroup( ops.begin() + 8, ops.end(), 4, 1024 * 1024 ) == ops.end() );
+                ASSERT( endOfGroup( ops.begin(), ops.end(), 100, 1024 * 1024 ) == ops.end() );
+            }
+        };
+
+        class EndOfGroupByteLimit {
+        public:
+            void run() {
+                const std::vector<BSONObj> ops = insertOps( "unittests.a", 10 );
+                const int opSize = ops[0].objsize();
+                // The op that reaches the limit is still part of the group.
+                ASSERT( endOfGroup( ops.begin(), ops.end(), 100, 2 * opSize ) == ops.begin() + 2 );
+                ASSERT( endOfGroup( ops.begin(), ops.end(), 100, 2 * opSize + 1 ) ==
+                        ops.begin() + 3 );
+                // There's always room for one op.
+                ASSERT( endOfGroup( ops.begin(), ops.end(), 100, 1 ) == ops.begin() + 1 );
+            }
+        };
+
+        class EndOfGroupStopsAtOpsAppliedAlone {
+        public:
+            void run() {
+                const BSONObj alone[] = {
+                    BSON( "op" << "c" << "ns" << "unittests.$cmd" <<
+                          "o" << BSON( "drop" << "a" ) ),
+                    BSON( "op" << "n" << "ns" << "" << "o" << BSON( "msg" << "noop" ) ),
+                    insertOp( "unittests.system.indexes", 0 ),
+                    insertOp( "admin.a", 0 ),
+                };
+                for ( size_t i = 0; i < sizeof( alone ) / sizeof( alone[0] ); i++ ) {
+                    std::vector<BSONObj> ops;
+                    ops.push_back( insertOp( "unittests.a", 0 ) );
+                    ops.push_back( BSON( "op" << "u" << "ns" << "unittests.a" <<
+                                         "o2" << BSON( "_id" << 0 ) <<
+                                         "o" << BSON( "$set" << BSON( "x" << 1 ) ) ) );
+                    ops.push_back( alone[i] );
+                    ops.push_back( insertOp( "unittests.a", 1 ) );
+
+                    ASSERT( endOfGroup( ops.begin(), ops.end(), 100, 1024 * 1024 ) ==
+                            ops.begin() + 2 );
+                    ASSERT( endOfGroup( ops.begin() + 2, ops.end(), 100, 1024 * 1024 ) ==
+                            ops.begin() + 2 );
+                    ASSERT( endOfGroup( ops.begin() + 3, ops.end(), 100, 1024 * 1024 ) ==
+                            ops.end() );
+                }
+            }
+        };
+
+    } // namespace SyncTailTests
+
     class All : public Suite {
     public:
         All() : Suite( "repl" ) {
@@ -1509,6 +1696,14 @@ namespace ReplTests {
             add< DatabaseIgnorerBasic >();
             add< DatabaseIgnorerUpdate >();
             add< ShouldRetry >();
+            add< SyncTailTests::DeferredCommitCommits >();
+            add< SyncTailTests::DeferredCommitRollsBack >();
+            add< SyncTailTests::DeferredCommitTimesOut >();
+            add< SyncTailTests::WriterQueueLargestFirst >();
+            add< SyncTailTests::WriterQueueKeepsBucketOrder >();
+            add< SyncTailTests::EndOfGroupOpLimit >();
+            add< SyncTailTests::EndOfGroupByteLimit >();
+            add< SyncTailTests::EndOfGroupStopsAtOpsAppliedAlone >();
         }
     };
 